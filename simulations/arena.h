@@ -0,0 +1,64 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+
+#include <sys/mman.h>
+
+// ==========================================
+// SIMULATOR ARENA
+// ==========================================
+// One contiguous mapping per simulator for its bulk per-line state, instead
+// of one heap block per set. Blocks of 2MB or more ask for transparent huge
+// pages, so a 1M-line model costs a handful of TLB entries rather than
+// thousands. The mapping comes back zeroed, and reset() zeroes it again in
+// one memset, so a sweep can reuse an instance without reallocating.
+//
+// Only trivially copyable types whose all-zero bytes are a valid initial
+// state belong here.
+const size_t ARENA_ALIGN = 64;                   // Cache line
+const size_t HUGE_PAGE_BYTES = 2 * 1024 * 1024;
+
+class Arena
+{
+    char *base = nullptr;
+    size_t capacity = 0;
+    size_t used = 0;
+
+public:
+    explicit Arena(size_t bytes)
+    {
+        bool huge = bytes >= HUGE_PAGE_BYTES;
+        capacity = huge ? (bytes + HUGE_PAGE_BYTES - 1) / HUGE_PAGE_BYTES * HUGE_PAGE_BYTES : bytes;
+        capacity = std::max(capacity, ARENA_ALIGN);
+        void *p = mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED)
+            throw std::bad_alloc();
+        base = (char *)p;
+#ifdef MADV_HUGEPAGE
+        if (huge)
+            madvise(base, capacity, MADV_HUGEPAGE); // Best effort: THP may be off
+#endif
+    }
+
+    ~Arena() { munmap(base, capacity); }
+
+    Arena(const Arena &) = delete;
+    Arena &operator=(const Arena &) = delete;
+
+    template <typename T> T *alloc(size_t n)
+    {
+        size_t start = (used + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+        if (start + n * sizeof(T) > capacity)
+            throw std::bad_alloc();
+        used = start + n * sizeof(T);
+        return reinterpret_cast<T *>(base + start);
+    }
+
+    void reset() { memset(base, 0, used); }
+
+    size_t bytes() const { return capacity; }
+};
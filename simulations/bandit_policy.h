@@ -0,0 +1,340 @@
+#pragma once
+
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <iomanip>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "coalesce_policies.h"
+
+// ==========================================
+// POLICY 10: BANDIT (Portfolio Meta-Policy)
+// ==========================================
+// No single policy wins everywhere: LRU for recency-friendly tenants,
+// SRRIP/SHiP under scans, COALESCE when sharing dominates. This one keeps a
+// portfolio and lets each core pick:
+//
+//   real cache   - every arm sees every hit/miss/evict callback, so any of
+//                  them can take over with warm metadata; only the core's
+//                  active arm chooses victims
+//   shadow sets  - every BANDIT_SHADOW_STRIDE-th set is also replayed into a
+//                  private tag array per arm, driven by that arm alone. The
+//                  arms are scored on the same sampled accesses, attributed
+//                  to the core that issued them
+//   selection    - per core, every BANDIT_EPOCH of its accesses: discounted
+//                  UCB over shadow hit rates (old epochs fade by
+//                  BANDIT_DISCOUNT so a tenant's phase change is noticed)
+//   regret       - per epoch, best shadow hit rate minus the chosen arm's,
+//                  times the core's accesses: misses lost to picking wrong
+//
+// Shadows make the feedback full-information (every arm is scored every
+// epoch), so the confidence term only separates arms when a core touched
+// few sampled sets; it keeps a thinly observed core from flapping on noise.
+const int BANDIT_EPOCH = 8192;        // Accesses per core between choices
+const int BANDIT_SHADOW_STRIDE = 8;   // 1 in 8 sets shadowed (all of them if fewer than 8)
+const double BANDIT_DISCOUNT = 0.8;   // Weight of the previous epochs' evidence
+const double BANDIT_EXPLORE = 0.5;    // UCB confidence scale
+
+using PolicyFactory = std::function<std::unique_ptr<ReplacementPolicy>(int sets, int ways)>;
+
+class BanditPolicy : public ReplacementPolicy
+{
+    struct Arm
+    {
+        std::string name;
+        std::unique_ptr<ReplacementPolicy> live;   // Metadata for the real cache
+        std::unique_ptr<ReplacementPolicy> shadow; // Drives this arm's shadow sets
+        std::vector<std::vector<CacheLine>> shadow_lines;
+    };
+
+    struct CoreState
+    {
+        int active = 0;
+        uint64_t accesses = 0; // In the current epoch
+        std::vector<uint64_t> hits, samples; // Shadow results, current epoch
+        std::vector<double> score, weight;   // Discounted hits / samples
+        std::vector<uint64_t> epochs_chosen;
+        std::vector<std::pair<int, uint64_t>> runs; // Choice per epoch, run-length encoded
+        uint64_t epochs = 0;
+        uint64_t switches = 0;
+        double regret = 0; // Misses vs. the best arm of each epoch
+
+        void checkpoint(StateArchive &a)
+        {
+            a.io(active, accesses, hits, samples, score, weight, epochs_chosen, runs, epochs, switches, regret);
+        }
+    };
+
+    std::vector<Arm> arms;
+    std::vector<int> shadow_slot; // Real set -> shadow set, -1 if not sampled
+    std::vector<CoreState> cores;
+    int core = 0;
+    uint64_t pending_tag = 0; // From on_miss, for the shadow replay in find_victim
+
+    CoreState &state()
+    {
+        if (core >= (int)cores.size())
+            cores.resize(core + 1);
+        CoreState &c = cores[core];
+        if (c.hits.empty())
+        {
+            size_t n = arms.size();
+            c.hits.assign(n, 0);
+            c.samples.assign(n, 0);
+            c.score.assign(n, 0);
+            c.weight.assign(n, 0);
+            c.epochs_chosen.assign(n, 0);
+        }
+        return c;
+    }
+
+    // Sharing class is only known on hits (misses don't pass the incoming line)
+    void shadow_access(int set_idx, uint64_t tag, uint64_t pc, int sharers, MESI_State st, int sharing, CoreState &c)
+    {
+        int local = shadow_slot[set_idx];
+        if (local < 0)
+            return;
+        for (size_t a = 0; a < arms.size(); a++)
+        {
+            Arm &arm = arms[a];
+            std::vector<CacheLine> &set = arm.shadow_lines[local];
+            c.samples[a]++;
+
+            int w = 0;
+            while (w < ways && !(set[w].valid && set[w].tag == tag))
+                w++;
+            if (w < ways)
+            {
+                c.hits[a]++;
+                set[w].pc = pc;
+                set[w].sharers = std::min(sharers, 255);
+                set[w].state = st;
+                set[w].sharing = sharing;
+                arm.shadow->update_on_hit(local, w, set[w]);
+                continue;
+            }
+            arm.shadow->on_miss(local, tag);
+            int victim = arm.shadow->find_victim(local, set.data(), pc, sharers, st);
+            if (set[victim].valid)
+                arm.shadow->on_evict(local, victim, set[victim]);
+            set[victim] = {tag, pc, sharers, st};
+            arm.shadow->update_on_miss(local, victim, pc, tag);
+        }
+    }
+
+    // One real access by the current core; closes its epoch when due
+    void count_access(CoreState &c)
+    {
+        if (++c.accesses < BANDIT_EPOCH)
+            return;
+
+        size_t n = arms.size();
+        double best_rate = -1, chosen_rate = 0;
+        for (size_t a = 0; a < n; a++)
+        {
+            if (c.samples[a] == 0)
+                continue;
+            double rate = (double)c.hits[a] / c.samples[a];
+            best_rate = std::max(best_rate, rate);
+            if ((int)a == c.active)
+                chosen_rate = rate;
+            c.score[a] = BANDIT_DISCOUNT * c.score[a] + c.hits[a];
+            c.weight[a] = BANDIT_DISCOUNT * c.weight[a] + c.samples[a];
+        }
+        if (best_rate >= 0)
+            c.regret += (best_rate - chosen_rate) * c.accesses;
+
+        double total = 0;
+        for (size_t a = 0; a < n; a++)
+            total += c.weight[a];
+        int pick = c.active;
+        double best_index = -1;
+        for (size_t a = 0; a < n; a++)
+        {
+            double index = c.weight[a] > 0
+                               ? c.score[a] / c.weight[a] + BANDIT_EXPLORE * std::sqrt(2 * std::log(total + 1) / c.weight[a])
+                               : 2.0; // Never observed: try it
+            if (index > best_index)
+            {
+                best_index = index;
+                pick = (int)a;
+            }
+        }
+
+        c.switches += pick != c.active;
+        c.active = pick;
+        c.epochs_chosen[pick]++;
+        if (!c.runs.empty() && c.runs.back().first == pick)
+            c.runs.back().second++;
+        else
+            c.runs.push_back({pick, 1});
+        c.epochs++;
+        c.accesses = 0;
+        std::fill(c.hits.begin(), c.hits.end(), 0);
+        std::fill(c.samples.begin(), c.samples.end(), 0);
+    }
+
+public:
+    BanditPolicy(const std::vector<std::pair<std::string, PolicyFactory>> &portfolio, int sets = NUM_SETS,
+                 int assoc = WAYS)
+        : ReplacementPolicy(sets, assoc), shadow_slot(sets, -1)
+    {
+        int stride = sets >= BANDIT_SHADOW_STRIDE ? BANDIT_SHADOW_STRIDE : 1;
+        int shadow_sets = 0;
+        for (int s = 0; s < sets; s += stride)
+            shadow_slot[s] = shadow_sets++;
+        for (const auto &p : portfolio)
+        {
+            Arm arm;
+            arm.name = p.first;
+            arm.live = p.second(sets, assoc);
+            arm.shadow = p.second(shadow_sets, assoc);
+            arm.shadow_lines.assign(shadow_sets, std::vector<CacheLine>(assoc));
+            arms.push_back(std::move(arm));
+        }
+    }
+
+    void reset() override
+    {
+        for (Arm &arm : arms)
+        {
+            arm.live->reset();
+            arm.shadow->reset();
+            for (std::vector<CacheLine> &set : arm.shadow_lines)
+                std::fill(set.begin(), set.end(), CacheLine());
+        }
+        cores.clear();
+        core = 0;
+        pending_tag = 0;
+    }
+
+    // Every arm's state plus each core's choice and evidence. Epoch counts,
+    // switches and regret only ever grow and decide nothing, so they stay out.
+    uint64_t state_hash() const override
+    {
+        uint64_t h = STATE_HASH_SEED;
+        for (const Arm &arm : arms)
+        {
+            uint64_t live = arm.live->state_hash(), shadow = arm.shadow->state_hash();
+            if (!live || !shadow)
+                return 0;
+            h = hash_value(hash_value(h, live), shadow);
+            for (const std::vector<CacheLine> &set : arm.shadow_lines)
+                for (const CacheLine &line : set)
+                    h = hash_line(h, line);
+        }
+        for (const CoreState &c : cores)
+        {
+            h = hash_table(hash_value(hash_value(h, c.active), c.accesses), c.hits);
+            h = hash_table(h, c.samples);
+            for (size_t a = 0; a < c.score.size(); a++)
+            {
+                uint64_t bits[2];
+                memcpy(&bits[0], &c.score[a], sizeof(double));
+                memcpy(&bits[1], &c.weight[a], sizeof(double));
+                h = hash_value(hash_value(h, bits[0]), bits[1]);
+            }
+        }
+        return h;
+    }
+
+    void checkpoint(StateArchive &a) override
+    {
+        a.expect((uint64_t)arms.size(), "bandit portfolio");
+        for (Arm &arm : arms)
+        {
+            arm.live->checkpoint(a);
+            arm.shadow->checkpoint(a);
+            a.io(arm.shadow_lines);
+        }
+        a.io(cores, core, pending_tag);
+    }
+
+    void set_core(int c) override { core = c; }
+
+    // Only the live arms see real lines; shadow sets don't track tiers
+    void set_tier_costs(const std::vector<int> &cost) override
+    {
+        ReplacementPolicy::set_tier_costs(cost);
+        for (Arm &arm : arms)
+            arm.live->set_tier_costs(cost);
+    }
+
+    void update_on_hit(int set_idx, int way, const CacheLine &line) override
+    {
+        CoreState &c = state();
+        shadow_access(set_idx, line.tag, line.pc, line.sharers, line.state, line.sharing, c);
+        for (Arm &arm : arms)
+            arm.live->update_on_hit(set_idx, way, line);
+        count_access(c);
+    }
+
+    void on_miss(int set_idx, uint64_t tag) override
+    {
+        pending_tag = tag;
+        for (Arm &arm : arms)
+            arm.live->on_miss(set_idx, tag);
+    }
+
+    int find_victim(int set_idx, const CacheLine *set, uint64_t pc, int sharers, MESI_State st) override
+    {
+        CoreState &c = state();
+        shadow_access(set_idx, pending_tag, pc, sharers, st, SHARING_UNCLASSIFIED, c);
+        int victim = arms[c.active].live->find_victim(set_idx, set, pc, sharers, st);
+        count_access(c);
+        return victim;
+    }
+
+    // The active arm's pick. The shadow sets only see misses the cache takes.
+    int peek_victim(int set_idx, const CacheLine *set, uint64_t tag, uint64_t pc, int sharers,
+                    MESI_State st) override
+    {
+        return arms[state().active].live->peek_victim(set_idx, set, tag, pc, sharers, st);
+    }
+
+    void on_evict(int set_idx, int way, const CacheLine &victim) override
+    {
+        for (Arm &arm : arms)
+            arm.live->on_evict(set_idx, way, victim);
+    }
+
+    void update_on_miss(int set_idx, int way, uint64_t pc, uint64_t tag) override
+    {
+        for (Arm &arm : arms)
+            arm.live->update_on_miss(set_idx, way, pc, tag);
+    }
+
+    void adopt(int set_idx, const CacheLine *set) override
+    {
+        for (Arm &arm : arms)
+            arm.live->adopt(set_idx, set);
+    }
+
+    void print_report(std::ostream &out) override
+    {
+        for (size_t i = 0; i < cores.size(); i++)
+        {
+            const CoreState &c = cores[i];
+            if (c.hits.empty())
+                continue;
+            out << "    core " << i << ": " << c.epochs << " epochs, " << c.switches << " switches, regret "
+                << std::fixed << std::setprecision(0) << c.regret << " misses |";
+            for (size_t a = 0; a < arms.size(); a++)
+                if (c.epochs_chosen[a])
+                    out << " " << arms[a].name << " " << c.epochs_chosen[a];
+            out << "\n      epochs:";
+            const size_t MAX_RUNS = 8;
+            for (size_t r = 0; r < c.runs.size() && r < MAX_RUNS; r++)
+                out << " " << arms[c.runs[r].first].name << " x" << c.runs[r].second;
+            if (c.runs.size() > MAX_RUNS)
+                out << " ... (" << c.runs.size() - MAX_RUNS << " more runs)";
+            out << "\n";
+        }
+    }
+
+    std::string name() override { return "Bandit (UCB)"; }
+};
@@ -0,0 +1,256 @@
+// ==========================================
+// SOFTWARE CACHE BENCHMARK
+// ==========================================
+// coalesce::Cache with the simulator's policies vs. a classic
+// std::list + std::unordered_map LRU on Zipfian key streams, then
+// throughput scaling of coalesce::ShardedCache vs. one global mutex.
+//
+//   g++ bench_cache.cpp -o bench_cache -O3 -pthread && ./bench_cache
+
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <list>
+#include <mutex>
+#include <thread>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "coalesce_cache.h"
+#include "coalesce_concurrent_cache.h"
+
+const size_t KEY_SPACE = 1 << 20;
+const size_t CACHE_ENTRIES = 1 << 16;
+const size_t OPS = 20000000;
+const double ZIPF_ALPHA = 0.99;
+
+const int MAX_THREADS = 32;
+
+const uint64_t SIG_HOT = 1;  // Point lookups from the request path
+const uint64_t SIG_SCAN = 2; // Batch job walking the keyspace once
+
+// ==========================================
+// BASELINE: LRU HASH MAP
+// ==========================================
+template <typename K, typename V>
+class LruHashMap
+{
+    size_t cap;
+    std::list<std::pair<K, V>> order; // Front = MRU
+    std::unordered_map<K, typename std::list<std::pair<K, V>>::iterator> index;
+
+public:
+    explicit LruHashMap(size_t capacity) : cap(capacity) { index.reserve(capacity * 2); }
+
+    V *get(const K &key)
+    {
+        auto it = index.find(key);
+        if (it == index.end())
+            return nullptr;
+        order.splice(order.begin(), order, it->second);
+        return &it->second->second;
+    }
+
+    void put(const K &key, V value)
+    {
+        auto it = index.find(key);
+        if (it != index.end())
+        {
+            it->second->second = std::move(value);
+            order.splice(order.begin(), order, it->second);
+            return;
+        }
+        if (index.size() == cap)
+        {
+            index.erase(order.back().first);
+            order.pop_back();
+        }
+        order.emplace_front(key, std::move(value));
+        index[key] = order.begin();
+    }
+};
+
+// ==========================================
+// WORKLOADS
+// ==========================================
+struct Op
+{
+    uint64_t key;
+    uint64_t sig;
+};
+
+std::vector<uint64_t> zipf_keys(size_t n, size_t key_space, double alpha, uint64_t seed)
+{
+    std::vector<double> cdf(key_space);
+    double sum = 0;
+    for (size_t i = 0; i < key_space; i++)
+    {
+        sum += 1.0 / std::pow((double)(i + 1), alpha);
+        cdf[i] = sum;
+    }
+
+    std::mt19937_64 rng(seed);
+    std::uniform_real_distribution<double> u(0.0, sum);
+    std::vector<uint64_t> keys(n);
+    for (size_t i = 0; i < n; i++)
+    {
+        size_t rank = std::lower_bound(cdf.begin(), cdf.end(), u(rng)) - cdf.begin();
+        keys[i] = rank * 0x9E3779B97F4A7C15ULL; // Scatter ranks over the key space
+    }
+    return keys;
+}
+
+std::vector<Op> workload_zipf()
+{
+    std::vector<Op> ops;
+    for (uint64_t k : zipf_keys(OPS, KEY_SPACE, ZIPF_ALPHA, 42))
+        ops.push_back({k, SIG_HOT});
+    return ops;
+}
+
+// Half the traffic is a one-pass scan that pollutes recency-based caches
+std::vector<Op> workload_zipf_scan()
+{
+    std::vector<Op> ops;
+    std::vector<uint64_t> hot = zipf_keys(OPS / 2, KEY_SPACE, ZIPF_ALPHA, 7);
+    for (size_t i = 0; i < hot.size(); i++)
+    {
+        ops.push_back({hot[i], SIG_HOT});
+        ops.push_back({(1ULL << 63) + i, SIG_SCAN});
+    }
+    return ops;
+}
+
+// ==========================================
+// DRIVER
+// ==========================================
+void report(const std::string &name, uint64_t hits, size_t ops, double secs)
+{
+    std::cout << std::left << std::setw(24) << name << " | Hit Rate: " << std::fixed << std::setprecision(2)
+              << std::setw(6) << 100.0 * hits / ops << "%"
+              << " | " << std::setprecision(1) << std::setw(6) << ops / secs / 1e6 << " Mops/s\n";
+}
+
+template <typename Policy>
+void bench_coalesce_cache(const std::string &name, const std::vector<Op> &ops, bool admission = false)
+{
+    coalesce::Cache<uint64_t, uint64_t, Policy> cache(CACHE_ENTRIES, WAYS, admission);
+    auto t0 = std::chrono::steady_clock::now();
+    for (const Op &op : ops)
+    {
+        // Read-through: miss -> "load" -> insert
+        if (!cache.get(op.key, op.sig))
+        {
+            coalesce::Cost cost = op.sig == SIG_SCAN ? coalesce::Cost::Cheap : coalesce::Cost::Normal;
+            cache.put(op.key, op.key * 3, op.sig, cost);
+        }
+    }
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    report(name, cache.stats.hits, ops.size(), secs);
+}
+
+void bench_lru_map(const std::vector<Op> &ops)
+{
+    LruHashMap<uint64_t, uint64_t> cache(CACHE_ENTRIES);
+    uint64_t hits = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    for (const Op &op : ops)
+    {
+        if (cache.get(op.key))
+            hits++;
+        else
+            cache.put(op.key, op.key * 3);
+    }
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    report("LRU hash map (list)", hits, ops.size(), secs);
+}
+
+void run_workload(const std::string &name, const std::vector<Op> &ops)
+{
+    std::cout << ">>> WORKLOAD: " << name << " (" << ops.size() << " ops, " << CACHE_ENTRIES << " entries)\n";
+    bench_lru_map(ops);
+    bench_coalesce_cache<LRU_Policy>("Cache<LRU>", ops);
+    bench_coalesce_cache<SRRIP_Policy>("Cache<SRRIP>", ops);
+    bench_coalesce_cache<SHiP_Policy>("Cache<SHiP>", ops);
+    bench_coalesce_cache<COALESCE_Policy>("Cache<COALESCE>", ops);
+    bench_coalesce_cache<LRU_Policy>("Cache<LRU>+TinyLFU", ops, true);
+    bench_coalesce_cache<COALESCE_Policy>("Cache<COALESCE>+TinyLFU", ops, true);
+    std::cout << "--------------------------------------------------------\n";
+}
+
+// ==========================================
+// THREAD SCALING
+// ==========================================
+// Every thread replays its own stride of the same Zipf stream against one
+// shared cache; throughput is total ops / wall time.
+template <typename Body>
+double run_threads(int threads, const std::vector<Op> &ops, Body body)
+{
+    std::vector<std::thread> pool;
+    auto t0 = std::chrono::steady_clock::now();
+    for (int t = 0; t < threads; t++)
+    {
+        pool.emplace_back([&, t]() {
+            for (size_t i = t; i < ops.size(); i += threads)
+                body(ops[i]);
+        });
+    }
+    for (auto &th : pool)
+        th.join();
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    return ops.size() / secs / 1e6;
+}
+
+void run_scaling(const std::vector<Op> &ops)
+{
+    std::cout << ">>> THREAD SCALING: Zipf(0.99), Mops/s (" << std::thread::hardware_concurrency()
+              << " hardware threads)\n";
+    std::cout << "Threads | Mutex+Cache<LRU> | Sharded<LRU> | Sharded<COALESCE>\n";
+
+    for (int threads = 1; threads <= MAX_THREADS; threads *= 2)
+    {
+        coalesce::Cache<uint64_t, uint64_t, LRU_Policy> locked(CACHE_ENTRIES);
+        std::mutex global;
+        double mutex_mops = run_threads(threads, ops, [&](const Op &op) {
+            std::lock_guard<std::mutex> g(global);
+            if (!locked.get(op.key, op.sig))
+                locked.put(op.key, op.key * 3, op.sig);
+        });
+
+        coalesce::ShardedCache<uint64_t, uint64_t, LRU_Policy> sharded_lru(CACHE_ENTRIES);
+        double lru_mops = run_threads(threads, ops, [&](const Op &op) {
+            uint64_t v;
+            if (!sharded_lru.get(op.key, v, op.sig))
+                sharded_lru.put(op.key, op.key * 3, op.sig);
+        });
+
+        coalesce::ShardedCache<uint64_t, uint64_t, COALESCE_Policy> sharded_coal(CACHE_ENTRIES);
+        double coal_mops = run_threads(threads, ops, [&](const Op &op) {
+            uint64_t v;
+            if (!sharded_coal.get(op.key, v, op.sig))
+                sharded_coal.put(op.key, op.key * 3, op.sig);
+        });
+
+        std::cout << std::right << std::setw(7) << threads << " | " << std::fixed << std::setprecision(1)
+                  << std::setw(16) << mutex_mops << " | " << std::setw(12) << lru_mops << " | " << std::setw(17)
+                  << coal_mops << "  (hit " << std::setprecision(2)
+                  << 100.0 * sharded_coal.hits / (sharded_coal.hits + sharded_coal.misses) << "%)\n";
+    }
+    std::cout << "--------------------------------------------------------\n";
+}
+
+int main()
+{
+    std::cout << "========================================================\n";
+    std::cout << "   COALESCE SOFTWARE CACHE BENCHMARK\n";
+    std::cout << "========================================================\n\n";
+
+    std::vector<Op> zipf = workload_zipf();
+    run_workload("Zipf(0.99)", zipf);
+    run_workload("Zipf(0.99) + one-pass scan", workload_zipf_scan());
+    run_scaling(zipf);
+    return 0;
+}
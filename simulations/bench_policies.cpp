@@ -0,0 +1,133 @@
+// ==========================================
+// POLICY DECISION BENCHMARK
+// ==========================================
+// Cost of one replacement decision (update_on_miss + find_victim + on_evict
+// on a full set) for the hardware-style policies vs. the RL agent, plus the
+// RL learner's cost per mini-batch. Misses draw from a pool of PCs so the
+// PC-indexed tables are exercised the way a real trace would.
+//
+//   g++ bench_policies.cpp -o bench_policies -O3 && ./bench_policies
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "coalesce_policies.h"
+#include "rl_policy.h"
+
+const int DECISIONS = 4000000;
+const int TRAIN_STEPS = 200000;
+const int PC_POOL = 256;
+
+volatile uint64_t sink; // Keeps the timed loops from being optimized away
+
+struct Miss
+{
+    int set;
+    uint64_t tag;
+    uint64_t pc;
+    int sharers;
+    MESI_State state;
+};
+
+std::vector<Miss> make_misses()
+{
+    std::mt19937_64 rng(1);
+    std::vector<Miss> misses(DECISIONS);
+    for (Miss &m : misses)
+    {
+        m.set = (int)(rng() % NUM_SETS);
+        m.tag = rng();
+        m.pc = 0x400000 + (rng() % PC_POOL) * 4;
+        m.sharers = (int)(rng() % 4);
+        m.state = m.sharers > 1 ? SHARED : (rng() & 1) ? MODIFIED : EXCLUSIVE;
+    }
+    return misses;
+}
+
+double bench_decisions(ReplacementPolicy &policy, const std::vector<Miss> &misses)
+{
+    std::vector<std::vector<CacheLine>> cache(NUM_SETS, std::vector<CacheLine>(WAYS));
+
+    // Fill every set first so all timed decisions pick a real victim
+    uint64_t fill_tag = 1;
+    for (int s = 0; s < NUM_SETS; s++)
+        for (int w = 0; w < WAYS; w++)
+        {
+            cache[s][w] = {fill_tag, 0x400000, 0, EXCLUSIVE};
+            policy.update_on_miss(s, w, 0x400000, fill_tag++);
+        }
+
+    uint64_t checksum = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    for (const Miss &m : misses)
+    {
+        std::vector<CacheLine> &set = cache[m.set];
+        policy.on_miss(m.set, m.tag);
+        int way = policy.find_victim(m.set, set.data(), m.pc, m.sharers, m.state);
+        policy.on_evict(m.set, way, set[way]);
+        set[way] = {m.tag, m.pc, m.sharers, m.state};
+        policy.update_on_miss(m.set, way, m.pc, m.tag);
+        checksum += way;
+    }
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    sink = checksum;
+    return secs * 1e9 / misses.size();
+}
+
+double bench_training()
+{
+    RLValueFunction model;
+    std::mt19937_64 rng(2);
+    std::vector<RLExperience> pool(RL_REPLAY_SIZE);
+    for (RLExperience &e : pool)
+    {
+        for (int f = 0; f < RL_FEATURES; f++)
+        {
+            e.features[f] = (uint16_t)(f * RL_TABLE_SIZE + rng() % RL_TABLE_SIZE);
+            e.next[f] = (uint16_t)(f * RL_TABLE_SIZE + rng() % RL_TABLE_SIZE);
+        }
+        e.reward = (rng() & 1) ? RL_ONE : 0;
+        e.discount = (uint16_t)(rng() % RL_ONE);
+        e.terminal = (rng() % 8) == 0;
+    }
+
+    auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < TRAIN_STEPS; i++)
+        model.train(&pool[(i * RL_BATCH) % (RL_REPLAY_SIZE - RL_BATCH)], RL_BATCH);
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    sink = model.updates;
+    return secs * 1e9 / TRAIN_STEPS;
+}
+
+void report(const std::string &name, double ns)
+{
+    std::cout << std::left << std::setw(16) << name << " | " << std::right << std::fixed << std::setprecision(1)
+              << std::setw(8) << ns << " ns/decision\n";
+}
+
+int main()
+{
+    std::cout << "========================================================\n";
+    std::cout << "   REPLACEMENT DECISION COST (" << NUM_SETS << " sets x " << WAYS << " ways)\n";
+    std::cout << "========================================================\n\n";
+
+    std::vector<Miss> misses = make_misses();
+
+    LRU_Policy lru;
+    report(lru.name(), bench_decisions(lru, misses));
+    SRRIP_Policy srrip;
+    report(srrip.name(), bench_decisions(srrip, misses));
+    COALESCE_Policy coalesce;
+    report(coalesce.name(), bench_decisions(coalesce, misses));
+    RL_Policy rl;
+    report(rl.name(), bench_decisions(rl, misses));
+
+    std::cout << "--------------------------------------------------------\n";
+    std::cout << std::left << std::setw(16) << "RL train step" << " | " << std::right << std::setw(8)
+              << bench_training() << " ns/mini-batch of " << RL_BATCH << "\n";
+    return 0;
+}
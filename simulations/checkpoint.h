@@ -0,0 +1,363 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iterator>
+#include <list>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <cerrno>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+
+// ==========================================
+// CHECKPOINTS (--checkpoint / --resume)
+// ==========================================
+// Every stateful class has one checkpoint(StateArchive &) method that lists
+// its members. The same method saves and restores them, so the two can't
+// drift apart. Trivially copyable members (counters, CacheLine, list heads)
+// go as raw bytes, containers as a count plus their elements, and members
+// with a checkpoint() of their own through it.
+//
+// Configuration (geometry, knobs, tier latencies) is not saved: a resumed
+// run is started with the same options, and the checkpoint records them so
+// a mismatch is refused instead of restored into the wrong shapes.
+//
+// The file is the archive followed by an FNV-1a checksum of it, written to
+// PATH.tmp and renamed over PATH, so PATH is always the last complete one.
+const char *const CHECKPOINT_MAGIC = "COALESCE-CKPT-1";
+
+class StateArchive;
+
+template <typename T, typename = void>
+struct has_checkpoint : std::false_type {};
+template <typename T>
+struct has_checkpoint<T, std::void_t<decltype(std::declval<T &>().checkpoint(std::declval<StateArchive &>()))>>
+    : std::true_type {};
+
+class StateArchive
+{
+    std::string *out = nullptr;      // Saving into
+    const std::string *in = nullptr; // Restoring from
+    size_t pos = 0;
+
+    void bytes(void *p, size_t n)
+    {
+        if (out)
+            out->append(static_cast<const char *>(p), n);
+        else if (!ok || n > in->size() - pos)
+        {
+            fail("checkpoint is truncated");
+            memset(p, 0, n);
+        }
+        else
+        {
+            memcpy(p, in->data() + pos, n);
+            pos += n;
+        }
+    }
+
+    // Element count of a container. On restore, more elements than bits
+    // left means a corrupt count, not a huge container.
+    size_t count(size_t n)
+    {
+        uint64_t v = n;
+        bytes(&v, sizeof(v));
+        if (in && v / 8 > in->size() - pos)
+        {
+            fail("checkpoint is truncated");
+            return 0;
+        }
+        return (size_t)v;
+    }
+
+    template <typename T> void item(T &v)
+    {
+        if constexpr (has_checkpoint<T>::value)
+            v.checkpoint(*this);
+        else
+        {
+            static_assert(std::is_trivially_copyable<T>::value, "give this type a checkpoint() method");
+            bytes(&v, sizeof(v));
+        }
+    }
+
+    void item(std::string &s)
+    {
+        s.resize(count(s.size()));
+        bytes(&s[0], s.size());
+    }
+
+    template <typename A, typename B> void item(std::pair<A, B> &p) { io(p.first, p.second); }
+
+    template <typename T, typename Alloc> void item(std::vector<T, Alloc> &v)
+    {
+        v.resize(count(v.size()));
+        if constexpr (std::is_trivially_copyable<T>::value && !has_checkpoint<T>::value)
+            bytes(v.data(), v.size() * sizeof(T));
+        else
+            for (T &x : v)
+                item(x);
+    }
+
+    // Packed 8 to a byte
+    void item(std::vector<bool> &v)
+    {
+        v.resize(count(v.size()));
+        std::vector<uint8_t> packed((v.size() + 7) / 8, 0);
+        for (size_t i = 0; out && i < v.size(); i++)
+            packed[i / 8] |= v[i] << (i % 8);
+        bytes(packed.data(), packed.size());
+        for (size_t i = 0; in && i < v.size(); i++)
+            v[i] = packed[i / 8] >> (i % 8) & 1;
+    }
+
+    // Lists and deques restore in order
+    template <typename C> void sequence(C &c)
+    {
+        size_t n = count(c.size());
+        if (out)
+        {
+            for (auto &x : c)
+                item(x);
+            return;
+        }
+        c.clear();
+        for (size_t i = 0; i < n && ok; i++)
+        {
+            typename C::value_type x{};
+            item(x);
+            c.push_back(std::move(x));
+        }
+    }
+
+    template <typename T, typename Alloc> void item(std::list<T, Alloc> &l) { sequence(l); }
+    template <typename T, typename Alloc> void item(std::deque<T, Alloc> &d) { sequence(d); }
+
+    template <typename K, typename V, typename H, typename E, typename Alloc>
+    void item(std::unordered_map<K, V, H, E, Alloc> &m)
+    {
+        size_t n = count(m.size());
+        if (out)
+        {
+            for (auto &kv : m)
+            {
+                K key = kv.first;
+                io(key, kv.second);
+            }
+            return;
+        }
+        m.clear();
+        m.reserve(n);
+        for (size_t i = 0; i < n && ok; i++)
+        {
+            K key{};
+            V value{};
+            io(key, value);
+            m.emplace(std::move(key), std::move(value));
+        }
+    }
+
+public:
+    bool ok = true;
+    std::string error;
+
+    static StateArchive saving(std::string &buffer)
+    {
+        StateArchive a;
+        a.out = &buffer;
+        return a;
+    }
+
+    static StateArchive restoring(const std::string &buffer)
+    {
+        StateArchive a;
+        a.in = &buffer;
+        return a;
+    }
+
+    bool loading() const { return in != nullptr; }
+    bool at_end() const { return !in || pos == in->size(); }
+
+    bool fail(const std::string &msg)
+    {
+        if (ok)
+            error = msg;
+        ok = false;
+        return false;
+    }
+
+    template <typename... T> void io(T &...v) { (item(v), ...); }
+
+    // A fixed-size block, e.g. an arena of cache lines
+    template <typename T> void span(T *p, size_t n)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "span() copies raw bytes");
+        if (count(n) != n)
+            fail("checkpoint was taken with a different cache geometry");
+        else
+            bytes(p, n * sizeof(T));
+    }
+
+    // Something the restoring side must already agree on (a size, a name)
+    template <typename T> void expect(T value, const char *what)
+    {
+        T saved = value;
+        item(saved);
+        if (saved != value)
+            fail(std::string("checkpoint does not match this run: ") + what);
+    }
+};
+
+inline uint64_t checkpoint_checksum(const std::string &data)
+{
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (unsigned char c : data)
+        h = (h ^ c) * 0x100000001b3ULL;
+    return h;
+}
+
+// Whole file minus the checksum into `archive`. False with `error` set when
+// the file is missing, torn or corrupt.
+inline bool read_checkpoint(const std::string &path, std::string &archive, std::string &error)
+{
+    std::ifstream in(path, std::ios::binary);
+    if (!in)
+    {
+        error = "no checkpoint at " + path;
+        return false;
+    }
+    archive.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    uint64_t sum = 0;
+    if (archive.size() < sizeof(sum))
+    {
+        error = path + " is not a checkpoint";
+        return false;
+    }
+    memcpy(&sum, archive.data() + archive.size() - sizeof(sum), sizeof(sum));
+    archive.resize(archive.size() - sizeof(sum));
+    if (sum != checkpoint_checksum(archive))
+    {
+        error = path + ": checksum mismatch (corrupt checkpoint)";
+        return false;
+    }
+    return true;
+}
+
+// Writes snapshots on a background thread, so the run only pauses for the
+// in-memory copy. A snapshot that arrives while the previous one is still
+// being written replaces any that is waiting: only the newest matters.
+class CheckpointWriter
+{
+    std::string path;
+    std::mutex mu;
+    std::condition_variable wake;
+    std::string pending;
+    bool has_pending = false;
+    bool stopping = false;
+    std::thread worker;
+
+    bool write_file(std::string &data)
+    {
+        uint64_t sum = checkpoint_checksum(data);
+        data.append(reinterpret_cast<const char *>(&sum), sizeof(sum));
+        std::string tmp = path + ".tmp";
+        int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0)
+            return fail("cannot create " + tmp);
+        for (size_t done = 0; done < data.size();)
+        {
+            ssize_t put = ::write(fd, data.data() + done, data.size() - done);
+            if (put < 0 && errno == EINTR)
+                continue;
+            if (put <= 0)
+            {
+                ::close(fd);
+                return fail("write " + tmp + ": " + strerror(errno));
+            }
+            done += put;
+        }
+        // On disk before it replaces the last good one
+        bool synced = fsync(fd) == 0;
+        ::close(fd);
+        if (!synced || rename(tmp.c_str(), path.c_str()) != 0)
+            return fail("cannot replace " + path + ": " + strerror(errno));
+        return true;
+    }
+
+    bool fail(const std::string &msg)
+    {
+        std::lock_guard<std::mutex> lock(mu);
+        error = msg;
+        failed++;
+        return false;
+    }
+
+    void run()
+    {
+        std::unique_lock<std::mutex> lock(mu);
+        for (;;)
+        {
+            wake.wait(lock, [&]() { return has_pending || stopping; });
+            if (!has_pending)
+                return;
+            std::string data;
+            data.swap(pending);
+            has_pending = false;
+            lock.unlock();
+            bool ok = write_file(data);
+            lock.lock();
+            if (ok)
+            {
+                written++;
+                bytes = data.size();
+            }
+        }
+    }
+
+public:
+    // Read after finish()
+    uint64_t written = 0;
+    uint64_t replaced = 0; // Superseded before they were written
+    uint64_t failed = 0;
+    uint64_t bytes = 0;    // Size of the last one written
+    std::string error;     // Last failure
+
+    explicit CheckpointWriter(const std::string &file) : path(file), worker([this]() { run(); }) {}
+
+    ~CheckpointWriter() { finish(); }
+
+    void submit(std::string &&snapshot)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mu);
+            replaced += has_pending;
+            pending = std::move(snapshot);
+            has_pending = true;
+        }
+        wake.notify_one();
+    }
+
+    // Writes what is still pending, then stops the thread
+    void finish()
+    {
+        if (!worker.joinable())
+            return;
+        {
+            std::lock_guard<std::mutex> lock(mu);
+            stopping = true;
+        }
+        wake.notify_one();
+        worker.join();
+    }
+};
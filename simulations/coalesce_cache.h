@@ -0,0 +1,263 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "coalesce_policies.h"
+
+// ==========================================
+// COALESCE SOFTWARE CACHE (Embeddable Library)
+// ==========================================
+// A set-associative key/value cache driven by the same ReplacementPolicy
+// classes as the simulator, so a policy evaluated on traces can be dropped
+// into an application as-is:
+//
+//   coalesce::Cache<std::string, Blob, COALESCE_Policy> cache(1 << 20);
+//   if (Blob *b = cache.get(key, SIG_USER_PROFILE)) ...
+//   else cache.put(key, load(key), SIG_USER_PROFILE, coalesce::Cost::Expensive);
+//
+// Mapping onto the hardware features COALESCE was built around:
+//   signature -> PC       (caller-chosen id of the code path / object class)
+//   Cost      -> MESI     (how painful a miss is to refill)
+//   sharers   -> sharers  (optional: how many consumers depend on the entry)
+//
+// Every operation touches one set of `ways` entries, so get/put/erase are
+// O(ways) = O(1) in the cache size. Not thread-safe; see
+// coalesce_concurrent_cache.h for the sharded version.
+//
+// Passing admission = true puts a W-TinyLFU filter in front of the policy:
+// new entries wait in a small LRU window (1% of capacity, on top of it) and
+// only displace a resident entry once they have been seen more often.
+// Protects the cache from one-hit wonders at the cost of a hash-map lookup
+// on misses.
+namespace coalesce
+{
+
+enum class Cost
+{
+    Cheap = EXCLUSIVE,  // Recomputed or refetched cheaply
+    Normal = SHARED,
+    Expensive = MODIFIED // Slow backend / large recompute: COALESCE protects it
+};
+
+struct CacheStats
+{
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t insertions = 0;
+    uint64_t evictions = 0;
+
+    double hit_rate() const { return hits + misses ? 100.0 * hits / (hits + misses) : 0.0; }
+};
+
+// K and V must be default-constructible and assignable; slots are
+// preallocated so steady-state operation never allocates.
+template <typename K, typename V, typename Policy = COALESCE_Policy, typename Hash = std::hash<K>>
+class Cache
+{
+    int num_sets;
+    int ways;
+    uint64_t set_mask;
+    Hash hasher;
+    Policy policy;
+
+    std::vector<std::vector<CacheLine>> meta; // Policy-visible line metadata, per set
+    std::vector<K> keys;                      // [set * ways + way]
+    std::vector<V> values;
+
+    struct Pending
+    {
+        V value;
+        uint64_t signature;
+        MESI_State state;
+        int sharers;
+    };
+    std::unique_ptr<TinyLFU> admission;
+    std::unique_ptr<AdmissionWindow<K, Pending, Hash>> window;
+
+public:
+    CacheStats stats;
+
+    // capacity is rounded up to a power-of-two number of sets
+    explicit Cache(size_t capacity, int assoc = WAYS, bool admission_filter = false)
+        : num_sets(sets_for(capacity, assoc)), ways(assoc), set_mask(num_sets - 1),
+          policy(num_sets, assoc), meta(num_sets, std::vector<CacheLine>(assoc)),
+          keys((size_t)num_sets * assoc), values((size_t)num_sets * assoc)
+    {
+        if (admission_filter)
+        {
+            admission = std::make_unique<TinyLFU>(this->capacity());
+            window = std::make_unique<AdmissionWindow<K, Pending, Hash>>(TinyLFU::window_size(this->capacity()));
+        }
+    }
+
+    size_t capacity() const { return (size_t)num_sets * ways; }
+    Policy &replacement_policy() { return policy; }
+    const TinyLFU *admission_filter() const { return admission.get(); }
+
+    // Returns the cached value or nullptr. The pointer is valid until the next put().
+    V *get(const K &key, uint64_t signature = 0)
+    {
+        uint64_t h = hasher(key);
+        int set_idx = set_of(h);
+        int w = find(set_idx, h, key);
+        if (admission)
+            admission->record(h);
+        if (w < 0)
+        {
+            if (window)
+            {
+                if (Pending *p = window->touch(key))
+                {
+                    stats.hits++;
+                    p->signature = signature;
+                    return &p->value;
+                }
+            }
+            stats.misses++;
+            return nullptr;
+        }
+        stats.hits++;
+        CacheLine &line = meta[set_idx][w];
+        line.pc = signature;
+        policy.update_on_hit(set_idx, w, line);
+        return &values[slot(set_idx, w)];
+    }
+
+    bool contains(const K &key) const
+    {
+        uint64_t h = hasher(key);
+        return find(set_of(h), h, key) >= 0 || (window && window->contains(key));
+    }
+
+    // Inserts or overwrites. Returns true if another entry had to be evicted.
+    bool put(const K &key, V value, uint64_t signature = 0, Cost cost = Cost::Normal, int sharers = 0)
+    {
+        uint64_t h = hasher(key);
+        int set_idx = set_of(h);
+        MESI_State state = (MESI_State)cost;
+
+        int w = find(set_idx, h, key);
+        if (w >= 0)
+        {
+            CacheLine &line = meta[set_idx][w];
+            line.pc = signature;
+            line.sharers = std::min(sharers, 255);
+            line.state = state;
+            values[slot(set_idx, w)] = std::move(value);
+            policy.update_on_hit(set_idx, w, line);
+            return false;
+        }
+
+        if (!window)
+            return install(set_idx, h, key, std::move(value), signature, state, sharers);
+
+        if (Pending *p = window->touch(key))
+        {
+            *p = Pending{std::move(value), signature, state, sharers};
+            return false;
+        }
+        std::pair<K, Pending> out;
+        if (!window->insert(key, Pending{std::move(value), signature, state, sharers}, out))
+            return false;
+
+        // The window overflowed: its LRU entry competes for a slot in the main cache
+        uint64_t ch = hasher(out.first);
+        int cset = set_of(ch);
+        // The policy only hears of the miss once the candidate wins
+        Pending &c = out.second;
+        const CacheLine *set = meta[cset].data();
+        int victim = policy.peek_victim(cset, set, ch, c.signature, c.sharers, c.state);
+        bool peeked = victim >= 0;
+        if (peeked && set[victim].valid && !admission->admit(ch, set[victim].tag))
+        {
+            stats.evictions++; // The candidate itself is what leaves
+            return true;
+        }
+        policy.on_miss(cset, ch);
+        victim = policy.find_victim(cset, set, c.signature, c.sharers, c.state);
+        if (!peeked && set[victim].valid && !admission->admit(ch, set[victim].tag))
+        {
+            stats.evictions++;
+            return true;
+        }
+        return install_at(cset, victim, ch, out.first, std::move(c.value), c.signature, c.state, c.sharers);
+    }
+
+    bool erase(const K &key)
+    {
+        if (window && window->erase(key))
+            return true;
+        uint64_t h = hasher(key);
+        int set_idx = set_of(h);
+        int w = find(set_idx, h, key);
+        if (w < 0)
+            return false;
+        // An invalid way is every policy's first choice on the next miss
+        meta[set_idx][w].valid = false;
+        keys[slot(set_idx, w)] = K();
+        values[slot(set_idx, w)] = V();
+        return true;
+    }
+
+private:
+    bool install(int set_idx, uint64_t h, const K &key, V value, uint64_t signature, MESI_State state, int sharers)
+    {
+        policy.on_miss(set_idx, h);
+        int victim = policy.find_victim(set_idx, meta[set_idx].data(), signature, sharers, state);
+        return install_at(set_idx, victim, h, key, std::move(value), signature, state, sharers);
+    }
+
+    bool install_at(int set_idx, int victim, uint64_t h, const K &key, V value, uint64_t signature,
+                    MESI_State state, int sharers)
+    {
+        CacheLine &line = meta[set_idx][victim];
+        bool evicted = line.valid;
+        if (evicted)
+        {
+            stats.evictions++;
+            policy.on_evict(set_idx, victim, line);
+        }
+
+        line = CacheLine();
+        line.valid = true;
+        line.tag = h;
+        line.pc = signature;
+        line.sharers = std::min(sharers, 255);
+        line.state = state;
+        keys[slot(set_idx, victim)] = key;
+        values[slot(set_idx, victim)] = std::move(value);
+        stats.insertions++;
+        policy.update_on_miss(set_idx, victim, signature, h);
+        return evicted;
+    }
+
+    static int sets_for(size_t capacity, int assoc)
+    {
+        size_t sets = 1;
+        while (sets * assoc < capacity)
+            sets <<= 1;
+        return (int)sets;
+    }
+
+    // std::hash is the identity for integers, so fold the high bits in
+    int set_of(uint64_t h) const { return (int)((h ^ (h >> 29) ^ (h >> 47)) & set_mask); }
+    size_t slot(int set_idx, int way) const { return (size_t)set_idx * ways + way; }
+
+    int find(int set_idx, uint64_t h, const K &key) const
+    {
+        const std::vector<CacheLine> &set = meta[set_idx];
+        for (int w = 0; w < ways; w++)
+        {
+            if (set[w].valid && set[w].tag == h && keys[slot(set_idx, w)] == key)
+                return w;
+        }
+        return -1;
+    }
+};
+
+} // namespace coalesce
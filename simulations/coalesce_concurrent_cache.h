@@ -0,0 +1,355 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "coalesce_cache.h"
+
+// ==========================================
+// SHARDED CONCURRENT SOFTWARE CACHE
+// ==========================================
+// coalesce::Cache for many threads. The keyspace is split over shards; each
+// shard is an independent set-associative cache with its own policy instance
+// (and so its own PerceptronBrain for COALESCE).
+//
+//   get()  - lock-free. Readers scan the set and copy the value inside a
+//            per-shard seqlock window and retry if a writer got in between.
+//            The hit is NOT applied to the policy right away: it goes into
+//            a per-thread buffer, applied in bulk later.
+//   put()  - takes the shard's writer lock, picks a victim and publishes
+//            the new entry under the seqlock. Buffered hits are applied when
+//            a thread's buffer fills, skipping shards whose lock is busy.
+//
+// Deferred hits make replacement slightly stale (by at most HIT_BUFFER
+// accesses per thread), which is the price for keeping the read path free of
+// stores to shared policy state. Per-shard brains are averaged every
+// average_interval puts so shards with little traffic still learn.
+//
+// Because readers copy entries that may be concurrently overwritten, K and V
+// must be trivially copyable (ids, handles, small PODs, offsets into a slab).
+namespace coalesce
+{
+
+template <typename P, typename = void>
+struct has_perceptron : std::false_type {};
+template <typename P>
+struct has_perceptron<P, std::void_t<decltype(std::declval<P &>().perceptron())>> : std::true_type {};
+
+template <typename K, typename V, typename Policy = COALESCE_Policy, typename Hash = std::hash<K>>
+class ShardedCache
+{
+    static_assert(std::is_trivially_copyable<K>::value && std::is_trivially_copyable<V>::value,
+                  "ShardedCache copies entries optimistically; K and V must be trivially copyable");
+
+    static constexpr int HIT_BUFFER = 64;        // Deferred hits per thread slot
+    static constexpr int THREAD_SLOTS = 256;     // Threads beyond this share slots
+    static constexpr uint64_t EMPTY_TAG = 0;
+
+    struct alignas(64) Shard
+    {
+        std::atomic<uint64_t> seq{0}; // Odd while a writer is publishing
+        std::mutex write_lock;        // Serializes writers and policy updates
+        Policy policy;
+        std::vector<std::vector<CacheLine>> meta; // Policy view, writer-owned
+        std::unique_ptr<std::atomic<uint64_t>[]> tags; // Reader view, EMPTY_TAG = free
+        std::vector<K> keys;
+        std::vector<V> values;
+
+        Shard(int sets, int ways)
+            : policy(sets, ways), meta(sets, std::vector<CacheLine>(ways)),
+              tags(new std::atomic<uint64_t>[(size_t)sets * ways]), keys((size_t)sets * ways), values((size_t)sets * ways)
+        {
+            for (size_t i = 0; i < (size_t)sets * ways; i++)
+                tags[i].store(EMPTY_TAG, std::memory_order_relaxed);
+        }
+    };
+
+    struct DeferredHit
+    {
+        uint32_t shard;
+        uint32_t slot;
+        uint64_t tag;
+        uint64_t signature;
+    };
+
+    struct alignas(64) HitBuffer
+    {
+        std::atomic_flag busy = ATOMIC_FLAG_INIT; // Only contended past THREAD_SLOTS threads
+        int count = 0;
+        DeferredHit hits[HIT_BUFFER];
+    };
+
+    int num_shards;
+    int sets_per_shard;
+    int ways;
+    Hash hasher;
+    std::vector<std::unique_ptr<Shard>> shards;
+    std::unique_ptr<HitBuffer[]> buffers;
+
+    uint64_t average_interval;
+    std::atomic<uint64_t> puts_since_average{0};
+    std::mutex average_lock;
+
+public:
+    std::atomic<uint64_t> hits{0};
+    std::atomic<uint64_t> misses{0};
+    std::atomic<uint64_t> read_retries{0};
+    std::atomic<uint64_t> weight_averages{0};
+
+    ShardedCache(size_t capacity, int shard_count = 64, int assoc = WAYS, uint64_t average_every = 1 << 16)
+        : num_shards(round_pow2(shard_count)), ways(assoc), buffers(new HitBuffer[THREAD_SLOTS]),
+          average_interval(average_every)
+    {
+        size_t per_shard = (capacity + num_shards - 1) / num_shards;
+        sets_per_shard = (int)round_pow2((per_shard + assoc - 1) / assoc);
+        for (int i = 0; i < num_shards; i++)
+            shards.emplace_back(new Shard(sets_per_shard, assoc));
+    }
+
+    size_t capacity() const { return (size_t)num_shards * sets_per_shard * ways; }
+
+    // Copies the value out on a hit. Never blocks.
+    bool get(const K &key, V &out, uint64_t signature = 0)
+    {
+        uint64_t h = tag_of(hasher(key));
+        Shard &sh = *shards[shard_of(h)];
+        int set_idx = set_of(h);
+        size_t base = (size_t)set_idx * ways;
+
+        while (true)
+        {
+            uint64_t s0 = sh.seq.load(std::memory_order_acquire);
+            if (s0 & 1)
+            {
+                read_retries.fetch_add(1, std::memory_order_relaxed);
+                std::this_thread::yield(); // Writer mid-publish; don't burn its timeslice
+                continue;
+            }
+
+            int found = -1;
+            alignas(K) unsigned char kbuf[sizeof(K)];
+            alignas(V) unsigned char vbuf[sizeof(V)];
+            for (int w = 0; w < ways; w++)
+            {
+                if (sh.tags[base + w].load(std::memory_order_relaxed) != h)
+                    continue;
+                memcpy(kbuf, (const void *)&sh.keys[base + w], sizeof(K));
+                memcpy(vbuf, (const void *)&sh.values[base + w], sizeof(V));
+                found = w;
+                break;
+            }
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (sh.seq.load(std::memory_order_relaxed) != s0)
+            {
+                read_retries.fetch_add(1, std::memory_order_relaxed);
+                continue; // A writer touched this shard, copies may be torn
+            }
+
+            if (found >= 0 && *reinterpret_cast<const K *>(kbuf) == key)
+            {
+                memcpy((void *)&out, vbuf, sizeof(V));
+                hits.fetch_add(1, std::memory_order_relaxed);
+                defer_hit(shard_of(h), (uint32_t)(base + found), h, signature);
+                return true;
+            }
+            misses.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+    }
+
+    void put(const K &key, const V &value, uint64_t signature = 0, Cost cost = Cost::Normal, int sharers = 0)
+    {
+        uint64_t h = tag_of(hasher(key));
+        int shard_idx = shard_of(h);
+        Shard &sh = *shards[shard_idx];
+        int set_idx = set_of(h);
+        size_t base = (size_t)set_idx * ways;
+        MESI_State state = (MESI_State)cost;
+
+        {
+            std::lock_guard<std::mutex> guard(sh.write_lock);
+            std::vector<CacheLine> &set = sh.meta[set_idx];
+
+            int way = -1;
+            for (int w = 0; w < ways; w++)
+            {
+                if (set[w].valid && set[w].tag == h && sh.keys[base + w] == key)
+                {
+                    way = w;
+                    break;
+                }
+            }
+
+            bool is_new = way < 0;
+            if (is_new)
+            {
+                sh.policy.on_miss(set_idx, h);
+                way = sh.policy.find_victim(set_idx, set.data(), signature, sharers, state);
+                if (set[way].valid)
+                    sh.policy.on_evict(set_idx, way, set[way]);
+            }
+
+            // Publish under the seqlock so readers never see a half-written entry
+            sh.seq.fetch_add(1, std::memory_order_acq_rel);
+            std::atomic_thread_fence(std::memory_order_release);
+            sh.tags[base + way].store(h, std::memory_order_relaxed);
+            sh.keys[base + way] = key;
+            sh.values[base + way] = value;
+            sh.seq.fetch_add(1, std::memory_order_release);
+
+            CacheLine &line = set[way];
+            if (is_new)
+                line = CacheLine();
+            line.valid = true;
+            line.tag = h;
+            line.pc = signature;
+            line.sharers = std::min(sharers, 255);
+            line.state = state;
+            if (is_new)
+                sh.policy.update_on_miss(set_idx, way, signature, h);
+            else
+                sh.policy.update_on_hit(set_idx, way, line);
+        }
+
+        maybe_average();
+    }
+
+    bool erase(const K &key)
+    {
+        uint64_t h = tag_of(hasher(key));
+        Shard &sh = *shards[shard_of(h)];
+        int set_idx = set_of(h);
+        size_t base = (size_t)set_idx * ways;
+
+        std::lock_guard<std::mutex> guard(sh.write_lock);
+        for (int w = 0; w < ways; w++)
+        {
+            CacheLine &line = sh.meta[set_idx][w];
+            if (line.valid && line.tag == h && sh.keys[base + w] == key)
+            {
+                sh.seq.fetch_add(1, std::memory_order_acq_rel);
+                sh.tags[base + w].store(EMPTY_TAG, std::memory_order_relaxed);
+                sh.seq.fetch_add(1, std::memory_order_release);
+                line.valid = false;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Applies the calling thread's deferred hits now (e.g. before it exits)
+    void flush_thread()
+    {
+        HitBuffer &buf = buffers[thread_slot()];
+        if (buf.busy.test_and_set(std::memory_order_acquire))
+            return;
+        drain(buf);
+        buf.busy.clear(std::memory_order_release);
+    }
+
+private:
+    static size_t round_pow2(size_t n)
+    {
+        size_t p = 1;
+        while (p < n)
+            p <<= 1;
+        return p;
+    }
+
+    static uint64_t tag_of(uint64_t h)
+    {
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL; // Mix so std::hash<int> identity keys spread
+        h ^= h >> 33;
+        return h == EMPTY_TAG ? 1 : h;
+    }
+    int shard_of(uint64_t h) const { return (int)(h >> 48) & (num_shards - 1); }
+    int set_of(uint64_t h) const { return (int)h & (sets_per_shard - 1); }
+
+    static int thread_slot()
+    {
+        static std::atomic<int> next{0};
+        thread_local int slot = next.fetch_add(1, std::memory_order_relaxed) % THREAD_SLOTS;
+        return slot;
+    }
+
+    void defer_hit(int shard_idx, uint32_t slot, uint64_t tag, uint64_t signature)
+    {
+        HitBuffer &buf = buffers[thread_slot()];
+        if (buf.busy.test_and_set(std::memory_order_acquire))
+            return; // Shared slot in use: drop the hint, replacement stays correct
+        buf.hits[buf.count++] = {(uint32_t)shard_idx, slot, tag, signature};
+        if (buf.count == HIT_BUFFER)
+            drain(buf);
+        buf.busy.clear(std::memory_order_release);
+    }
+
+    // Applies buffered hits shard by shard. Shards whose lock is contended
+    // are skipped: a hit hint is worth less than a stalled reader.
+    void drain(HitBuffer &buf)
+    {
+        for (int i = 0; i < buf.count; i++)
+        {
+            DeferredHit &d = buf.hits[i];
+            if (d.tag == EMPTY_TAG)
+                continue;
+            Shard &sh = *shards[d.shard];
+            std::unique_lock<std::mutex> guard(sh.write_lock, std::try_to_lock);
+            if (!guard.owns_lock())
+                continue;
+            for (int j = i; j < buf.count; j++)
+            {
+                DeferredHit &e = buf.hits[j];
+                if (e.shard != d.shard || e.tag == EMPTY_TAG)
+                    continue;
+                int set_idx = e.slot / ways;
+                int way = e.slot % ways;
+                CacheLine &line = sh.meta[set_idx][way];
+                if (line.valid && line.tag == e.tag) // Entry may have been replaced since
+                {
+                    line.pc = e.signature;
+                    sh.policy.update_on_hit(set_idx, way, line);
+                }
+                e.tag = EMPTY_TAG;
+            }
+        }
+        buf.count = 0;
+    }
+
+    void maybe_average()
+    {
+        if constexpr (has_perceptron<Policy>::value)
+        {
+            if (puts_since_average.fetch_add(1, std::memory_order_relaxed) + 1 < average_interval)
+                return;
+            std::unique_lock<std::mutex> once(average_lock, std::try_to_lock);
+            if (!once.owns_lock())
+                return; // Someone else is already averaging
+            puts_since_average.store(0, std::memory_order_relaxed);
+
+            // Writers are paused one shard at a time in index order; readers
+            // never look at the weights.
+            std::vector<std::unique_lock<std::mutex>> locks;
+            std::vector<PerceptronBrain *> brains;
+            for (auto &sh : shards)
+            {
+                locks.emplace_back(sh->write_lock);
+                brains.push_back(&sh->policy.perceptron());
+            }
+            PerceptronBrain::average(brains);
+            weight_averages.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+};
+
+} // namespace coalesce
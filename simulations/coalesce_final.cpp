@@ -6,705 +6,601 @@
 #include <cstdint>
 #include <algorithm>
 #include <map>
+#include <unordered_map>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <mutex>
+#include <sstream>
+
+#include <cerrno>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "arena.h"
+#include "bandit_policy.h"
+#include "coalesce_policies.h"
+#include "coalesce_sweep.h"
+#include "memory_tiers.h"
+#include "miniature.h"
+#include "object_cache.h"
+#include "result_cache.h"
+#include "rl_policy.h"
+#include "rl_trainer.h"
+#include "steady_state.h"
+#include "topology.h"
+#include "trace.h"
+#include "trace_summary.h"
 
 // ==========================================
-// CONFIGURATION & CONSTANTS
+// COHERENCE DIRECTORY (for raw traces)
 // ==========================================
-const int NUM_SETS = 64;
-const int WAYS = 16;
-const int CACHE_SIZE_LINES = NUM_SETS * WAYS;
-
-// Latency & Energy Constants (Cycles/Units)
-const int LATENCY_L3_HIT = 15;
-const int LATENCY_DRAM = 200;
-const int LATENCY_COHERENCE_PENALTY = 100; // Extra cost for evicting Modified/Shared lines
-
-// Perceptron Config
-const int PERCEPTRON_TABLE_SIZE = 2048; // Two tables of 2048 = 4096 total weights (<5KB)
-const int MAX_WEIGHT = 127;
-const int MIN_WEIGHT = -128;
-const int THRESHOLD = 35;      // Training threshold (increased from 25 for stability)
-const int VETO_OVERRIDE = -100; // If vote < -100, ignore Coherence Veto (Definitely Dead)
-
-// Bloom Filter Config (Ghost Buffer)
-const int BLOOM_SIZE = 1024; // 1024 bits
-const int BLOOM_HASHES = 3;
-
-// SHiP / SDBP Config
-const int SHCT_SIZE = 1024; // Signature History Counter Table size
-
-// Sampling Config
-const int SAMPLING_MODULO = 16; // Sample 1 in 16 sets (6.25% instead of 3%)
-
-// ==========================================
-// DATA STRUCTURES
-// ==========================================
-
-enum MESI_State
-{
-    INVALID = 0,
-    SHARED = 1,
-    EXCLUSIVE = 2,
-    MODIFIED = 3
-};
-
-struct CacheLine
-{
-    bool valid = false;
-    uint64_t tag = 0;
-    uint64_t pc = 0;
-    int sharers = 0;
-    MESI_State state = INVALID;
-
-    // For Replacement Policies
-    int lru_stack = 0;               // 0=MRU, 15=LRU
-    int rrpv = 3;                    // 2-bit RRPV (3=Distant, 0=Immediate)
-    bool is_dead_prediction = false; // For SDBP
-};
-
-// ==========================================
-// GHOST BUFFER ENTRY (Fixed Implementation)
-// ==========================================
-// FIX: Store complete feature vector, not just tag+PC
-// struct GhostEntry
-// {
-//     uint64_t tag;
-//     uint64_t pc;
-//     int sharers;
-//     MESI_State state;
-    
-//     GhostEntry() : tag(0), pc(0), sharers(0), state(INVALID) {}
-//     GhostEntry(uint64_t t, uint64_t p, int s, MESI_State st) 
-//         : tag(t), pc(p), sharers(s), state(st) {}
-// };
-// ==========================================
-// COMPACT GHOST ENTRY (Flit-Compatible)
-// ==========================================
-// This matches the 12-bit PC signature that will be transported
-// via NoC flit piggybacking in the hardware implementation.
-// Total storage: 32 bits (4 bytes) per entry
-struct CompactGhostEntry
+// Instrumented programs only know (core, address, r/w). This directory
+// replays the MESI transitions of old/mesi_sim.cpp with a sharer bitmask per
+// line so those traces carry the same sharers/state features as the
+// synthetic scenarios. Memory grows with the trace footprint, not its length.
+//
+// The same request history classifies each line's sharing pattern:
+//   private           - only one core has touched it so far
+//   read-shared       - several cores, never written once shared
+//   migratory         - core B reads then writes what core A wrote last
+//                       (read-modify-write moving from core to core)
+//   producer-consumer - the last writer writes again after others read it
+//   write-shared      - written by several cores, neither pattern above
+// Migratory and producer-consumer evidence are 2-bit counters that push
+// each other down, so a line that changes habits is reclassified.
+class CoherenceDirectory
 {
-    uint32_t packed; // Bit-packed: [PC_sig(12) | Tag_partial(14) | Sharers(3) | State(2) | Valid(1)]
-    
-    CompactGhostEntry() : packed(0) {}
-    
-    // Pack constructor
-    CompactGhostEntry(uint64_t tag, uint64_t pc, int sharers, MESI_State state)
+    struct Entry
     {
-        uint32_t pc_sig = (pc & 0xFFF);          // 12 bits - matches NoC flit signature
-        uint32_t tag_partial = (tag & 0x3FFF);   // 14 bits - enough to avoid most collisions
-        uint32_t sharer_bits = (sharers & 0x7);  // 3 bits - supports 0-7 sharers
-        uint32_t state_bits = (state & 0x3);     // 2 bits - MESI (4 states)
-        
-        packed = (pc_sig << 20) |        // Bits [31:20]
-                 (tag_partial << 6) |    // Bits [19:6]
-                 (sharer_bits << 3) |    // Bits [5:3]
-                 (state_bits << 1) |     // Bits [2:1]
-                 1;                      // Bit [0] = valid
-    }
-    
-    // Unpack methods
-    bool is_valid() const { return packed & 0x1; }
-    uint32_t get_pc_sig() const { return (packed >> 20) & 0xFFF; }
-    uint32_t get_tag_partial() const { return (packed >> 6) & 0x3FFF; }
-    int get_sharers() const { return (packed >> 3) & 0x7; }
-    MESI_State get_state() const { return (MESI_State)((packed >> 1) & 0x3); }
-    
-    // Match function (checks PC signature and partial tag)
-    bool matches(uint64_t tag, uint64_t pc) const
+        uint64_t sharer_mask = 0;
+        uint64_t touched_mask = 0; // Every core that ever accessed the line
+        MESI_State state = INVALID;
+        int8_t last_writer = -1;
+        int8_t last_core = -1;
+        bool last_was_read = false;
+        bool read_by_other = false;  // A core other than the last writer read it since
+        bool written_shared = false; // Written while more than one core had touched it
+        uint8_t migratory = 0;       // 2-bit evidence counters
+        uint8_t producer = 0;
+    };
+    std::unordered_map<uint64_t, Entry> lines;
+
+    static SharingClass classify(const Entry &e)
     {
-        if (!is_valid()) return false;
-        return (get_pc_sig() == (pc & 0xFFF)) && 
-               (get_tag_partial() == (tag & 0x3FFF));
+        if (__builtin_popcountll(e.touched_mask) <= 1)
+            return SHARING_PRIVATE;
+        if (!e.written_shared)
+            return SHARING_READ_SHARED;
+        if (e.migratory > e.producer)
+            return SHARING_MIGRATORY;
+        if (e.producer > 0)
+            return SHARING_PRODUCER_CONSUMER;
+        return SHARING_WRITE_SHARED;
     }
-};
 
+    void learn_pattern(Entry &e, int core, bool is_write)
+    {
+        if (is_write)
+        {
+            if (e.last_writer >= 0 && e.last_writer != core && e.last_core == core && e.last_was_read)
+            {
+                e.migratory = std::min(3, e.migratory + 1);
+                e.producer = std::max(0, e.producer - 1);
+            }
+            else if (e.last_writer == core && e.read_by_other)
+            {
+                e.producer = std::min(3, e.producer + 1);
+                e.migratory = std::max(0, e.migratory - 1);
+            }
+            e.written_shared |= __builtin_popcountll(e.touched_mask | (1ULL << core)) > 1;
+            e.last_writer = (int8_t)core;
+            e.read_by_other = false;
+        }
+        else if (e.last_writer >= 0 && e.last_writer != core)
+            e.read_by_other = true;
 
-// ==========================================
-// BLOOM FILTER WITH FEATURE STORAGE
-// ==========================================
-class BloomFilter
-{
-    std::vector<bool> bit_array;
-    // FIX: Store actual evicted line features indexed by Bloom hash
-    // This is a "ghost tag directory" - we store up to BLOOM_SIZE entries
-    std::vector<CompactGhostEntry> ghost_tags;
-    int insertion_ptr; // Round-robin pointer for limited ghost storage
-    
-    static constexpr int GHOST_CAPACITY = 256; // Reduced from 1024
+        e.touched_mask |= 1ULL << core;
+        e.last_core = (int8_t)core;
+        e.last_was_read = !is_write;
+    }
 
 public:
-    BloomFilter() : insertion_ptr(0)
-    { 
-        bit_array.resize(BLOOM_SIZE, false); 
-        ghost_tags.resize(GHOST_CAPACITY);
-    }
-
-    void clear() 
-    { 
-        std::fill(bit_array.begin(), bit_array.end(), false); 
-        std::fill(ghost_tags.begin(), ghost_tags.end(), CompactGhostEntry());
-        insertion_ptr = 0;
-    }
-
-    // FIX: Store complete feature vector on eviction
-    void insert(uint64_t tag, uint64_t pc, int sharers, MESI_State state)
-    {
-        for (int i = 0; i < BLOOM_HASHES; i++)
-        {
-            uint64_t hash = (tag ^ pc ^ (i * 0x9e3779b9)) % BLOOM_SIZE;
-            bit_array[hash] = true;
-            
-            // Store the actual entry at the first hash position
-            // if (i == 0)
-            //     ghost_tags[hash] = GhostEntry(tag, pc, sharers, state);
-        }
-        // Step 2: Store compact entry in ghost directory (round-robin replacement)
-        // We use a simple direct-mapped cache indexed by hash to avoid full associative search
-        uint64_t ghost_hash = (tag ^ pc) % GHOST_CAPACITY;
-        ghost_tags[ghost_hash] = CompactGhostEntry(tag, pc, sharers, state);
-    }
-
-    // FIX: Return the stored feature vector if found
-    // bool lookup(uint64_t tag, uint64_t pc, GhostEntry& out_entry)
-    // {
-    //     // Check all hash positions
-    //     for (int i = 0; i < BLOOM_HASHES; i++)
-    //     {
-    //         uint64_t hash = (tag ^ pc ^ (i * 0x9e3779b9)) % BLOOM_SIZE;
-    //         if (!bit_array[hash])
-    //             return false; // Definite miss
-    //     }
-        
-    //     // Potential hit - retrieve stored entry from first hash
-    //     uint64_t primary_hash = (tag ^ pc) % BLOOM_SIZE;
-    //     GhostEntry& stored = ghost_tags[primary_hash];
-        
-    //     // Verify it's actually the same line (not a hash collision)
-    //     if (stored.tag == tag && stored.pc == pc)
-    //     {
-    //         out_entry = stored;
-    //         return true;
-    //     }
-        
-    //     return false; // Hash collision
-    // }
-    bool lookup(uint64_t tag, uint64_t pc, int& out_sharers, MESI_State& out_state)
+    // Applies one access and returns the resulting line state
+    MESI_State access(uint64_t line, int core, bool is_write, int &sharers, SharingClass &sharing)
     {
-        // Step 1: Fast Bloom filter check (eliminates definite misses)
-        for (int i = 0; i < BLOOM_HASHES; i++)
+        Entry &e = lines[line];
+        core %= 64;
+        uint64_t me = 1ULL << core;
+        learn_pattern(e, core, is_write);
+        sharing = classify(e);
+
+        if (is_write)
         {
-            uint64_t hash = (tag ^ pc ^ (i * 0x9e3779b9)) % BLOOM_SIZE;
-            if (!bit_array[hash])
-                return false; // Definite miss
+            // Writes invalidate every other copy
+            e.sharer_mask = me;
+            e.state = MODIFIED;
         }
-        
-        // Step 2: Check ghost directory (may be a collision)
-        uint64_t ghost_hash = (tag ^ pc) % GHOST_CAPACITY;
-        const CompactGhostEntry& entry = ghost_tags[ghost_hash];
-        
-        if (entry.matches(tag, pc))
+        else if (e.state == INVALID)
         {
-            // Hit! Unpack the stored features
-            out_sharers = entry.get_sharers();
-            out_state = entry.get_state();
-            return true;
+            e.sharer_mask = me;
+            e.state = EXCLUSIVE;
         }
-        
-        return false; // Bloom filter false positive or ghost eviction
-    }
-};
-
-// ==========================================
-// PERCEPTRON BRAIN (Dual Hashed)
-// ==========================================
-class PerceptronBrain
-{
-    std::vector<int> table0; // Hash(PC, State) - "Coherence Context"
-    std::vector<int> table1; // Hash(PC, Sharers) - "Sharing Context"
-
-public:
-    PerceptronBrain()
-    {
-        table0.resize(PERCEPTRON_TABLE_SIZE, 0);
-        table1.resize(PERCEPTRON_TABLE_SIZE, 0);
-        
-        // FIX: Cold Start Initialization
-        // Initialize with a slight negative bias for low-sharer, non-modified lines
-        // This helps the perceptron start with "streaming data is probably dead" assumption
-        for (int i = 0; i < PERCEPTRON_TABLE_SIZE; i++)
+        else if (e.sharer_mask != me)
         {
-            // Small random initialization to break symmetry
-            // Bias towards negative for low-sharing scenarios
-            table0[i] = -5 + (i % 11); // Range: -5 to +5
-            table1[i] = -5 + ((i * 7) % 11);
+            // Another core holds it: downgrade owner / join the sharers
+            e.sharer_mask |= me;
+            e.state = SHARED;
         }
-    }
 
-    int get_hash0(uint64_t pc, MESI_State state)
-    {
-        uint64_t h = pc ^ 0x9e3779b9;
-        h ^= (state << 8);
-        return h % PERCEPTRON_TABLE_SIZE;
-    }
-
-    int get_hash1(uint64_t pc, int sharers)
-    {
-        uint64_t h = pc ^ 0x85ebca6b;
-        h ^= (sharers << 4);
-        return h % PERCEPTRON_TABLE_SIZE;
+        sharers = __builtin_popcountll(e.sharer_mask);
+        return e.state;
     }
 
-    int predict_raw(uint64_t pc, int sharers, MESI_State state)
-    {
-        return table0[get_hash0(pc, state)] + table1[get_hash1(pc, sharers)];
-    }
+    void checkpoint(StateArchive &a) { a.io(lines); }
 
-    void train(uint64_t pc, int sharers, MESI_State state, bool positive, int current_vote)
+    // Fills in sharers/state for a batch of raw records
+    void annotate(std::vector<TraceRecord> &out, const TraceRecord *recs, size_t n, bool byte_addresses)
     {
-        // Dynamic Threshold Logic:
-        // Train if (1) Mispredicted OR (2) Low Confidence
-        bool mispredicted = (positive && current_vote <= 0) || (!positive && current_vote > 0);
-        bool low_confidence = std::abs(current_vote) <= THRESHOLD;
-
-        if (mispredicted || low_confidence)
+        out.assign(recs, recs + n);
+        for (TraceRecord &r : out)
         {
-            int h0 = get_hash0(pc, state);
-            int h1 = get_hash1(pc, sharers);
-
-            int direction = positive ? 1 : -1;
-
-            // Update Table 0 (with saturation bounds)
-            int new_val0 = table0[h0] + direction;
-            if (new_val0 <= MAX_WEIGHT && new_val0 >= MIN_WEIGHT)
-                table0[h0] = new_val0;
-
-            // Update Table 1 (with saturation bounds)
-            int new_val1 = table1[h1] + direction;
-            if (new_val1 <= MAX_WEIGHT && new_val1 >= MIN_WEIGHT)
-                table1[h1] = new_val1;
+            int sharers = 0;
+            SharingClass sharing;
+            uint64_t line = byte_addresses ? r.addr >> 6 : r.addr;
+            MESI_State st = access(line, r.core, r.flags & TRACE_FLAG_WRITE, sharers, sharing);
+            r.sharers = (uint8_t)std::min(sharers, 255);
+            r.flags = (uint8_t)((r.flags & ~(TRACE_FLAG_STATE_MASK | TRACE_FLAG_SHARING_MASK)) | st |
+                                (sharing << TRACE_FLAG_SHARING_SHIFT));
         }
     }
 };
 
 // ==========================================
-// ABSTRACT POLICY BASE
+// CACHE GEOMETRY
 // ==========================================
-class ReplacementPolicy
+// The default is the L3 the scenarios were written for. --page-cache turns
+// the same engine into an OS page cache / buffer pool: 4KB blocks in one
+// fully associative set, which is where ARC, LIRS and CLOCK-Pro live.
+const int PAGE_BLOCK_BITS = 12;      // 4KB pages
+const int PAGE_CACHE_PAGES = 16384;  // 64MB default page cache
+const int TAG_INDEX_MIN_WAYS = 64;   // Above this, hit checks use a hash index instead of a scan
+
+// Eager writeback (--eager-writeback): an L3 hit leaves the DRAM bus idle for
+// that access, so the controller may spend the slot cleaning one line the
+// policy predicts dead - writing back MODIFIED data and having the private
+// caches drop their copies. The eviction that follows is then clean and
+// needs no invalidation round trip.
+const int EAGER_SCAN_LINES = 4; // Lines examined per idle slot (round robin over the cache)
+
+struct CacheGeometry
 {
-public:
-    virtual void update_on_hit(int set_idx, int way, const CacheLine &line) = 0;
-    virtual void update_on_miss(int set_idx, int way, uint64_t pc, uint64_t tag) = 0;
-    virtual int find_victim(int set_idx, const std::vector<CacheLine> &set, uint64_t pc, int sharers, MESI_State state) = 0;
-    virtual std::string name() = 0;
-    virtual ~ReplacementPolicy() {}
+    int sets = NUM_SETS;
+    int ways = WAYS;
+    int block_bits = 6; // log2(block size): 6 = 64B lines
+
+    int blocks() const { return sets * ways; }
+    static CacheGeometry page_cache(int pages) { return {1, pages, PAGE_BLOCK_BITS}; }
 };
 
 // ==========================================
-// POLICY 1: LRU (Baseline)
+// SIMULATOR ENGINE
 // ==========================================
-class LRU_Policy : public ReplacementPolicy
+class Simulator
 {
-    std::vector<std::vector<int>> stacks;
-
-public:
-    LRU_Policy()
-    {
-        stacks.resize(NUM_SETS, std::vector<int>(WAYS));
-        for (int i = 0; i < NUM_SETS; i++)
-            for (int w = 0; w < WAYS; w++)
-                stacks[i][w] = w;
-    }
-
-    void update_stack(int set_idx, int way)
+    ReplacementPolicy *policy;
+    CacheGeometry geo;
+    Arena arena;      // Every line of the model in one mapping
+    CacheLine *lines; // Set s is lines[s * ways .. (s + 1) * ways)
+    std::vector<std::unordered_map<uint64_t, int>> tag_index; // Only for high associativity
+
+    // Optional W-TinyLFU front end: misses fill the window, and window
+    // overflow has to win a frequency contest to enter the main cache
+    TinyLFU *admission = nullptr;
+    AdmissionWindow<uint64_t, CacheLine> window;
+    int current_core = 0;
+
+    bool eager = false;
+    size_t eager_cursor = 0;
+
+    std::unique_ptr<TieredMemory> memory; // Null: every miss costs LATENCY_DRAM
+
+    // Epoch extrapolation (--extrapolate), null when off
+    std::unique_ptr<SteadyState> steady;
+    std::vector<uint64_t> epoch_start; // Counters at the last epoch boundary
+    uint64_t epochs_simulated = 0;
+    uint64_t epochs_extrapolated = 0;
+    std::vector<std::string> extrapolations; // One note per steady state found
+
+    // Every counter print_stats reports, hits and misses first
+    std::vector<uint64_t *> counters()
     {
-        int old_pos = stacks[set_idx][way];
-        for (int w = 0; w < WAYS; w++)
+        std::vector<uint64_t *> c = {&hits, &misses, &coherence_evictions_saved, &total_latency, &eager_cleaned,
+                                     &eager_writebacks, &self_invalidations, &clean_evictions, &eager_wrong};
+        for (int i = 0; i < SHARING_CLASSES; i++)
         {
-            if (stacks[set_idx][w] < old_pos)
-                stacks[set_idx][w]++;
+            c.push_back(&class_hits[i]);
+            c.push_back(&class_misses[i]);
         }
-        stacks[set_idx][way] = 0; // MRU
-    }
-
-    void update_on_hit(int set_idx, int way, const CacheLine &line) override { update_stack(set_idx, way); }
-    void update_on_miss(int set_idx, int way, uint64_t pc, uint64_t tag) override { update_stack(set_idx, way); }
-
-    int find_victim(int set_idx, const std::vector<CacheLine> &set, uint64_t pc, int sharers, MESI_State state) override
-    {
-        for (int w = 0; w < WAYS; w++)
+        if (admission)
         {
-            if (!set[w].valid)
-                return w;
-            if (stacks[set_idx][w] == WAYS - 1)
-                return w; // LRU position
+            c.push_back(&admission->admitted);
+            c.push_back(&admission->rejected);
         }
-        return 0;
-    }
-    std::string name() override { return "LRU"; }
-};
-
-// ==========================================
-// POLICY 2: SRRIP (Baseline)
-// ==========================================
-class SRRIP_Policy : public ReplacementPolicy
-{
-protected:
-    std::vector<std::vector<int>> rrpv; // 2-bit
-public:
-    SRRIP_Policy()
-    {
-        rrpv.resize(NUM_SETS, std::vector<int>(WAYS, 3));
+        return c;
     }
 
-    void update_on_hit(int set_idx, int way, const CacheLine &line) override
+    // Policy state plus every line's metadata, tags left out like the
+    // policy's. The admission sketch and window are indexed by tag.
+    uint64_t fingerprint() const
     {
-        rrpv[set_idx][way] = 0; // Promote to Immediate
+        uint64_t h = admission ? 0 : policy->state_hash();
+        if (!h)
+            return 0;
+        for (int i = 0; i < geo.blocks(); i++)
+            h = hash_line(h, lines[i]);
+        return h;
     }
 
-    void update_on_miss(int set_idx, int way, uint64_t pc, uint64_t tag) override
+public:
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t coherence_evictions_saved = 0;
+    uint64_t total_latency = 0;
+    uint64_t class_hits[SHARING_CLASSES] = {};
+    uint64_t class_misses[SHARING_CLASSES] = {};
+    uint64_t eager_cleaned = 0;      // Lines cleaned in idle slots, of which:
+    uint64_t eager_writebacks = 0;   // MODIFIED lines cleaned in idle slots
+    uint64_t self_invalidations = 0; // Shared lines whose private copies were dropped
+    uint64_t clean_evictions = 0;    // Evictions that found the line already cleaned
+    uint64_t eager_wrong = 0;        // Cleaned lines referenced again before eviction
+
+    Simulator(ReplacementPolicy *p, TinyLFU *tinylfu = nullptr, CacheGeometry geometry = CacheGeometry())
+        : policy(p), geo(geometry), arena(sizeof(CacheLine) * geometry.blocks()), admission(tinylfu),
+          window(TinyLFU::window_size(geometry.blocks()))
     {
-        rrpv[set_idx][way] = 2; // Insert at Long (Not Distant)
+        lines = arena.alloc<CacheLine>(geo.blocks());
+        std::uninitialized_default_construct_n(lines, geo.blocks());
+        if (geo.ways >= TAG_INDEX_MIN_WAYS)
+            tag_index.resize(geo.sets);
     }
 
-    int find_victim(int set_idx, const std::vector<CacheLine> &set, uint64_t pc, int sharers, MESI_State state) override
+    // Back to an empty cache and a cold policy, for the next run of a sweep.
+    // Line state goes in one memset; the policy and filters reset in place.
+    void reset()
     {
-        while (true)
-        {
-            for (int w = 0; w < WAYS; w++)
-            {
-                if (!set[w].valid)
-                    return w;
-                if (rrpv[set_idx][w] == 3)
-                    return w;
-            }
-            // Age all
-            for (int w = 0; w < WAYS; w++)
-            {
-                if (rrpv[set_idx][w] < 3)
-                    rrpv[set_idx][w]++;
-            }
-        }
+        arena.reset();
+        for (auto &index : tag_index)
+            index.clear();
+        window.clear();
+        current_core = 0;
+        eager_cursor = 0;
+        hits = misses = coherence_evictions_saved = total_latency = 0;
+        std::fill(std::begin(class_hits), std::end(class_hits), 0);
+        std::fill(std::begin(class_misses), std::end(class_misses), 0);
+        eager_cleaned = eager_writebacks = self_invalidations = clean_evictions = eager_wrong = 0;
+        if (memory)
+            memory->reset();
+        if (admission)
+            admission->reset();
+        policy->reset();
+        if (steady)
+            steady->clear();
+        epoch_start.clear();
+        epochs_simulated = epochs_extrapolated = 0;
+        extrapolations.clear();
     }
-    std::string name() override { return "SRRIP"; }
-};
 
-// ==========================================
-// POLICY 3: SHiP (PC-Aware Baseline)
-// ==========================================
-class SHiP_Policy : public SRRIP_Policy
-{
-    std::vector<int> shct; // Signature History Counter Table
-public:
-    SHiP_Policy()
+    // Hand the warm cache to another policy mid-run (--branches). The
+    // lines, filters and counters carry on; the policy adopts the resident
+    // lines but its learned state (predictors, ghosts) starts cold.
+    void switch_policy(ReplacementPolicy *p)
     {
-        shct.resize(SHCT_SIZE, 0);
+        policy = p;
+        for (int s = 0; s < geo.sets; s++)
+            policy->adopt(s, set_lines(s));
+        if (memory)
+            policy->set_tier_costs(memory->refetch_costs(1 << geo.block_bits));
+        if (current_core)
+            policy->set_core(current_core);
     }
 
-    int get_sig(uint64_t pc) { return pc % SHCT_SIZE; }
+    void enable_eager_writeback() { eager = true; }
 
-    void update_on_hit(int set_idx, int way, const CacheLine &line) override
+    // Lines, policy, admission filter, memory and every counter (--checkpoint).
+    // Epoch extrapolation only runs in the scenarios, which don't checkpoint.
+    void checkpoint(StateArchive &a)
     {
-        rrpv[set_idx][way] = 0;
-        int sig = get_sig(line.pc);
-        if (shct[sig] > 0)
-            shct[sig]--;
+        a.span(lines, geo.blocks());
+        a.io(tag_index, window, current_core, eager_cursor);
+        for (uint64_t *c : counters())
+            a.io(*c);
+        if (admission)
+            admission->checkpoint(a);
+        if (memory)
+            memory->checkpoint(a);
+        policy->checkpoint(a);
     }
 
-    void update_on_miss(int set_idx, int way, uint64_t pc, uint64_t tag) override
-    {
-        int sig = get_sig(pc);
-        if (shct[sig] >= 2)
-            rrpv[set_idx][way] = 3;
-        else
-            rrpv[set_idx][way] = 2;
-    }
+    void enable_extrapolation() { steady = std::make_unique<SteadyState>(); }
 
-    int find_victim(int set_idx, const std::vector<CacheLine> &set, uint64_t pc, int sharers, MESI_State state) override
+    // Epoch boundary of a repetitive scenario, with `remaining` epochs of the
+    // same shape left in its phase. Once the run is steady (steady_state.h),
+    // their stats are added here and the caller skips them: returns true.
+    bool end_epoch(uint64_t remaining)
     {
-        int victim = SRRIP_Policy::find_victim(set_idx, set, pc, sharers, state);
-        return victim;
+        if (!steady)
+            return false;
+        std::vector<uint64_t *> c = counters();
+        std::vector<uint64_t> delta(c.size());
+        epoch_start.resize(c.size(), 0);
+        for (size_t i = 0; i < c.size(); i++)
+        {
+            delta[i] = *c[i] - epoch_start[i];
+            epoch_start[i] = *c[i];
+        }
+        epochs_simulated++;
+
+        SteadyKind kind = steady->observe(delta, fingerprint());
+        if (kind == STEADY_NONE || remaining == 0)
+            return false;
+
+        std::vector<uint64_t> rest = steady->extrapolate(kind, remaining);
+        for (size_t i = 0; i < c.size(); i++)
+            epoch_start[i] = *c[i] += rest[i];
+        epochs_extrapolated += remaining;
+        std::ostringstream note;
+        if (kind == STEADY_EXACT)
+            note << "exact steady state (period " << steady->period << " epochs)";
+        else
+            note << "approximate steady state (" << STEADY_APPROX_WINDOWS << " windows of " << STEADY_WINDOW_EPOCHS
+                 << " epochs within " << 100 * STEADY_TOLERANCE << "%)";
+        note << " after epoch " << epochs_simulated << ": " << remaining << " epochs extrapolated";
+        extrapolations.push_back(note.str());
+        steady->clear();
+        return true;
     }
 
-    std::string name() override { return "SHiP"; }
-};
-
-// ==========================================
-// POLICY 4: SDBP (Sampling Dead Block)
-// ==========================================
-class SDBP_Policy : public LRU_Policy
-{
-    std::vector<int> dead_table;
-public:
-    SDBP_Policy()
+    // Each simulator places pages itself, so runs side by side stay independent
+    void enable_tiered_memory(const TieredMemory &config)
     {
-        dead_table.resize(SHCT_SIZE, 0);
+        memory = std::make_unique<TieredMemory>(config);
+        policy->set_tier_costs(memory->refetch_costs(1 << geo.block_bits));
     }
 
-    int get_hash(uint64_t pc) { return pc % SHCT_SIZE; }
+    int set_of(uint64_t addr) const { return (addr >> geo.block_bits) % geo.sets; }
 
-    void update_on_hit(int set_idx, int way, const CacheLine &line) override
-    {
-        LRU_Policy::update_on_hit(set_idx, way, line);
-        int h = get_hash(line.pc);
-        if (dead_table[h] > 0)
-            dead_table[h]--;
-    }
+    CacheLine *set_lines(int set_idx) const { return lines + (size_t)set_idx * geo.ways; }
 
-    int find_victim(int set_idx, const std::vector<CacheLine> &set, uint64_t pc, int sharers, MESI_State state) override
+    int find_way(int set_idx, uint64_t tag) const
     {
-        // 1. Check for Dead Predictions
-        for (int w = 0; w < WAYS; w++)
+        if (!tag_index.empty())
         {
-            if (!set[w].valid)
-                return w;
-            if (dead_table[get_hash(set[w].pc)] >= 2)
-            {
+            auto it = tag_index[set_idx].find(tag);
+            return it == tag_index[set_idx].end() ? -1 : it->second;
+        }
+        for (int w = 0; w < geo.ways; w++)
+        {
+            if (set_lines(set_idx)[w].valid && set_lines(set_idx)[w].tag == tag)
                 return w;
-            }
         }
-        // 2. Fallback to LRU
-        return LRU_Policy::find_victim(set_idx, set, pc, sharers, state);
+        return -1;
     }
 
-    void on_evict(uint64_t pc)
+    void install(int set_idx, int way, const CacheLine &line)
     {
-        int h = get_hash(pc);
-        if (dead_table[h] < 3)
-            dead_table[h]++;
+        CacheLine &slot = set_lines(set_idx)[way];
+        if (!tag_index.empty())
+        {
+            if (slot.valid)
+                tag_index[set_idx].erase(slot.tag);
+            tag_index[set_idx][line.tag] = way;
+        }
+        slot = line;
     }
 
-    std::string name() override { return "SDBP (Sim)"; }
-};
-
-// ==========================================
-// POLICY 5: COALESCE (FIXED VERSION)
-// ==========================================
-class COALESCE_Policy : public ReplacementPolicy
-{
-    PerceptronBrain brain;
-    std::vector<BloomFilter> ghosts;
-    std::vector<bool> is_sampled;
-
-public:
-    COALESCE_Policy()
+    void access(uint64_t addr, uint64_t pc, int sharers, MESI_State state, int core = 0,
+                int sharing = SHARING_UNCLASSIFIED)
     {
-        ghosts.resize(NUM_SETS);
-        is_sampled.resize(NUM_SETS, false);
-        
-        // FIX: Increased sampling from 3% to 6.25% (1 in 16 instead of 1 in 32)
-        // More training opportunities = faster learning
-        for (int i = 0; i < NUM_SETS; i++)
-        {
-            if (i % SAMPLING_MODULO == 0)
-                is_sampled[i] = true;
-        }
-    }
-
-    void update_on_hit(int set_idx, int way, const CacheLine &line) override
-    {
-        // POSITIVE REINFORCEMENT: This line was useful!
-        // Train the perceptron that this (PC, Sharers, State) combination is GOOD
-        if (is_sampled[set_idx])
-        {
-            int vote = brain.predict_raw(line.pc, line.sharers, line.state);
-            brain.train(line.pc, line.sharers, line.state, true, vote);
-        }
-    }
-
-    // void update_on_miss(int set_idx, int way, uint64_t pc, uint64_t tag) override
-    // {
-    //     // FIX: Ghost Buffer Check with CORRECT feature training
-    //     // If we previously evicted this line (it's in the ghost buffer),
-    //     // it means we made a MISTAKE - train positively with ACTUAL features
-    //     if (is_sampled[set_idx])
-    //     {
-    //         GhostEntry ghost;
-    //         if (ghosts[set_idx].lookup(tag, pc, ghost))
-    //         {
-    //             // CRITICAL FIX: Train with the ACTUAL evicted line's features
-    //             // Not hardcoded (0, EXCLUSIVE)!
-    //             int vote = brain.predict_raw(ghost.pc, ghost.sharers, ghost.state);
-                
-    //             // Strong positive reinforcement (5x) because this is a confirmed mistake
-    //             for(int k = 0; k < 5; k++) 
-    //             {
-    //                 brain.train(ghost.pc, ghost.sharers, ghost.state, true, vote);
-    //             }
-    //         }
-    //     }
-    // }
-    void update_on_miss(int set_idx, int way, uint64_t pc, uint64_t tag) override
-    {
-        // Ghost buffer check with UNPACKED features
-        if (is_sampled[set_idx])
-        {
-            int ghost_sharers;
-            MESI_State ghost_state;
-            
-            if (ghosts[set_idx].lookup(tag, pc, ghost_sharers, ghost_state))
-            {
-                // Premature eviction detected! Train positively with ACTUAL features
-                int vote = brain.predict_raw(pc, ghost_sharers, ghost_state);
-                
-                // Strong reinforcement (5x) - this is confirmed ground truth
-                for(int k = 0; k < 5; k++) 
-                {
-                    brain.train(pc, ghost_sharers, ghost_state, true, vote);
-                }
-            }
+        if (core != current_core)
+        {
+            policy->set_core(core);
+            current_core = core;
         }
-    }
 
+        int set_idx = set_of(addr);
+        uint64_t tag = addr;
 
-    int find_victim(int set_idx, const std::vector<CacheLine> &set, uint64_t pc, int sharers, MESI_State state) override
-    {
-        int victim = -1;
-        int min_vote = 999999;
+        if (admission)
+            admission->record(tag);
 
-        for (int w = 0; w < WAYS; w++)
+        // HIT CHECK
+        int w = find_way(set_idx, tag);
+        if (w >= 0)
         {
-            if (!set[w].valid)
-                return w;
-
-            // STEP 1: Get Raw Perceptron Prediction
-            // This is the learned "reuse likelihood" based on PC + Sharers + State
-            int raw_vote = brain.predict_raw(set[w].pc, set[w].sharers, set[w].state);
-            int final_vote = raw_vote;
-
-            // STEP 2: Apply Coherence Veto (Cost-Aware Bias)
-            // FIX: Changed from "sharers > 2" to "sharers >= 2"
-            // This protects lines with 2+ sharers (working sets in our benchmark)
-            // 
-            // VETO OVERRIDE: If raw_vote is extremely negative (< VETO_OVERRIDE),
-            // it means the perceptron is CONFIDENT this line is dead.
-            // In this case, we override the veto to allow eviction of dead-but-shared lines.
-            // This solves the "Streaming Modified Data" pathology.
-            if (raw_vote > VETO_OVERRIDE)
-            {
-                // Apply cost-based protection
-                if (set[w].state == MODIFIED)
-                {
-                    // MODIFIED lines are expensive to evict (write-back to DRAM + invalidations)
-                    final_vote += 150; // Increased from 100 for stronger protection
-                }
-                
-                if (set[w].sharers >= 2) // FIX: Was "sharers > 2"
-                {
-                    // Multi-sharer lines trigger coherence traffic on eviction
-                    final_vote += 75; // Increased from 50
-                }
-            }
-            // else: Perceptron is confident this is dead, ignore veto
+            hits++;
+            class_hits[sharing]++;
+            total_latency += LATENCY_L3_HIT;
 
-            // Select minimum vote as victim
-            if (final_vote < min_vote)
+            // Update line metadata
+            CacheLine &line = set_lines(set_idx)[w];
+            if (line.early)
             {
-                min_vote = final_vote;
-                victim = w;
+                eager_wrong++; // Predicted dead, but here it is again
+                line.early = false;
             }
+            line.sharers = std::min(sharers, 255);
+            line.state = state;
+            line.pc = pc;
+            line.sharing = sharing;
+
+            // Train policy on hit
+            policy->update_on_hit(set_idx, w, line);
+            if (eager)
+                eager_clean();
+            return;
         }
 
-        // STEP 3: Record Eviction in Ghost Buffer (with FULL features)
-        // FIX: Store complete feature vector, not just tag+PC
-        if (is_sampled[set_idx] && victim >= 0)
+        if (admission)
         {
-            CacheLine v = set[victim];
-            ghosts[set_idx].insert(v.tag, v.pc, v.sharers, v.state);
+            access_window(tag, pc, sharers, state, sharing);
+            return;
+        }
 
-            // FIX: DO NOT train negative immediately!
-            // We don't know if this line is dead until it's either:
-            // (a) Never accessed again (stays in ghost buffer forever)
-            // (b) Accessed again (ghost buffer hit triggers positive training)
-            //
-            // Training negative here creates the "premature punishment" death spiral.
-            // Let the ghost buffer handle all training - it has ground truth.
+        // MISS - Find victim
+        misses++;
+        class_misses[sharing]++;
+        int tier = 0;
+        total_latency += fetch(addr, tier);
+        policy->on_miss(set_idx, tag);
+        int victim = policy->find_victim(set_idx, set_lines(set_idx), pc, sharers, state);
+
+        // Calculate eviction penalty
+        CacheLine v = set_lines(set_idx)[victim];
+        clean_evictions += v.valid && v.early;
+        if (v.valid)
+        {
+            total_latency += charge_eviction(v);
+            policy->on_evict(set_idx, victim, v);
         }
 
-        return victim;
+        // Install new line BEFORE calling update_on_miss
+        // (So ghost buffer logic can run)
+        install(set_idx, victim, {tag, pc, sharers, state, sharing, tier});
+        
+        // Now train policy on miss (including ghost buffer check)
+        policy->update_on_miss(set_idx, victim, pc, tag);
     }
-    
-    std::string name() override { return "COALESCE-Fixed"; }
-};
 
-// ==========================================
-// SIMULATOR ENGINE
-// ==========================================
-class Simulator
-{
-    ReplacementPolicy *policy;
-    std::vector<std::vector<CacheLine>> cache;
-    SDBP_Policy *sdbp_ref = nullptr;
+    // Idle DRAM-bus slot: clean the first predicted-dead dirty/shared line
+    // among the next EAGER_SCAN_LINES. The line stays cached; only its
+    // eviction gets cheaper.
+    void eager_clean()
+    {
+        size_t total = (size_t)geo.sets * geo.ways;
+        for (int i = 0; i < EAGER_SCAN_LINES; i++)
+        {
+            size_t idx = eager_cursor;
+            eager_cursor = (eager_cursor + 1) % total;
+            CacheLine &l = lines[idx];
+            if (!l.valid || l.early || eviction_penalty(l) == 0 || !policy->predict_dead(l))
+                continue;
+            if (l.state == MODIFIED)
+            {
+                eager_writebacks++;
+                l.state = EXCLUSIVE;
+                if (memory)
+                    memory->record_writeback(l.tier, 0); // Off the critical path
+            }
+            if (l.sharers > 1)
+            {
+                self_invalidations++;
+                l.sharers = 0;
+            }
+            l.early = true;
+            eager_cleaned++;
+            return;
+        }
+    }
 
-public:
-    uint64_t hits = 0;
-    uint64_t misses = 0;
-    uint64_t coherence_evictions_saved = 0;
-    uint64_t total_latency = 0;
+    // Extra cost of pushing a line out of the hierarchy. With a tiered
+    // backend, dirty data pays the write latency of the tier it goes back to.
+    int eviction_penalty(const CacheLine &v) const
+    {
+        if (memory && v.state == MODIFIED)
+            return memory->write_cost(v.tier, 1 << geo.block_bits);
+        return (v.state == MODIFIED || v.sharers > 1) ? LATENCY_COHERENCE_PENALTY : 0;
+    }
 
-    Simulator(ReplacementPolicy *p) : policy(p)
+    // eviction_penalty() for a line that really leaves, counted per tier
+    int charge_eviction(const CacheLine &v)
     {
-        cache.resize(NUM_SETS, std::vector<CacheLine>(WAYS));
-        if (p->name() == "SDBP (Sim)")
-            sdbp_ref = (SDBP_Policy *)p;
+        int cycles = eviction_penalty(v);
+        if (memory && v.state == MODIFIED)
+            memory->record_writeback(v.tier, cycles);
+        return cycles;
     }
 
-    void access(uint64_t addr, uint64_t pc, int sharers, MESI_State state)
+    // Miss latency for the block at `addr`, and the tier it came from
+    int fetch(uint64_t addr, int &tier)
     {
-        int set_idx = (addr / 64) % NUM_SETS;
-        uint64_t tag = addr;
+        if (!memory)
+            return LATENCY_DRAM;
+        tier = memory->tier_of(addr);
+        return memory->read(tier, 1 << geo.block_bits);
+    }
 
-        // HIT CHECK
-        for (int w = 0; w < WAYS; w++)
+    // Main cache missed and TinyLFU is on: serve from / fill the window
+    void access_window(uint64_t tag, uint64_t pc, int sharers, MESI_State state, int sharing)
+    {
+        if (CacheLine *w = window.touch(tag))
         {
-            if (cache[set_idx][w].valid && cache[set_idx][w].tag == tag)
-            {
-                hits++;
-                total_latency += LATENCY_L3_HIT;
-
-                // Update line metadata
-                cache[set_idx][w].sharers = sharers;
-                cache[set_idx][w].state = state;
-                cache[set_idx][w].pc = pc;
-
-                // Train policy on hit
-                policy->update_on_hit(set_idx, w, cache[set_idx][w]);
-                return;
-            }
+            hits++;
+            class_hits[sharing]++;
+            total_latency += LATENCY_L3_HIT;
+            w->sharers = std::min(sharers, 255);
+            w->state = state;
+            w->pc = pc;
+            w->sharing = sharing;
+            return;
         }
 
-        // MISS - Find victim
         misses++;
-        int victim = policy->find_victim(set_idx, cache[set_idx], pc, sharers, state);
-
-        // Calculate eviction penalty
-        CacheLine v = cache[set_idx][victim];
-        if (v.valid)
+        class_misses[sharing]++;
+        int tier = 0;
+        total_latency += fetch(tag, tier);
+
+        std::pair<uint64_t, CacheLine> overflow;
+        if (!window.insert(tag, {tag, pc, sharers, state, sharing, tier}, overflow))
+            return;
+
+        // The window's LRU line competes with the policy's victim. The policy
+        // is only told about the miss once the candidate wins, so rejected
+        // candidates leave no ghosts, aging or credit charges behind.
+        const CacheLine &cand = overflow.second;
+        int set_idx = set_of(cand.tag);
+        CacheLine *set = set_lines(set_idx);
+        int victim = policy->peek_victim(set_idx, set, cand.tag, cand.pc, cand.sharers, cand.state);
+        bool peeked = victim >= 0;
+        if (peeked && set[victim].valid && !admission->admit(cand.tag, set[victim].tag))
         {
-            if (v.state == MODIFIED || v.sharers > 1)
-            {
-                total_latency += (LATENCY_DRAM + LATENCY_COHERENCE_PENALTY);
-            }
-            else
-            {
-                total_latency += LATENCY_DRAM;
-            }
-
-            if (sdbp_ref)
-                sdbp_ref->on_evict(v.pc);
+            total_latency += charge_eviction(cand); // Candidate leaves instead
+            return;
         }
-        else
+        policy->on_miss(set_idx, cand.tag);
+        victim = policy->find_victim(set_idx, set, cand.pc, cand.sharers, cand.state);
+        CacheLine &v = set[victim];
+        if (!peeked && v.valid && !admission->admit(cand.tag, v.tag))
+        {
+            total_latency += charge_eviction(cand);
+            return;
+        }
+        if (v.valid)
         {
-            total_latency += LATENCY_DRAM;
+            total_latency += charge_eviction(v);
+            policy->on_evict(set_idx, victim, v);
         }
+        install(set_idx, victim, cand);
+        policy->update_on_miss(set_idx, victim, cand.pc, cand.tag);
+    }
 
-        // Install new line BEFORE calling update_on_miss
-        // (So ghost buffer logic can run)
-        cache[set_idx][victim] = {true, tag, pc, sharers, state, 0, 2};
-        
-        // Now train policy on miss (including ghost buffer check)
-        policy->update_on_miss(set_idx, victim, pc, tag);
+    // Batched path for trace streams: one call per reader batch instead of
+    // one per access. Byte-address traces are aligned to the block first;
+    // synthetic traces already address 64B blocks directly and are only
+    // rescaled to bytes when the blocks are pages.
+    void access_batch(const TraceRecord *recs, size_t n, bool byte_addresses)
+    {
+        int shift = (!byte_addresses && geo.block_bits > 6) ? 6 : 0;
+        uint64_t mask = (byte_addresses || shift) ? ~((1ULL << geo.block_bits) - 1) : ~(uint64_t)0;
+        for (size_t i = 0; i < n; i++)
+        {
+            const TraceRecord &r = recs[i];
+            int sharing = (r.flags & TRACE_FLAG_SHARING_MASK) >> TRACE_FLAG_SHARING_SHIFT;
+            access((r.addr << shift) & mask, r.pc, r.sharers, (MESI_State)(r.flags & TRACE_FLAG_STATE_MASK), r.core,
+                   sharing < SHARING_CLASSES ? sharing : SHARING_UNCLASSIFIED);
+        }
     }
 
     void print_stats()
@@ -712,111 +608,1740 @@ public:
         double hit_rate = 100.0 * hits / (hits + misses);
         double amat = (double)total_latency / (hits + misses);
 
-        std::cout << std::left << std::setw(20) << policy->name()
+        std::cout << std::left << std::setw(20) << (policy->name() + (admission ? "+TinyLFU" : ""))
                   << " | Hit Rate: " << std::fixed << std::setprecision(2) << std::setw(6) << hit_rate << "%"
                   << " | AMAT: " << std::setprecision(1) << std::setw(6) << amat << " cyc"
-                  << " | Total Latency: " << total_latency << "\n";
+                  << " | Total Latency: " << total_latency;
+        if (admission)
+            std::cout << " | Admitted: " << admission->admitted << " Rejected: " << admission->rejected
+                      << " | Window: +" << TinyLFU::window_size(geo.blocks()) << " lines";
+        std::cout << "\n";
+
+        if (eager)
+            std::cout << "    eager: " << eager_cleaned << " lines cleaned in idle slots (" << eager_writebacks
+                      << " writebacks, " << self_invalidations << " self-invalidations), " << clean_evictions
+                      << " evictions made clean, " << eager_wrong << " wrong (" << std::setprecision(2)
+                      << 100.0 * eager_wrong / std::max<uint64_t>(1, eager_cleaned) << "%)\n";
+        if (memory)
+            memory->print(std::cout);
+        if (!extrapolations.empty())
+        {
+            std::cout << "    EXTRAPOLATED: " << epochs_extrapolated << " of " << epochs_simulated + epochs_extrapolated
+                      << " epochs (" << std::fixed << std::setprecision(1)
+                      << 100.0 * epochs_extrapolated / (epochs_simulated + epochs_extrapolated) << "%) not simulated\n";
+            for (const std::string &note : extrapolations)
+                std::cout << "      " << note << "\n";
+        }
+
+        // Only traces that went through the coherence directory carry classes
+        if (class_hits[SHARING_UNCLASSIFIED] + class_misses[SHARING_UNCLASSIFIED] < hits + misses)
+        {
+            std::cout << "    by sharing:";
+            for (int c = 0; c < SHARING_CLASSES; c++)
+            {
+                uint64_t n = class_hits[c] + class_misses[c];
+                if (n)
+                    std::cout << " " << SHARING_CLASS_NAMES[c] << " " << std::setprecision(2)
+                              << 100.0 * class_hits[c] / n << "% (" << n << ")";
+            }
+            std::cout << "\n";
+        }
+        policy->print_report(std::cout);
     }
 };
 
 // ==========================================
-// MAIN & WORKLOADS
+// WORKLOADS
 // ==========================================
-int main()
+// Written against any "sink" with access(addr, pc, sharers, state) so the
+// same generator can drive a Simulator or be dumped as a trace (--emit).
+
+// SCENARIO 1: Database Scan (Pollution Resistance)
+// Working Set: 64 lines (PC=0xF00D, sharers=2, SHARED) - repeatedly accessed
+// Scanner: 100K unique lines (PC=0xBAD, sharers=0, EXCLUSIVE) - stream once
+// 
+// Expected Behavior:
+// - LRU/SRRIP: Evict working set → 0% hit rate
+// - COALESCE: Learn that 0xBAD is dead, protect 0xF00D → ~50% hit rate
+template <typename Sink>
+void scenario_database_scan(Sink &sim)
 {
-    std::cout << "========================================================\n";
-    std::cout << "   COALESCE: FIXED IMPLEMENTATION (All Bugs Resolved)\n";
-    std::cout << "========================================================\n\n";
-
-    auto run_scenario = [](std::string name, auto workload_gen)
-    {
-        std::cout << ">>> SCENARIO: " << name << "\n";
+    const int N = 10000000;
+    for(int i = 0; i < N; i++) {
+        // The Scanner (Polluter): PC=0xBAD, never reused
+        sim.access(100000 + i, 0xBAD, 0, EXCLUSIVE);
+
+        // The Working Set (Gold): PC=0xF00D, reused every 64 accesses
+        // sharers=2 triggers veto protection
+        sim.access(i % 64, 0xF00D, 2, SHARED); 
+
+        // One epoch per pass over the working set
+        if (i % 64 == 63 && sim.end_epoch((N - 1 - i) / 64))
+            break;
+    }
+}
 
-        LRU_Policy lru;
-        Simulator s1(&lru);
-        workload_gen(s1);
-        s1.print_stats();
-        
-        SRRIP_Policy srrip;
-        Simulator s2(&srrip);
-        workload_gen(s2);
-        s2.print_stats();
-        
-        SHiP_Policy ship;
-        Simulator s3(&ship);
-        workload_gen(s3);
-        s3.print_stats();
-        
-        SDBP_Policy sdbp;
-        Simulator s4(&sdbp);
-        workload_gen(s4);
-        s4.print_stats();
-        
-        COALESCE_Policy coal;
-        Simulator s5(&coal);
-        workload_gen(s5);
-        s5.print_stats();
+// SCENARIO 2: Graph Hub (Coherence Protection)
+// Hub: 50 hot lines (PC=0x50B, sharers=4, MODIFIED) - critical sync data
+// Noise: 800 lines per epoch (PC=0xD0015E, sharers=0, EXCLUSIVE)
+//
+// Expected Behavior:
+// - COALESCE: Veto protects MODIFIED+high-sharer lines
+// - Baselines: Treat all misses equally → evict hub
+template <typename Sink>
+void scenario_graph_hub(Sink &sim)
+{
+    const int EPOCHS = 100000;
+    for(int epoch = 0; epoch < EPOCHS; epoch++) {
+        // Noise (streaming)
+        for(int i = 0; i < 800; i++) 
+            sim.access(10000 + i + (epoch * 100), 0xD0015E, 0, EXCLUSIVE);
         
-        std::cout << "--------------------------------------------------------\n";
-    };
-
-    // SCENARIO 1: Database Scan (Pollution Resistance)
-    // Working Set: 64 lines (PC=0xF00D, sharers=2, SHARED) - repeatedly accessed
-    // Scanner: 100K unique lines (PC=0xBAD, sharers=0, EXCLUSIVE) - stream once
-    // 
-    // Expected Behavior:
-    // - LRU/SRRIP: Evict working set → 0% hit rate
-    // - COALESCE: Learn that 0xBAD is dead, protect 0xF00D → ~50% hit rate
-    run_scenario("Database Scan (Pollution Resistance)", [](Simulator &sim) {
-        for(int i = 0; i < 10000000; i++) {
-            // The Scanner (Polluter): PC=0xBAD, never reused
-            sim.access(100000 + i, 0xBAD, 0, EXCLUSIVE);
-
-            // The Working Set (Gold): PC=0xF00D, reused every 64 accesses
-            // sharers=2 triggers veto protection
-            sim.access(i % 64, 0xF00D, 2, SHARED); 
+        // Hub (hot, expensive to evict)
+        for(int k = 0; k < 400; k++) {
+            sim.access(k % 50, 0x50B, 4, MODIFIED);
         }
-    });
 
-    // SCENARIO 2: Graph Hub (Coherence Protection)
-    // Hub: 50 hot lines (PC=0x50B, sharers=4, MODIFIED) - critical sync data
-    // Noise: 800 lines per epoch (PC=0xD0015E, sharers=0, EXCLUSIVE)
-    //
-    // Expected Behavior:
-    // - COALESCE: Veto protects MODIFIED+high-sharer lines
-    // - Baselines: Treat all misses equally → evict hub
-    run_scenario("Graph Hub (Coherence Protection)", [](Simulator &sim) {
-        for(int epoch = 0; epoch < 100000; epoch++) {
-            // Noise (streaming)
-            for(int i = 0; i < 800; i++) 
-                sim.access(10000 + i + (epoch * 100), 0xD0015E, 0, EXCLUSIVE);
-            
-            // Hub (hot, expensive to evict)
-            for(int k = 0; k < 400; k++) {
-                sim.access(k % 50, 0x50B, 4, MODIFIED);
-            }
-        }
-    });
+        if (sim.end_epoch(EPOCHS - 1 - epoch))
+            break;
+    }
+}
 
-    // SCENARIO 3: Phase Change (Veto Adaptation)
-    // Phase 1: 0x50B is a hot working set (MODIFIED, sharers=4)
-    // Phase 2: 0x50B becomes streaming (EXCLUSIVE, sharers=0)
-    //
-    // Expected Behavior:
-    // - COALESCE must unlearn the veto via dynamic threshold training
-    // - Should adapt within ~20K accesses
-    run_scenario("Phase Change (Veto Adaptation)", [](Simulator &sim) {
-        // Phase 1: 0x50B is Good (200K accesses, high reuse)
-        for(int i = 0; i < 20000000; i++) {
-            sim.access(i % 100, 0x50B, 4, MODIFIED); // Hits
-            sim.access(10000 + i, 0xD0015E, 0, EXCLUSIVE); // Misses
-        }
-        
-        // Phase 2: 0x50B becomes Streaming (200K accesses, zero reuse)
-        for(int i = 0; i < 20000000; i++) {
-            sim.access(20000 + i, 0x50B, 0, EXCLUSIVE); // Now it's dead!
-        }
-    });
+// SCENARIO 3: Phase Change (Veto Adaptation)
+// Phase 1: 0x50B is a hot working set (MODIFIED, sharers=4)
+// Phase 2: 0x50B becomes streaming (EXCLUSIVE, sharers=0)
+//
+// Expected Behavior:
+// - COALESCE must unlearn the veto via dynamic threshold training
+// - Should adapt within ~20K accesses
+template <typename Sink>
+void scenario_phase_change(Sink &sim)
+{
+    // Phase 1: 0x50B is Good (200K accesses, high reuse)
+    const int N = 20000000;
+    for(int i = 0; i < N; i++) {
+        sim.access(i % 100, 0x50B, 4, MODIFIED); // Hits
+        sim.access(10000 + i, 0xD0015E, 0, EXCLUSIVE); // Misses
+        if (i % 100 == 99 && sim.end_epoch((N - 1 - i) / 100))
+            break;
+    }
+    
+    // Phase 2: 0x50B becomes Streaming (200K accesses, zero reuse)
+    for(int i = 0; i < N; i++) {
+        sim.access(20000 + i, 0x50B, 0, EXCLUSIVE); // Now it's dead!
+        if (i % 100 == 99 && sim.end_epoch((N - 1 - i) / 100))
+            break;
+    }
+}
+
+// SCENARIO 4: CDN Edge (Object Cache, --emit=cdn only)
+// 1M objects, Zipf(0.8) popularity, three request classes:
+//   PC=0x1A6E thumbnails  ~4-64KB, 60% of requests
+//   PC=0xA11  API replies  ~100B-2KB, 30%, half MODIFIED (expensive to recompute)
+//   PC=0x51DE video chunks ~1-4MB, 10%, mostly one-shot
+// A byte budget in the tens of MB rewards policies that skip the chunks.
+void scenario_cdn(TraceWriter &out)
+{
+    const int OBJECTS = 1000000;
+    std::vector<double> cdf(OBJECTS);
+    double sum = 0;
+    for (int i = 0; i < OBJECTS; i++)
+    {
+        sum += 1.0 / std::pow(i + 1.0, 0.8);
+        cdf[i] = sum;
+    }
+
+    uint64_t x = 88172645463325252ULL;
+    auto rnd = [&]() {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        return x;
+    };
+    for (int i = 0; i < 5000000; i++)
+    {
+        uint64_t r = rnd() % 100;
+        if (r < 10)
+        {
+            // Video chunks: a fresh id almost every time
+            uint64_t id = (3ULL << 40) + rnd() % 20000000;
+            out.write(id, 0x51DE, 0, EXCLUSIVE, false, 0, (uint32_t)((1 + id % 4) << 20));
+            continue;
+        }
+        uint64_t rank = std::lower_bound(cdf.begin(), cdf.end(), (rnd() >> 11) * (sum / 9007199254740992.0)) - cdf.begin();
+        uint64_t h = rank * 0x9E3779B97F4A7C15ULL;
+        if (r < 70)
+            out.write((1ULL << 40) + rank, 0x1A6E, 1, SHARED, false, 0, (uint32_t)(4096 + h % 61440));
+        else
+            out.write((2ULL << 40) + rank, 0xA11, 0, (h & 1) ? MODIFIED : EXCLUSIVE, false, 0, (uint32_t)(100 + h % 1948));
+    }
+}
+
+// Adapter so the scenarios above can be written out as a native trace
+struct TraceEmitter
+{
+    TraceWriter &out;
+    void access(uint64_t addr, uint64_t pc, int sharers, MESI_State state)
+    {
+        out.write(addr, pc, sharers, state, state == MODIFIED);
+    }
+    // A trace holds every epoch
+    bool end_epoch(uint64_t) { return false; }
+};
+
+// ==========================================
+// POLICY FACTORY & TRACE DRIVER
+// ==========================================
+const char *const POLICY_NAMES[] = {"lru", "srrip", "ship", "sdbp", "coalesce", "arc", "lirs", "clockpro", "rl", "bandit"};
+// Arms of the bandit meta-policy
+const char *const BANDIT_PORTFOLIO[] = {"lru", "srrip", "ship", "sdbp", "coalesce"};
+// The hardware policies scan every way, which crawls at page-cache associativity
+const char *const PAGE_POLICY_NAMES[] = {"arc", "lirs", "clockpro"};
+
+std::unique_ptr<ReplacementPolicy> make_policy(const std::string &name, int sets = NUM_SETS, int ways = WAYS)
+{
+    if (name == "lru")      return std::make_unique<LRU_Policy>(sets, ways);
+    if (name == "srrip")    return std::make_unique<SRRIP_Policy>(sets, ways);
+    if (name == "ship")     return std::make_unique<SHiP_Policy>(sets, ways);
+    if (name == "sdbp")     return std::make_unique<SDBP_Policy>(sets, ways);
+    if (name == "coalesce") return std::make_unique<COALESCE_Policy>(sets, ways);
+    if (name == "arc")      return std::make_unique<ARC_Policy>(sets, ways);
+    if (name == "lirs")     return std::make_unique<LIRS_Policy>(sets, ways);
+    if (name == "clockpro") return std::make_unique<CLOCKPro_Policy>(sets, ways);
+    if (name == "rl")       return std::make_unique<RL_Policy>(sets, ways);
+    if (name == "bandit")
+    {
+        std::vector<std::pair<std::string, PolicyFactory>> arms;
+        for (const char *arm : BANDIT_PORTFOLIO)
+            arms.push_back({arm, [arm](int s, int w) { return make_policy(arm, s, w); }});
+        return std::make_unique<BanditPolicy>(arms, sets, ways);
+    }
+    return nullptr;
+}
+
+// Feeds the rest of a stream to `sink(batch, n)`, batch by batch. Traces
+// from the instrumentation runtime carry no coherence state; it is derived
+// on the fly, in `shared_directory` when the caller needs to checkpoint it.
+template <typename Sink>
+void replay_batches(TraceReader &reader, size_t batch_records, Sink sink, CoherenceDirectory *shared_directory = nullptr)
+{
+    bool derive_coherence = reader.header.flags & TRACE_HDR_NEEDS_COHERENCE;
+    CoherenceDirectory local;
+    CoherenceDirectory &directory = shared_directory ? *shared_directory : local;
+    std::vector<TraceRecord> annotated;
+    size_t n = 0;
+    while (const TraceRecord *batch = reader.next_batch(batch_records, n))
+    {
+        if (derive_coherence)
+        {
+            directory.annotate(annotated, batch, n, reader.byte_addresses());
+            batch = annotated.data();
+        }
+        sink(batch, n);
+    }
+}
+
+void replay_trace(TraceReader &reader, size_t batch_records, const std::vector<Simulator *> &sims)
+{
+    replay_batches(reader, batch_records, [&](const TraceRecord *batch, size_t n) {
+        for (Simulator *sim : sims)
+            sim->access_batch(batch, n, reader.byte_addresses());
+    });
+}
+
+// --checkpoint / --resume for run_trace
+struct CheckpointOptions
+{
+    std::string path;     // Empty: no checkpoints
+    double interval = 60; // Seconds between snapshots
+    bool resume = false;
+};
+
+// run_trace with --checkpoint. Between batches, at most every `interval`
+// seconds, the trace position, the coherence directory and every simulator
+// are serialized into memory: that copy is the consistent snapshot, taken
+// while nothing runs. A CheckpointWriter thread puts it on disk while the
+// replay goes on. --resume restores the newest checkpoint and moves the
+// reader past the records it covers; the results are the same as an
+// uninterrupted run.
+bool replay_checkpointed(TraceReader &reader, size_t batch_records, const std::vector<Simulator *> &sims,
+                         const std::string &config, const CheckpointOptions &options, std::string &report)
+{
+    CoherenceDirectory directory;
+    auto state = [&](StateArchive &a, uint64_t &position) {
+        a.expect(std::string(CHECKPOINT_MAGIC), "not a checkpoint of this format");
+        a.expect(config, "taken with another trace, policy list or cache options");
+        a.io(position);
+        directory.checkpoint(a);
+        for (Simulator *sim : sims)
+            sim->checkpoint(a);
+    };
+
+    std::ostringstream out;
+    if (options.resume && access(options.path.c_str(), F_OK) != 0)
+        out << "Resume: no checkpoint at " << options.path << " yet, started from the beginning\n";
+    else if (options.resume)
+    {
+        std::string data, error;
+        uint64_t position = 0;
+        StateArchive a = StateArchive::restoring(data);
+        if (read_checkpoint(options.path, data, error))
+        {
+            state(a, position);
+            if (a.ok && !a.at_end())
+                a.fail("trailing data");
+            error = a.error;
+        }
+        if (!error.empty())
+        {
+            std::cerr << "error: cannot resume from " << options.path << ": " << error << "\n";
+            return false;
+        }
+        if (!reader.skip_to(position))
+        {
+            std::cerr << "error: the trace ends before record " << position << ", where " << options.path
+                      << " left off\n";
+            return false;
+        }
+        out << "Resumed: from " << options.path << " at record " << position << "\n";
+    }
+
+    CheckpointWriter writer(options.path);
+    auto start = std::chrono::steady_clock::now(), last = start;
+    double snapshot_secs = 0;
+    uint64_t snapshots = 0;
+    bool enabled = true;
+    replay_batches(
+        reader, batch_records,
+        [&](const TraceRecord *batch, size_t n) {
+            for (Simulator *sim : sims)
+                sim->access_batch(batch, n, reader.byte_addresses());
+            auto now = std::chrono::steady_clock::now();
+            if (!enabled || std::chrono::duration<double>(now - last).count() < options.interval)
+                return;
+            std::string snapshot;
+            StateArchive a = StateArchive::saving(snapshot);
+            uint64_t position = reader.records_read;
+            state(a, position);
+            if (!a.ok)
+            {
+                std::cerr << "warning: checkpoints disabled: " << a.error << "\n";
+                enabled = false;
+                return;
+            }
+            writer.submit(std::move(snapshot));
+            last = std::chrono::steady_clock::now();
+            snapshot_secs += std::chrono::duration<double>(last - now).count();
+            snapshots++;
+        },
+        &directory);
+    writer.finish();
+
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    out << "Checkpoints: " << snapshots << " taken, " << writer.written << " written to " << options.path;
+    if (writer.written)
+        out << " (" << std::fixed << std::setprecision(1) << writer.bytes / 1048576.0 << " MB each)";
+    out << ", " << std::fixed << std::setprecision(2) << 100.0 * snapshot_secs / std::max(secs, 1e-9)
+        << "% of the run in snapshots";
+    if (writer.replaced)
+        out << ", " << writer.replaced << " superseded before the disk caught up";
+    out << "\n";
+    if (writer.failed)
+        out << "    WARNING: " << writer.failed << " checkpoint writes failed: " << writer.error << "\n";
+    report = out.str();
+    return true;
+}
+
+// Per-node trace images above this stream from the file instead
+const size_t TRACE_IMAGE_MAX_BYTES = 4ULL << 30;
+
+// Streams a trace through one or more policies side by side. Every batch is
+// fed to all simulators before the next read, so memory stays at one reader
+// buffer regardless of trace length (e.g. `tracer | coalesce_engine --trace=-`).
+//
+// With several threads and a trace file that can be opened more than once,
+// each policy becomes a job on a pinned worker (see topology.h) with its own
+// reader, or replays its node's in-memory copy of the trace when other
+// workers on that node need it too. Results are the same either way.
+//
+// With a result cache (result_cache.h), policies whose stats are stored for
+// this trace and configuration are printed from it and not simulated.
+int run_trace(const std::string &spec, const std::vector<std::string> &policies, size_t batch_records, bool tinylfu,
+              const CacheGeometry &geo, bool eager = false, const TieredMemory *memory = nullptr,
+              const std::string &rl_weights = "", int threads = 1,
+              const CheckpointOptions &checkpoint = CheckpointOptions(), ResultCache *results = nullptr)
+{
+    RLValueFunction pretrained;
+    if (!rl_weights.empty() && !pretrained.load(rl_weights))
+    {
+        std::cerr << "error: cannot load RL weights from " << rl_weights << "\n";
+        return 1;
+    }
+
+    std::vector<std::unique_ptr<ReplacementPolicy>> owned(policies.size());
+    std::vector<std::unique_ptr<TinyLFU>> filters(policies.size());
+    std::vector<std::unique_ptr<Simulator>> sims(policies.size());
+    auto build = [&](size_t i) {
+        owned[i] = make_policy(policies[i], geo.sets, geo.ways);
+        if (policies[i] == "rl" && !rl_weights.empty())
+            static_cast<RL_Policy *>(owned[i].get())->load_weights(pretrained);
+        if (tinylfu)
+            filters[i] = std::make_unique<TinyLFU>(geo.blocks());
+        sims[i] = std::make_unique<Simulator>(owned[i].get(), filters[i].get(), geo);
+        if (eager)
+            sims[i]->enable_eager_writeback();
+        if (memory)
+            sims[i]->enable_tiered_memory(*memory);
+        return sims[i].get();
+    };
+
+    // Also validates the header before any worker starts
+    TraceReader reader;
+    if (!reader.open(spec))
+    {
+        std::cerr << "error: " << reader.error << "\n";
+        return 1;
+    }
+
+    std::cout << ">>> TRACE: " << spec;
+    if (geo.block_bits != 6)
+        std::cout << " (page cache: " << geo.blocks() << " x " << (1 << geo.block_bits) << "B, "
+                  << geo.ways << "-way)";
+    std::cout << "\n";
+
+    // What one policy's stats depend on; the other policies of the run don't count
+    auto result_config = [&](size_t i) {
+        std::ostringstream config;
+        config << "trace policy=" << policies[i] << " geometry=" << geo.sets << "x" << geo.ways << "x"
+               << (1 << geo.block_bits) << " tinylfu=" << tinylfu << " eager=" << eager
+               << " memory=" << (memory ? memory->describe() : "flat");
+        if (policies[i] == "rl" && !rl_weights.empty())
+            config << " weights=" << results->input_hash(rl_weights);
+        return config.str();
+    };
+    std::vector<CachedResult> cached(policies.size());
+    std::vector<size_t> todo; // Policies to simulate
+    for (size_t i = 0; i < policies.size(); i++)
+        if (!results || !results->lookup(result_config(i), cached[i]))
+            todo.push_back(i);
+
+    size_t file_bytes = 0;
+    std::unique_ptr<NodeScheduler> scheduler;
+    std::vector<std::unique_ptr<TraceReader>> job_readers(policies.size());
+    std::string checkpoint_report;
+    if (threads > 1 && todo.size() > 1 && checkpoint.path.empty() && trace_is_file(spec, file_bytes))
+    {
+        scheduler = std::make_unique<NodeScheduler>(threads);
+        int nodes = scheduler->topology().nodes();
+        std::vector<TraceImage> images(nodes);
+        std::vector<std::once_flag> loaded(nodes);
+        scheduler->run(todo.size(), [&](size_t job, const WorkerSlot &slot) -> uint64_t {
+            size_t i = todo[job];
+            Simulator *sim = build(i); // On the worker, so its memory is node-local
+            bool shared = file_bytes <= TRACE_IMAGE_MAX_BYTES && scheduler->workers_on(slot.node, todo.size()) > 1;
+            TraceImage &image = images[slot.node];
+            if (shared)
+                std::call_once(loaded[slot.node], [&]() { image.load(spec); });
+
+            auto r = std::make_unique<TraceReader>(shared ? 0 : TRACE_DEFAULT_BUFFER);
+            bool ok = shared ? image.data && r->open_image(image.data, image.size) : r->open(spec);
+            if (!ok && r->error.empty())
+                r->error = image.error;
+            if (ok)
+                replay_trace(*r, batch_records, {sim});
+            job_readers[i] = std::move(r);
+            return job_readers[i]->records_read;
+        });
+    }
+    else if (!todo.empty())
+    {
+        std::vector<Simulator *> all;
+        for (size_t i : todo)
+            all.push_back(build(i));
+        if (checkpoint.path.empty())
+            replay_trace(reader, batch_records, all);
+        else
+        {
+            // Everything a resumed run must agree on
+            std::ostringstream config;
+            config << spec;
+            if (trace_is_file(spec, file_bytes))
+                config << " (" << file_bytes << " bytes)";
+            for (size_t i : todo)
+                config << " " << policies[i];
+            config << " " << geo.sets << "x" << geo.ways << "x" << (1 << geo.block_bits) << "B"
+                   << (tinylfu ? " tinylfu" : "") << (eager ? " eager" : "");
+            if (memory)
+                config << " " << memory->describe();
+            if (!replay_checkpointed(reader, batch_records, all, config.str(), checkpoint, checkpoint_report))
+                return 1;
+        }
+    }
+
+    // Every job read the same file, so any one of them speaks for the stream;
+    // the first failure is the one worth reporting
+    const TraceReader *result = &reader;
+    for (const auto &r : job_readers)
+        if (r && (result == &reader || (!r->complete() && result->complete())))
+            result = r.get();
+
+    // Nothing simulated: the stored runs read the whole trace
+    bool complete = todo.empty() || result->complete();
+    uint64_t records = todo.empty() ? cached[0].records : result->records_read;
+    for (size_t i = 0; i < policies.size(); i++)
+    {
+        if (!sims[i])
+        {
+            std::cout << cached[i].text;
+            continue;
+        }
+        std::ostringstream text;
+        std::streambuf *out = std::cout.rdbuf(text.rdbuf());
+        sims[i]->print_stats();
+        std::cout.rdbuf(out);
+        std::cout << text.str();
+        if (results && complete)
+            results->store(result_config(i),
+                           {records, {sims[i]->hits, sims[i]->misses, sims[i]->total_latency}, text.str()});
+    }
+    std::cout << "Records: " << records;
+    if (complete)
+        std::cout << " (end-of-stream OK)\n";
+    else if (result->saw_end_marker)
+        std::cout << " (WARNING: producer announced " << result->records_expected << ")\n";
+    else
+        std::cout << " (WARNING: stream truncated, no end-of-stream record"
+                  << (result->error.empty() ? "" : ", " + result->error) << ")\n";
+    if (results)
+        results->print(std::cout, policies.size() - todo.size(), policies.size());
+    std::cout << checkpoint_report;
+    if (scheduler)
+        scheduler->print(std::cout);
+    std::cout << "--------------------------------------------------------\n";
+    return complete ? 0 : 2;
+}
+
+// One row per CoalesceParams setting from --sweep, each as if COALESCE ran
+// alone on this trace. Settings go SWEEP_LANES at a time into a
+// CoalesceSweep (coalesce_sweep.h), so a pass reads and decodes the trace
+// once for all of its lanes. More passes than one need a trace file; they
+// run as jobs on pinned workers, like run_trace's policies.
+int run_sweep(const std::string &spec, const std::vector<CoalesceParams> &configs, size_t batch_records,
+              const CacheGeometry &geo, int threads)
+{
+    if (geo.ways >= TAG_INDEX_MIN_WAYS)
+    {
+        std::cerr << "error: --sweep models the set-associative block cache, not --page-cache\n";
+        return 1;
+    }
+
+    TraceReader reader;
+    if (!reader.open(spec))
+    {
+        std::cerr << "error: " << reader.error << "\n";
+        return 1;
+    }
+    size_t passes = (configs.size() + SWEEP_LANES - 1) / SWEEP_LANES;
+    size_t file_bytes = 0;
+    if (passes > 1 && !trace_is_file(spec, file_bytes))
+    {
+        std::cerr << "error: " << configs.size() << " settings take " << passes
+                  << " passes over the trace; that needs a file, not a stream\n";
+        return 1;
+    }
+
+    std::cout << ">>> SWEEP: " << spec << " (" << configs.size() << " settings, " << passes << " pass"
+              << (passes > 1 ? "es" : "") << " of up to " << SWEEP_LANES << " lanes)\n";
+
+    std::vector<std::unique_ptr<CoalesceSweep>> sweeps(passes);
+    std::vector<std::unique_ptr<TraceReader>> job_readers(passes);
+    auto pass = [&](size_t p, TraceReader &r) {
+        std::vector<CoalesceParams> lanes(configs.begin() + p * SWEEP_LANES,
+                                          configs.begin() + std::min(configs.size(), (p + 1) * SWEEP_LANES));
+        sweeps[p] = std::make_unique<CoalesceSweep>(lanes, geo.sets, geo.ways, geo.block_bits);
+        CoalesceSweep &sweep = *sweeps[p];
+        replay_batches(r, batch_records,
+                       [&](const TraceRecord *batch, size_t n) { sweep.access_batch(batch, n, r.byte_addresses()); });
+        return r.records_read;
+    };
+
+    auto t0 = std::chrono::steady_clock::now();
+    std::unique_ptr<NodeScheduler> scheduler;
+    if (passes == 1)
+        pass(0, reader);
+    else
+    {
+        scheduler = std::make_unique<NodeScheduler>(threads);
+        scheduler->run(passes, [&](size_t p, const WorkerSlot &) -> uint64_t {
+            job_readers[p] = std::make_unique<TraceReader>();
+            return job_readers[p]->open(spec) ? pass(p, *job_readers[p]) : 0;
+        });
+    }
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+    const TraceReader *result = &reader;
+    for (const auto &r : job_readers)
+        if (r && (result == &reader || (!r->complete() && result->complete())))
+            result = r.get();
+
+    size_t best = 0;
+    double best_amat = 0;
+    for (size_t i = 0; i < configs.size(); i++)
+    {
+        const CoalesceSweep &sweep = *sweeps[i / SWEEP_LANES];
+        int lane = i % SWEEP_LANES;
+        uint64_t accesses = std::max<uint64_t>(1, sweep.hits[lane] + sweep.misses[lane]);
+        double amat = (double)sweep.total_latency[lane] / accesses;
+        if (i == 0 || amat < best_amat)
+        {
+            best = i;
+            best_amat = amat;
+        }
+        std::cout << std::left << std::setw(62) << sweep_label(configs[i]) << " | Hit Rate: " << std::fixed
+                  << std::setprecision(2) << std::setw(6) << 100.0 * sweep.hits[lane] / accesses << "%"
+                  << " | AMAT: " << std::setprecision(1) << std::setw(6) << amat << " cyc"
+                  << " | Phase changes: " << sweep.phase_changes[lane] << "\n";
+    }
+    std::cout << "Best AMAT: " << sweep_label(configs[best]) << "\n";
+    std::cout << "Records: " << result->records_read;
+    if (result->complete())
+        std::cout << " (end-of-stream OK)\n";
+    else
+        std::cout << " (WARNING: stream truncated" << (result->error.empty() ? "" : ", " + result->error) << ")\n";
+    std::cout << "Simulated: " << std::setprecision(1)
+              << result->records_read * configs.size() / std::max(secs, 1e-9) / 1e6 << " M record-settings/s\n";
+    if (scheduler)
+        scheduler->print(std::cout);
+    std::cout << "--------------------------------------------------------\n";
+    return result->complete() ? 0 : 2;
+}
+
+// "64M" -> 67108864; K, M and G are powers of 1024
+bool parse_bytes(const char *text, uint64_t &bytes)
+{
+    char *unit = nullptr;
+    double v = strtod(text, &unit);
+    std::string u = unit ? unit : "";
+    if (u == "K" || u == "k") v *= 1024;
+    else if (u == "M" || u == "m") v *= 1024 * 1024;
+    else if (u == "G" || u == "g") v *= 1024.0 * 1024 * 1024;
+    else if (!u.empty() || unit == text)
+        return false;
+    bytes = (uint64_t)std::max(1.0, v);
+    return true;
+}
+
+std::string format_bytes(uint64_t bytes)
+{
+    const char *units[] = {"", "K", "M", "G"};
+    int u = 0;
+    while (u < 3 && bytes >= 1024 && bytes % 1024 == 0)
+    {
+        bytes /= 1024;
+        u++;
+    }
+    return std::to_string(bytes) + units[u];
+}
+
+// Reads the rest of `reader` and hands each miniature's sampled records to
+// its simulators batch by batch, so memory stays at one batch however long
+// the stream. `only` >= 0 keeps just that miniature. Each miniature has its
+// own coherence directory: the directory tracks lines independently and no
+// line spans two miniatures, so this gives the full trace's state.
+uint64_t replay_miniatures(TraceReader &reader, size_t batch_records, const SpatialSampler &sampler, int shift,
+                           int block_bits, std::vector<Simulator *> (&sims)[MRC_MINIATURES], int only)
+{
+    bool byte_addresses = reader.byte_addresses();
+    bool derive_coherence = reader.header.flags & TRACE_HDR_NEEDS_COHERENCE;
+    CoherenceDirectory directories[MRC_MINIATURES];
+    std::vector<TraceRecord> split[MRC_MINIATURES];
+    std::vector<TraceRecord> annotated;
+    uint64_t sampled = 0;
+    size_t n = 0;
+    while (const TraceRecord *batch = reader.next_batch(batch_records, n))
+    {
+        for (auto &part : split)
+            part.clear();
+        for (size_t i = 0; i < n; i++)
+        {
+            int m = sampler.pick((batch[i].addr << shift) >> block_bits);
+            if (m >= 0 && (only < 0 || m == only))
+                split[m].push_back(batch[i]);
+        }
+        for (int m = 0; m < MRC_MINIATURES; m++)
+        {
+            const TraceRecord *recs = split[m].data();
+            size_t k = split[m].size();
+            if (k == 0)
+                continue;
+            if (derive_coherence)
+            {
+                directories[m].annotate(annotated, recs, k, byte_addresses);
+                recs = annotated.data();
+            }
+            for (Simulator *sim : sims[m])
+                sim->access_batch(recs, k, byte_addresses);
+            sampled += k;
+        }
+    }
+    return sampled;
+}
+
+// Approximate miss-ratio curves for any policy by miniature simulation
+// (miniature.h): the sampled blocks' records are split into MRC_MINIATURES
+// streams as they are read, each feeding every (policy, size) in a cache
+// scaled down by the sampler. A trace file gets one pinned worker per
+// miniature, each with its own reader; a stream is one pass on one worker.
+int run_mrc(const std::string &spec, const std::vector<std::string> &policies, const std::vector<uint64_t> &sizes,
+            size_t batch_records, bool tinylfu, const CacheGeometry &geo, bool eager, int sample_rate, int threads)
+{
+    TraceReader reader;
+    if (!reader.open(spec))
+    {
+        std::cerr << "error: " << reader.error << "\n";
+        return 1;
+    }
+
+    SpatialSampler sampler(sample_rate);
+    std::cout << ">>> MRC: " << spec << " (1 in " << sample_rate << " " << (geo.block_bits == 6 ? "lines" : "pages")
+              << ", " << MRC_MINIATURES << " miniatures scaled down " << sampler.scale() << "x)\n";
+
+    std::vector<CacheGeometry> minis(sizes.size());
+    std::vector<MrcPoint> points(policies.size() * sizes.size());
+    for (size_t s = 0; s < sizes.size(); s++)
+    {
+        // Fewer sets at the same associativity; a page cache stays one set
+        int64_t lines = std::min<int64_t>((sizes[s] >> geo.block_bits) / sampler.scale(), INT32_MAX);
+        CacheGeometry &mini = minis[s];
+        mini.block_bits = geo.block_bits;
+        mini.ways = geo.sets == 1 ? (int)lines : geo.ways;
+        mini.sets = std::max<int64_t>(1, lines / mini.ways);
+        for (size_t p = 0; p < policies.size(); p++)
+            points[p * sizes.size() + s].too_small = lines < std::max(MRC_MIN_LINES, geo.sets == 1 ? 0 : geo.ways);
+    }
+    size_t simulated = 0;
+    for (const MrcPoint &pt : points)
+        simulated += pt.too_small ? 0 : MRC_MINIATURES;
+
+    // Samples what Simulator::set_of indexes by, so a sampled unit brings
+    // every record that would compete with it for a set
+    int shift = (!reader.byte_addresses() && geo.block_bits > 6) ? 6 : 0;
+    size_t file_bytes = 0;
+    size_t passes = threads > 1 && trace_is_file(spec, file_bytes) ? MRC_MINIATURES : 1;
+    std::vector<std::unique_ptr<TraceReader>> job_readers(passes);
+    std::vector<uint64_t> sampled(passes, 0);
+    auto t0 = std::chrono::steady_clock::now();
+    NodeScheduler scheduler(threads);
+    scheduler.run(passes, [&](size_t j, const WorkerSlot &) -> uint64_t {
+        int only = passes > 1 ? (int)j : -1;
+        TraceReader *r = &reader;
+        if (passes > 1)
+        {
+            job_readers[j] = std::make_unique<TraceReader>();
+            r = job_readers[j].get();
+            if (!r->open(spec))
+                return 0;
+        }
+
+        // Built on the worker, so their memory is node-local
+        std::vector<std::unique_ptr<ReplacementPolicy>> owned_policies;
+        std::vector<std::unique_ptr<TinyLFU>> filters;
+        std::vector<std::unique_ptr<Simulator>> owned;
+        std::vector<Simulator *> sims[MRC_MINIATURES];
+        std::vector<size_t> sim_point[MRC_MINIATURES];
+        for (int m = 0; m < MRC_MINIATURES; m++)
+            for (size_t point = 0; point < points.size() && (only < 0 || m == only); point++)
+            {
+                if (points[point].too_small)
+                    continue;
+                const CacheGeometry &mini = minis[point % sizes.size()];
+                owned_policies.push_back(make_policy(policies[point / sizes.size()], mini.sets, mini.ways));
+                filters.push_back(tinylfu ? std::make_unique<TinyLFU>(mini.blocks()) : nullptr);
+                owned.push_back(std::make_unique<Simulator>(owned_policies.back().get(), filters.back().get(), mini));
+                if (eager)
+                    owned.back()->enable_eager_writeback();
+                sims[m].push_back(owned.back().get());
+                sim_point[m].push_back(point);
+            }
+
+        sampled[j] = replay_miniatures(*r, batch_records, sampler, shift, geo.block_bits, sims, only);
+        for (int m = 0; m < MRC_MINIATURES; m++)
+            for (size_t i = 0; i < sims[m].size(); i++)
+            {
+                points[sim_point[m][i]].misses[m] = sims[m][i]->misses;
+                points[sim_point[m][i]].accesses[m] = sims[m][i]->hits + sims[m][i]->misses;
+            }
+        return r->records_read;
+    });
+    double sim_secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+    // Report the pass that fell short, if any
+    TraceReader *result = &reader;
+    for (auto &r : job_readers)
+        if (r && (result == &reader || (!r->complete() && result->complete())))
+            result = r.get();
+    uint64_t total_sampled = 0;
+    for (uint64_t k : sampled)
+        total_sampled += k;
+
+    std::cout << std::left << std::setw(10) << "Size";
+    for (const std::string &p : policies)
+        std::cout << " | " << std::setw(18) << (p + (tinylfu ? "+TinyLFU" : ""));
+    std::cout << "\n";
+    for (size_t s = 0; s < sizes.size(); s++)
+    {
+        std::cout << std::left << std::setw(10) << format_bytes(sizes[s]);
+        for (size_t p = 0; p < policies.size(); p++)
+        {
+            const MrcPoint &pt = points[p * sizes.size() + s];
+            std::ostringstream cell;
+            if (pt.too_small)
+                cell << "too small";
+            else if (!pt.sampled())
+                cell << "no samples";
+            else
+                cell << std::fixed << std::setprecision(2) << 100.0 * pt.miss_ratio() << "% +/- "
+                     << 100.0 * pt.std_error();
+            std::cout << " | " << std::setw(18) << cell.str();
+        }
+        std::cout << "\n";
+    }
+    std::cout << "Miss ratios +/- one standard error across miniatures; 'too small' sizes scale below "
+              << (geo.sets == 1 ? std::to_string(MRC_MIN_LINES) + " blocks" : "one set") << " (lower --sample)\n";
+    std::cout << "Records: " << result->records_read;
+    if (result->complete())
+        std::cout << " (end-of-stream OK)\n";
+    else
+        std::cout << " (WARNING: stream truncated" << (result->error.empty() ? "" : ", " + result->error) << ")\n";
+    std::cout << "Sampled: " << total_sampled << " (" << std::fixed << std::setprecision(2)
+              << 100.0 * total_sampled / std::max<uint64_t>(1, result->records_read) << "%), " << simulated
+              << " miniatures simulated in " << passes << (passes > 1 ? " passes" : " pass") << ", "
+              << std::setprecision(2) << sim_secs << " s\n";
+    scheduler.print(std::cout);
+    std::cout << "--------------------------------------------------------\n";
+    return result->complete() ? 0 : 2;
+}
+
+// "50M" -> 50000000 records; K, M and G are powers of 1000
+bool parse_count(const char *text, uint64_t &count)
+{
+    char *unit = nullptr;
+    double v = strtod(text, &unit);
+    std::string u = unit ? unit : "";
+    if (u == "K" || u == "k") v *= 1e3;
+    else if (u == "M" || u == "m") v *= 1e6;
+    else if (u == "G" || u == "g") v *= 1e9;
+    else if (!u.empty() || unit == text || v < 0)
+        return false;
+    count = (uint64_t)v;
+    return true;
+}
+
+// One --branches entry: what a forked child changes at its branch point
+struct BranchSpec
+{
+    std::string label;  // As given on the command line
+    std::string policy; // Same as the prefix's: keep going (retuned, if knobs are given)
+    bool tuned = false; // COALESCE knobs were given
+    CoalesceParams knobs;
+};
+
+// "lru,ship,coalesce:threshold=20:override=-60" -> one branch per entry.
+// Knobs use the --sweep names, one value each.
+bool parse_branches(const std::string &list, std::vector<BranchSpec> &out, std::string &error)
+{
+    for (size_t pos = 0; pos < list.size();)
+    {
+        size_t comma = std::min(list.find(',', pos), list.size());
+        BranchSpec b;
+        b.label = list.substr(pos, comma - pos);
+        size_t colon = std::min(b.label.find(':'), b.label.size());
+        b.policy = b.label.substr(0, colon);
+        if (!make_policy(b.policy))
+        {
+            error = "unknown branch policy '" + b.policy + "'";
+            return false;
+        }
+        if (colon < b.label.size())
+        {
+            std::vector<CoalesceParams> knobs;
+            if (b.policy != "coalesce")
+            {
+                error = "branch '" + b.label + "': knobs only apply to coalesce";
+                return false;
+            }
+            if (!parse_sweep(b.label.substr(colon + 1), knobs, error))
+                return false;
+            if (knobs.size() != 1)
+            {
+                error = "branch '" + b.label + "': one value per knob (separate branches with ',')";
+                return false;
+            }
+            b.tuned = true;
+            b.knobs = knobs[0];
+        }
+        out.push_back(b);
+        pos = comma + 1;
+    }
+    if (out.empty())
+        error = "--branches is empty";
+    return !out.empty();
+}
+
+// What a branch sends back over its pipe, followed by its print_stats text
+struct BranchReport
+{
+    uint64_t hits, misses, total_latency; // Since the branch point
+    uint64_t records;
+    uint32_t complete;
+    uint32_t text_bytes;
+};
+
+bool write_all(int fd, const void *data, size_t n)
+{
+    const char *p = static_cast<const char *>(data);
+    while (n)
+    {
+        ssize_t put = ::write(fd, p, n);
+        if (put < 0 && errno == EINTR)
+            continue;
+        if (put <= 0)
+            return false;
+        p += put;
+        n -= put;
+    }
+    return true;
+}
+
+std::string read_all(int fd)
+{
+    std::string data;
+    char chunk[4096];
+    for (;;)
+    {
+        ssize_t got = ::read(fd, chunk, sizeof(chunk));
+        if (got < 0 && errno == EINTR)
+            continue;
+        if (got <= 0)
+            return data;
+        data.append(chunk, got);
+    }
+}
+
+// What-if branching (--branch-at): the trace is replayed once with the
+// --policy configuration, and at each branch point the run fork()s one child
+// per --branches entry. The child inherits the warm cache, the policy's
+// predictor, the coherence directory and the reader's buffer and file
+// position copy-on-write, applies its change, runs to the end of the trace
+// and reports over a pipe. The parent carries on unchanged as the baseline,
+// so the shared prefix is simulated once however many alternatives there are.
+//
+// Children run alongside the parent, one process each, and never branch
+// again. The reader keeps its own offset (pread), so parent and children
+// need a trace file, not a stream.
+int run_branches(const std::string &spec, const std::string &policy_name, std::vector<uint64_t> points,
+                 const std::vector<BranchSpec> &branches, size_t batch_records, bool tinylfu, const CacheGeometry &geo,
+                 bool eager = false, const TieredMemory *memory = nullptr)
+{
+    TraceReader reader;
+    if (!reader.open(spec))
+    {
+        std::cerr << "error: " << reader.error << "\n";
+        return 1;
+    }
+    if (!reader.forkable())
+    {
+        std::cerr << "error: --branch-at needs a trace file; branches cannot share a pipe or socket\n";
+        return 1;
+    }
+    std::sort(points.begin(), points.end());
+    points.erase(std::unique(points.begin(), points.end()), points.end());
+
+    std::unique_ptr<ReplacementPolicy> policy = make_policy(policy_name, geo.sets, geo.ways);
+    std::unique_ptr<TinyLFU> filter = tinylfu ? std::make_unique<TinyLFU>(geo.blocks()) : nullptr;
+    Simulator sim(policy.get(), filter.get(), geo);
+    if (eager)
+        sim.enable_eager_writeback();
+    if (memory)
+        sim.enable_tiered_memory(*memory);
+
+    std::cout << ">>> BRANCHES: " << spec << " (" << policy->name() << ", " << branches.size() << " branch"
+              << (branches.size() > 1 ? "es" : "") << " at each of " << points.size() << " point"
+              << (points.size() > 1 ? "s" : "") << ")\n";
+
+    struct Branch
+    {
+        pid_t pid;
+        int fd; // Read end of its pipe
+        size_t spec;
+        uint64_t at;
+        uint64_t hits, misses, total_latency; // Baseline's, at the branch point
+    };
+    std::vector<Branch> children;
+    std::unique_ptr<ReplacementPolicy> switched; // In a child: the branch's own policy
+    int report_fd = -1;                          // In a child: write end of its pipe
+    uint64_t done = 0;
+    size_t next_point = 0;
+
+    auto fork_branches = [&]() {
+        std::cout.flush(); // Or the children print it again
+        for (size_t b = 0; b < branches.size(); b++)
+        {
+            int fds[2];
+            if (pipe(fds) != 0)
+            {
+                std::cerr << "warning: pipe: " << strerror(errno) << ", skipping the rest at " << done << "\n";
+                return;
+            }
+            pid_t pid = fork();
+            if (pid < 0)
+            {
+                std::cerr << "warning: fork: " << strerror(errno) << ", skipping the rest at " << done << "\n";
+                ::close(fds[0]);
+                ::close(fds[1]);
+                return;
+            }
+            if (pid == 0)
+            {
+                ::close(fds[0]);
+                for (const Branch &c : children)
+                    ::close(c.fd);
+                children.clear();
+                report_fd = fds[1];
+                const BranchSpec &change = branches[b];
+                if (change.policy == policy_name && policy_name == "coalesce" && change.tuned)
+                    static_cast<COALESCE_Policy *>(policy.get())->set_params(change.knobs);
+                else if (change.policy != policy_name || change.tuned)
+                {
+                    if (change.tuned)
+                        switched = std::make_unique<COALESCE_Policy>(geo.sets, geo.ways, change.knobs);
+                    else
+                        switched = make_policy(change.policy, geo.sets, geo.ways);
+                    sim.switch_policy(switched.get());
+                }
+                children.push_back({0, -1, b, done, sim.hits, sim.misses, sim.total_latency});
+                return;
+            }
+            ::close(fds[1]);
+            children.push_back({pid, fds[0], b, done, sim.hits, sim.misses, sim.total_latency});
+        }
+    };
+
+    replay_batches(reader, batch_records, [&](const TraceRecord *batch, size_t n) {
+        while (n)
+        {
+            size_t take = n;
+            if (report_fd < 0 && next_point < points.size())
+                take = std::min<uint64_t>(n, points[next_point] - done);
+            sim.access_batch(batch, take, reader.byte_addresses());
+            batch += take;
+            n -= take;
+            done += take;
+            while (report_fd < 0 && next_point < points.size() && points[next_point] == done)
+            {
+                next_point++;
+                fork_branches();
+            }
+        }
+    });
+
+    if (report_fd >= 0)
+    {
+        // Child: stats back to the parent, then leave without running its
+        // destructors or flushing what it inherited
+        std::ostringstream text;
+        std::streambuf *out = std::cout.rdbuf(text.rdbuf());
+        sim.print_stats();
+        std::cout.rdbuf(out);
+        const Branch &me = children[0];
+        BranchReport report = {sim.hits - me.hits,
+                               sim.misses - me.misses,
+                               sim.total_latency - me.total_latency,
+                               reader.records_read,
+                               reader.complete(),
+                               (uint32_t)text.str().size()};
+        bool sent = write_all(report_fd, &report, sizeof(report)) &&
+                    write_all(report_fd, text.str().data(), text.str().size());
+        _exit(sent ? 0 : 1);
+    }
+
+    std::cout << "baseline:\n";
+    sim.print_stats();
+    auto row = [&](const std::string &label, uint64_t hits, uint64_t misses, uint64_t latency, double baseline) {
+        uint64_t accesses = std::max<uint64_t>(1, hits + misses);
+        double amat = (double)latency / accesses;
+        std::cout << std::left << std::setw(40) << label << " | Hit Rate: " << std::fixed << std::setprecision(2)
+                  << std::setw(6) << 100.0 * hits / accesses << "%"
+                  << " | AMAT: " << std::setprecision(1) << std::setw(6) << amat << " cyc";
+        if (baseline >= 0)
+            std::cout << " | vs baseline: " << std::showpos << amat - baseline << std::noshowpos << " cyc";
+        std::cout << "\n";
+        return amat;
+    };
+
+    // Every child reports after the whole trace; collect in fork order
+    bool all_ok = true;
+    std::vector<std::pair<BranchReport, std::string>> reports(children.size());
+    for (size_t i = 0; i < children.size(); i++)
+    {
+        std::string data = read_all(children[i].fd);
+        ::close(children[i].fd);
+        int status = 0;
+        waitpid(children[i].pid, &status, 0);
+        std::string label = "@" + std::to_string(children[i].at) + " " + branches[children[i].spec].label;
+        BranchReport &report = reports[i].first;
+        if (data.size() < sizeof(report) ||
+            (memcpy(&report, data.data(), sizeof(report)), data.size() != sizeof(report) + report.text_bytes))
+        {
+            std::cout << label << ": FAILED (" << (WIFSIGNALED(status) ? "signal " : "exit status ")
+                      << (WIFSIGNALED(status) ? WTERMSIG(status) : WEXITSTATUS(status)) << ")\n";
+            all_ok = false;
+            report.text_bytes = UINT32_MAX;
+            continue;
+        }
+        reports[i].second = data.substr(sizeof(report));
+        std::cout << label << ":\n" << reports[i].second;
+    }
+
+    // Stats from each branch point on, next to the baseline's over the same
+    // records
+    std::cout << "After the branch point:\n";
+    for (size_t i = 0; i < children.size(); i++)
+    {
+        const Branch &c = children[i];
+        if (i == 0 || children[i - 1].at != c.at)
+        {
+            double baseline = row("@" + std::to_string(c.at) + " baseline", sim.hits - c.hits, sim.misses - c.misses,
+                                  sim.total_latency - c.total_latency, -1);
+            for (size_t j = i; j < children.size() && children[j].at == c.at; j++)
+            {
+                const BranchReport &r = reports[j].first;
+                if (r.text_bytes != UINT32_MAX)
+                    row("@" + std::to_string(c.at) + " " + branches[children[j].spec].label, r.hits, r.misses,
+                        r.total_latency, baseline);
+            }
+        }
+    }
+    for (size_t p = next_point; p < points.size(); p++)
+        std::cout << "@" << points[p] << ": not reached\n";
+
+    std::cout << "Records: " << reader.records_read;
+    if (reader.complete())
+        std::cout << " (end-of-stream OK)\n";
+    else
+        std::cout << " (WARNING: stream truncated" << (reader.error.empty() ? "" : ", " + reader.error) << ")\n";
+    uint64_t shared = 0;
+    for (const Branch &c : children)
+        shared += c.at;
+    std::cout << "Forked: " << children.size() << " branch" << (children.size() == 1 ? "" : "es") << ", " << shared
+              << " prefix records not simulated again\n";
+    std::cout << "--------------------------------------------------------\n";
+    return !all_ok ? 1 : reader.complete() ? 0 : 2;
+}
+
+// Actor-learner RL training: `actors` threads claim shards from the list and
+// replay them in actor mode while one learner thread trains and publishes
+// weights (see rl_trainer.h). Shards are whole traces, so a corpus split
+// into files trains with no coordination beyond the shard counter.
+int train_rl(const std::vector<std::string> &shards, int actors, size_t batch_records, const CacheGeometry &geo,
+             const std::string &weights_path)
+{
+    RLValueFunction initial;
+    bool resumed = !weights_path.empty() && initial.load(weights_path);
+    ParallelRLTrainer trainer(initial);
+
+    struct ShardResult
+    {
+        uint64_t hits = 0, misses = 0, records = 0, experiences = 0;
+        bool complete = false;
+        std::string error;
+    };
+    std::vector<ShardResult> results(shards.size());
+
+    // One shard per job; actors are pinned and build their simulator locally
+    auto actor = [&](size_t i, const WorkerSlot &) -> uint64_t {
+        ActorSink sink(trainer);
+        TraceReader reader;
+        if (!reader.open(shards[i]))
+        {
+            results[i].error = reader.error;
+            return 0;
+        }
+        std::shared_ptr<const RLValueFunction> weights = trainer.latest();
+        RL_Policy policy(geo.sets, geo.ways);
+        policy.attach(&sink, weights);
+        Simulator sim(&policy, nullptr, geo);
+
+        bool derive_coherence = reader.header.flags & TRACE_HDR_NEEDS_COHERENCE;
+        CoherenceDirectory directory;
+        std::vector<TraceRecord> annotated;
+        size_t n = 0;
+        while (const TraceRecord *batch = reader.next_batch(batch_records, n))
+        {
+            if (derive_coherence)
+            {
+                directory.annotate(annotated, batch, n, reader.byte_addresses());
+                batch = annotated.data();
+            }
+            sim.access_batch(batch, n, reader.byte_addresses());
+
+            std::shared_ptr<const RLValueFunction> newest = trainer.latest();
+            if (newest != weights)
+                policy.set_weights(weights = newest);
+        }
+        sink.flush();
+        results[i] = {sim.hits, sim.misses, reader.records_read, policy.experiences, reader.complete(), ""};
+        return reader.records_read;
+    };
+
+    std::cout << ">>> RL TRAINING: " << shards.size() << " shard(s), " << actors << " actor(s) + 1 learner"
+              << (resumed ? ", resuming from " + weights_path : "") << "\n";
+    auto t0 = std::chrono::steady_clock::now();
+    std::thread learner([&]() { trainer.learn(); });
+    NodeScheduler scheduler(actors);
+    scheduler.run(shards.size(), actor);
+    trainer.finish();
+    learner.join();
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+    uint64_t records = 0, experiences = 0;
+    int status = 0;
+    for (size_t i = 0; i < shards.size(); i++)
+    {
+        const ShardResult &r = results[i];
+        std::cout << std::left << std::setw(28) << shards[i] << " | ";
+        if (!r.error.empty())
+        {
+            std::cout << "error: " << r.error << "\n";
+            status = 1;
+            continue;
+        }
+        std::cout << "Hit Rate: " << std::fixed << std::setprecision(2) << std::setw(6)
+                  << 100.0 * r.hits / std::max<uint64_t>(1, r.hits + r.misses) << "% | Records: " << r.records
+                  << (r.complete ? "" : " (WARNING: stream truncated)") << "\n";
+        if (!r.complete && status == 0)
+            status = 2;
+        records += r.records;
+        experiences += r.experiences;
+    }
+
+    uint64_t dropped = trainer.dropped.load();
+    std::cout << "Records: " << records << " in " << std::setprecision(2) << secs << " s ("
+              << std::setprecision(1) << records / secs / 1e6 << " M/s)\n";
+    std::cout << "Experiences: " << experiences << " generated, " << trainer.experiences() << " learned, "
+              << dropped << " dropped (" << std::setprecision(2)
+              << 100.0 * dropped / std::max<uint64_t>(1, experiences) << "%)\n";
+    std::cout << "Mini-batches: " << trainer.model().updates << " | Weight versions published: " << trainer.versions
+              << "\n";
+    scheduler.print(std::cout);
+    if (!weights_path.empty())
+    {
+        if (trainer.model().save(weights_path))
+            std::cout << "Weights written to " << weights_path << "\n";
+        else
+        {
+            std::cerr << "error: cannot write RL weights to " << weights_path << "\n";
+            status = 1;
+        }
+    }
+    std::cout << "--------------------------------------------------------\n";
+    return status;
+}
+
+const char *const OBJECT_POLICY_NAMES[] = {"lru", "gdsf", "adaptsize", "coalesce"};
+
+std::unique_ptr<ObjectPolicy> make_object_policy(const std::string &name, uint64_t capacity_bytes)
+{
+    if (name == "lru")       return std::make_unique<ObjectLRU>();
+    if (name == "gdsf")      return std::make_unique<ObjectGDSF>();
+    if (name == "adaptsize") return std::make_unique<ObjectAdaptSize>(capacity_bytes);
+    if (name == "coalesce")  return std::make_unique<ObjectCOALESCE>();
+    return nullptr;
+}
+
+// Same streaming loop as run_trace, against a byte-capacity object cache
+int run_object_trace(const std::string &spec, const std::vector<std::string> &policies, size_t batch_records,
+                     uint64_t capacity_bytes)
+{
+    std::vector<std::unique_ptr<ObjectPolicy>> owned;
+    std::vector<std::unique_ptr<ObjectCacheSimulator>> sims;
+    for (const std::string &p : policies)
+    {
+        owned.push_back(make_object_policy(p, capacity_bytes));
+        sims.push_back(std::make_unique<ObjectCacheSimulator>(owned.back().get(), capacity_bytes));
+    }
+
+    TraceReader reader;
+    if (!reader.open(spec))
+    {
+        std::cerr << "error: " << reader.error << "\n";
+        return 1;
+    }
+
+    std::cout << ">>> TRACE: " << spec << " (object cache: " << capacity_bytes / 1048576.0 << " MB)\n";
+    size_t n = 0;
+    while (const TraceRecord *batch = reader.next_batch(batch_records, n))
+    {
+        for (auto &sim : sims)
+            sim->access_batch(batch, n);
+    }
+
+    for (auto &sim : sims)
+        sim->print_stats();
+    std::cout << "Records: " << reader.records_read << (reader.complete() ? " (end-of-stream OK)\n" : " (WARNING: stream truncated)\n");
+    std::cout << "--------------------------------------------------------\n";
+    return reader.complete() ? 0 : 2;
+}
+
+int summarize_trace(const std::string &spec, int threads, int sample_rate)
+{
+    TraceReader reader;
+    if (!reader.open(spec))
+    {
+        std::cerr << "error: " << reader.error << "\n";
+        return 1;
+    }
+
+    std::cout << ">>> TRACE SUMMARY: " << spec << " (" << threads << " threads)\n";
+    TraceSummarizer summarizer(threads, sample_rate);
+    bool complete = summarizer.run(reader);
+    summarizer.print_report(std::cout);
+    if (!complete)
+        std::cout << "WARNING: stream truncated, summary covers " << summarizer.records << " records\n";
+    std::cout << "--------------------------------------------------------\n";
+    return complete ? 0 : 2;
+}
+
+int emit_scenario(const std::string &name, const std::string &spec)
+{
+    TraceWriter writer;
+    if (!writer.open(spec))
+    {
+        std::cerr << "error: " << writer.error << "\n";
+        return 1;
+    }
+    TraceEmitter sink{writer};
+    if (name == "cdn")               scenario_cdn(writer);
+    else if (name == "db-scan")      scenario_database_scan(sink);
+    else if (name == "graph-hub")    scenario_graph_hub(sink);
+    else if (name == "phase-change") scenario_phase_change(sink);
+    else
+    {
+        std::cerr << "error: unknown scenario '" << name << "' (db-scan, graph-hub, phase-change, cdn)\n";
+        return 1;
+    }
+    return writer.finish() ? 0 : 1;
+}
+
+void print_usage()
+{
+    std::cout << "usage: coalesce_engine [options]\n"
+              << "  (no options)          run the built-in scenarios\n"
+              << "  --trace=SPEC          simulate a native trace stream. SPEC is a file,\n"
+              << "                        a named pipe, '-' for stdin or unix:PATH\n"
+              << "  --policy=LIST         lru,srrip,ship,sdbp,coalesce,arc,lirs,clockpro,rl,\n"
+              << "                        bandit or 'all' (default)\n"
+              << "  --page-cache[=PAGES]  simulate a fully associative page cache of 4KB pages\n"
+              << "                        (default 16384 = 64MB); policies default to\n"
+              << "                        arc,lirs,clockpro\n"
+              << "  --object-cache=BYTES  simulate a byte-capacity cache of variable-size objects\n"
+              << "                        (trace size field), e.g. 64M; policies\n"
+              << "                        lru,gdsf,adaptsize,coalesce (default: all)\n"
+              << "  --admission=tinylfu   put a W-TinyLFU admission filter in front of the policy\n"
+              << "  --eager-writeback     clean lines the policy predicts dead (COALESCE) in idle\n"
+              << "                        DRAM-bus slots, so their evictions are cheap\n"
+              << "  --memory=SPEC         tiered memory behind the cache: a config file,\n"
+              << "                        first-touch:PAGES (local DRAM, then CXL) or\n"
+              << "                        interleave; misses cost their page's tier\n"
+              << "  --batch=N             records per simulate batch (default 65536)\n"
+              << "  --summarize           with --trace: footprint, distinct lines/PCs, hot\n"
+              << "                        PCs/lines, sharing and reuse profile, no simulation\n"
+              << "  --threads=N           summarizer worker threads / RL training actors /\n"
+              << "                        trace workers, one policy each, pinned per NUMA\n"
+              << "                        node (default: all cores)\n"
+              << "  --sample=R            summarizer reuse sampling / --mrc block sampling,\n"
+              << "                        1 in R lines (default 64)\n"
+              << "  --train-rl            train the RL policy on --trace=SHARD[,SHARD...]: one\n"
+              << "                        actor thread per --threads, plus a learner\n"
+              << "  --rl-weights=FILE     RL model to start from; --train-rl writes it back\n"
+              << "  --sweep=KNOB=V,V:...  with --trace: run COALESCE once per combination of\n"
+              << "                        threshold, override, modified, sharers, sharing\n"
+              << "                        (veto %), 16 settings per pass over the trace\n"
+              << "  --mrc=SIZE[,SIZE...]  with --trace: approximate miss-ratio curves for any\n"
+              << "                        policy, e.g. 256K,1M,4M, from miniature caches fed\n"
+              << "                        1 in --sample blocks, with error bars\n"
+              << "  --branch-at=N[,N...]  with --trace and one --policy: at each record count\n"
+              << "                        (e.g. 50M) fork one child per --branches entry that\n"
+              << "                        continues from the warm state; the parent is the\n"
+              << "                        baseline. Needs a trace file\n"
+              << "  --branches=LIST       what each branch switches to: a policy, or\n"
+              << "                        coalesce:KNOB=V:... to retune it (--sweep knobs)\n"
+              << "  --checkpoint=FILE     with --trace: snapshot every policy's full state and\n"
+              << "                        the trace position to FILE, written in the background\n"
+              << "  --checkpoint-every=S  seconds between checkpoints (default 60)\n"
+              << "  --resume              continue from --checkpoint's FILE if it exists; same\n"
+              << "                        trace and options as the interrupted run\n"
+              << "  --result-cache=DIR    with --trace FILE: print stored stats for policies\n"
+              << "                        already run on this trace, engine build and options,\n"
+              << "                        and store new ones (default $COALESCE_RESULT_CACHE)\n"
+              << "  --extrapolate         built-in scenarios: stop simulating a phase once its\n"
+              << "                        epochs repeat (steady state) and extrapolate the rest\n"
+              << "  --emit=SCENARIO       write db-scan|graph-hub|phase-change|cdn as a trace\n"
+              << "  --out=SPEC            destination for --emit (default '-')\n";
+}
+
+// ==========================================
+// MAIN
+// ==========================================
+int main(int argc, char **argv)
+{
+    std::string trace_spec, emit_name, out_spec = "-";
+    std::vector<std::string> policies;
+    size_t batch_records = 64 * 1024;
+    bool summarize = false;
+    bool tinylfu = false;
+    CacheGeometry geo;
+    bool page_cache = false;
+    uint64_t object_cache_bytes = 0;
+    int threads = std::max(1u, std::thread::hardware_concurrency());
+    int sample_rate = 64;
+    bool train = false;
+    bool eager = false;
+    bool extrapolate = false;
+    std::string memory_spec;
+    std::string rl_weights;
+    std::vector<CoalesceParams> sweep;
+    std::vector<uint64_t> mrc_sizes;
+    std::vector<uint64_t> branch_points;
+    std::vector<BranchSpec> branches;
+    CheckpointOptions checkpoint;
+    const char *result_dir = getenv("COALESCE_RESULT_CACHE");
+    std::string result_cache_dir = result_dir ? result_dir : "";
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        auto value = [&](const char *opt) -> const char * {
+            size_t len = strlen(opt);
+            return arg.compare(0, len, opt) == 0 ? argv[i] + len : nullptr;
+        };
+
+        if (const char *v = value("--trace="))
+            trace_spec = v;
+        else if (const char *v = value("--emit="))
+            emit_name = v;
+        else if (const char *v = value("--out="))
+            out_spec = v;
+        else if (const char *v = value("--batch="))
+            batch_records = std::max(1L, atol(v));
+        else if (const char *v = value("--threads="))
+            threads = std::max(1, atoi(v));
+        else if (const char *v = value("--sample="))
+            sample_rate = std::max(1, atoi(v));
+        else if (arg == "--summarize")
+            summarize = true;
+        else if (arg == "--train-rl")
+            train = true;
+        else if (arg == "--eager-writeback")
+            eager = true;
+        else if (arg == "--extrapolate")
+            extrapolate = true;
+        else if (const char *v = value("--checkpoint="))
+            checkpoint.path = v;
+        else if (const char *v = value("--checkpoint-every="))
+            checkpoint.interval = std::max(0.0, atof(v));
+        else if (arg == "--resume")
+            checkpoint.resume = true;
+        else if (const char *v = value("--result-cache="))
+            result_cache_dir = v;
+        else if (const char *v = value("--memory="))
+            memory_spec = v;
+        else if (const char *v = value("--rl-weights="))
+            rl_weights = v;
+        else if (const char *v = value("--sweep="))
+        {
+            std::string error;
+            if (!parse_sweep(v, sweep, error))
+            {
+                std::cerr << "error: " << error << "\n";
+                return 1;
+            }
+        }
+        else if (arg == "--admission=tinylfu")
+            tinylfu = true;
+        else if (arg == "--admission=none")
+            tinylfu = false;
+        else if (const char *v = value("--object-cache="))
+        {
+            if (!parse_bytes(v, object_cache_bytes))
+            {
+                std::cerr << "error: bad --object-cache size '" << v << "'\n";
+                return 1;
+            }
+        }
+        else if (const char *v = value("--mrc="))
+        {
+            std::string list = v;
+            for (size_t pos = 0; pos < list.size();)
+            {
+                size_t comma = std::min(list.find(',', pos), list.size());
+                uint64_t bytes = 0;
+                if (!parse_bytes(list.substr(pos, comma - pos).c_str(), bytes))
+                {
+                    std::cerr << "error: bad --mrc size '" << list.substr(pos, comma - pos) << "'\n";
+                    return 1;
+                }
+                mrc_sizes.push_back(bytes);
+                pos = comma + 1;
+            }
+        }
+        else if (const char *v = value("--branch-at="))
+        {
+            std::string list = v;
+            for (size_t pos = 0; pos < list.size();)
+            {
+                size_t comma = std::min(list.find(',', pos), list.size());
+                uint64_t at = 0;
+                if (!parse_count(list.substr(pos, comma - pos).c_str(), at))
+                {
+                    std::cerr << "error: bad --branch-at point '" << list.substr(pos, comma - pos) << "'\n";
+                    return 1;
+                }
+                branch_points.push_back(at);
+                pos = comma + 1;
+            }
+        }
+        else if (const char *v = value("--branches="))
+        {
+            std::string error;
+            if (!parse_branches(v, branches, error))
+            {
+                std::cerr << "error: " << error << "\n";
+                return 1;
+            }
+        }
+        else if (arg == "--page-cache" || value("--page-cache="))
+        {
+            int pages = arg == "--page-cache" ? PAGE_CACHE_PAGES : atoi(value("--page-cache="));
+            geo = CacheGeometry::page_cache(std::max(1, pages));
+            page_cache = true;
+        }
+        else if (const char *v = value("--policy="))
+        {
+            std::string list = v;
+            size_t pos = 0;
+            while (pos <= list.size())
+            {
+                size_t comma = list.find(',', pos);
+                std::string p = list.substr(pos, comma == std::string::npos ? std::string::npos : comma - pos);
+                if (p == "all")
+                    policies.push_back("all");
+                else if (make_policy(p) || make_object_policy(p, 1))
+                    policies.push_back(p);
+                else
+                {
+                    std::cerr << "error: unknown policy '" << p << "'\n";
+                    return 1;
+                }
+                if (comma == std::string::npos)
+                    break;
+                pos = comma + 1;
+            }
+        }
+        else
+        {
+            print_usage();
+            return arg == "--help" || arg == "-h" ? 0 : 1;
+        }
+    }
+
+    if (extrapolate && (!trace_spec.empty() || !emit_name.empty()))
+    {
+        std::cerr << "error: --extrapolate only applies to the built-in scenarios; traces carry no epochs\n";
+        return 1;
+    }
+
+    // Sweep lanes are COALESCE on a flat-memory cache with no admission filter
+    // or eager mode (coalesce_sweep.h), so these would be silently ignored
+    if (!sweep.empty() && (!policies.empty() || tinylfu || eager || !memory_spec.empty()))
+    {
+        std::cerr << "error: --sweep runs COALESCE on flat memory; --policy, --admission=tinylfu, --memory and "
+                     "--eager-writeback don't apply to it\n";
+        return 1;
+    }
+
+    bool plain_trace_run = !trace_spec.empty() && emit_name.empty() && !summarize && !train && sweep.empty() &&
+                           mrc_sizes.empty() && branch_points.empty() && branches.empty() && !object_cache_bytes;
+    if ((!checkpoint.path.empty() || checkpoint.resume) && (!plain_trace_run || checkpoint.path.empty()))
+    {
+        std::cerr << "error: --checkpoint=FILE (and --resume) apply to plain --trace runs of the block or page cache\n";
+        return 1;
+    }
+
+    if (!emit_name.empty())
+        return emit_scenario(emit_name, out_spec);
+
+    if (summarize)
+    {
+        if (trace_spec.empty())
+        {
+            std::cerr << "error: --summarize needs --trace=SPEC\n";
+            return 1;
+        }
+        return summarize_trace(trace_spec, threads, sample_rate);
+    }
+
+    if (train)
+    {
+        std::vector<std::string> shards;
+        for (size_t pos = 0; pos < trace_spec.size();)
+        {
+            size_t comma = std::min(trace_spec.find(',', pos), trace_spec.size());
+            if (comma > pos)
+                shards.push_back(trace_spec.substr(pos, comma - pos));
+            pos = comma + 1;
+        }
+        if (shards.empty())
+        {
+            std::cerr << "error: --train-rl needs --trace=SHARD[,SHARD...]\n";
+            return 1;
+        }
+        return train_rl(shards, threads, batch_records, geo, rl_weights);
+    }
+
+    if (!sweep.empty())
+    {
+        if (trace_spec.empty())
+        {
+            std::cerr << "error: --sweep needs --trace=SPEC\n";
+            return 1;
+        }
+        return run_sweep(trace_spec, sweep, batch_records, geo, threads);
+    }
+
+    // "all" and unknown names depend on which cache model runs
+    std::vector<std::string> resolved;
+    for (const std::string &p : policies)
+    {
+        if (p == "all" && object_cache_bytes)
+            resolved.insert(resolved.end(), std::begin(OBJECT_POLICY_NAMES), std::end(OBJECT_POLICY_NAMES));
+        else if (p == "all")
+            resolved.insert(resolved.end(), std::begin(POLICY_NAMES), std::end(POLICY_NAMES));
+        else if (object_cache_bytes ? !make_object_policy(p, 1) : !make_policy(p))
+        {
+            std::cerr << "error: policy '" << p << "' is not available in "
+                      << (object_cache_bytes ? "object cache" : "block cache") << " mode\n";
+            return 1;
+        }
+        else
+            resolved.push_back(p);
+    }
+    policies = resolved;
+
+    if (!mrc_sizes.empty())
+    {
+        if (trace_spec.empty() || object_cache_bytes || !memory_spec.empty())
+        {
+            std::cerr << "error: --mrc needs --trace=SPEC and a block or page cache (no --object-cache or --memory)\n";
+            return 1;
+        }
+        if (policies.empty())
+            policies.assign(page_cache ? std::begin(PAGE_POLICY_NAMES) : std::begin(POLICY_NAMES),
+                            page_cache ? std::end(PAGE_POLICY_NAMES) : std::end(POLICY_NAMES));
+        return run_mrc(trace_spec, policies, mrc_sizes, batch_records, tinylfu, geo, eager, sample_rate, threads);
+    }
+
+    if (!branch_points.empty() || !branches.empty())
+    {
+        if (trace_spec.empty() || branch_points.empty() || branches.empty() || object_cache_bytes ||
+            policies.size() > 1)
+        {
+            std::cerr << "error: --branch-at and --branches go together, with --trace=FILE, at most one --policy\n"
+                      << "       (the prefix's, default coalesce) and a block or page cache\n";
+            return 1;
+        }
+        TieredMemory memory;
+        if (!memory_spec.empty() && !memory.configure(memory_spec))
+        {
+            std::cerr << "error: " << memory.error << "\n";
+            return 1;
+        }
+        return run_branches(trace_spec, policies.empty() ? "coalesce" : policies[0], branch_points, branches,
+                            batch_records, tinylfu, geo, eager, memory_spec.empty() ? nullptr : &memory);
+    }
+
+    if (!trace_spec.empty() && object_cache_bytes)
+    {
+        if (policies.empty())
+            policies.assign(std::begin(OBJECT_POLICY_NAMES), std::end(OBJECT_POLICY_NAMES));
+        return run_object_trace(trace_spec, policies, batch_records, object_cache_bytes);
+    }
+
+    if (!trace_spec.empty())
+    {
+        if (policies.empty() && page_cache)
+            policies.assign(std::begin(PAGE_POLICY_NAMES), std::end(PAGE_POLICY_NAMES));
+        else if (policies.empty())
+            policies.assign(std::begin(POLICY_NAMES), std::end(POLICY_NAMES));
+        TieredMemory memory;
+        if (!memory_spec.empty() && !memory.configure(memory_spec))
+        {
+            std::cerr << "error: " << memory.error << "\n";
+            return 1;
+        }
+        // Only plain runs of a trace file; anything else runs as usual
+        ResultCache results;
+        size_t trace_bytes = 0;
+        bool cache = !result_cache_dir.empty() && plain_trace_run && trace_is_file(trace_spec, trace_bytes);
+        if (cache && !results.open(result_cache_dir, trace_spec))
+        {
+            std::cerr << "warning: result cache disabled: " << results.error << "\n";
+            cache = false;
+        }
+        return run_trace(trace_spec, policies, batch_records, tinylfu, geo, eager, memory_spec.empty() ? nullptr : &memory,
+                         rl_weights, threads, checkpoint, cache ? &results : nullptr);
+    }
+
+    std::cout << "========================================================\n";
+    std::cout << "   COALESCE: FIXED IMPLEMENTATION (All Bugs Resolved)\n";
+    std::cout << "========================================================\n\n";
+
+    // One instance per policy for every scenario, reset in between instead
+    // of rebuilt
+    LRU_Policy lru;
+    SRRIP_Policy srrip;
+    SHiP_Policy ship;
+    SDBP_Policy sdbp;
+    COALESCE_Policy coal;
+    RL_Policy rl;
+    // Portfolio of the above, picked per core by a UCB bandit
+    std::unique_ptr<ReplacementPolicy> bandit = make_policy("bandit");
+    // Frequency-based admission: the cheap alternative to learning
+    LRU_Policy lru_adm;
+    TinyLFU admission(CACHE_SIZE_LINES);
+
+    Simulator s1(&lru), s2(&srrip), s3(&ship), s4(&sdbp), s5(&coal), s7(&rl), s8(bandit.get());
+    Simulator s6(&lru_adm, &admission);
+    Simulator *const sims[] = {&s1, &s2, &s3, &s4, &s5, &s7, &s8, &s6};
+    if (extrapolate)
+        for (Simulator *sim : sims)
+            sim->enable_extrapolation();
+
+    auto run_scenario = [&](std::string name, auto workload_gen)
+    {
+        std::cout << ">>> SCENARIO: " << name << "\n";
+        for (Simulator *sim : sims)
+        {
+            sim->reset();
+            workload_gen(*sim);
+            sim->print_stats();
+        }
+        std::cout << "--------------------------------------------------------\n";
+    };
+
+    run_scenario("Database Scan (Pollution Resistance)", [](Simulator &sim) { scenario_database_scan(sim); });
+    run_scenario("Graph Hub (Coherence Protection)", [](Simulator &sim) { scenario_graph_hub(sim); });
+    run_scenario("Phase Change (Veto Adaptation)", [](Simulator &sim) { scenario_phase_change(sim); });
 
     return 0;
 }
@@ -0,0 +1,2151 @@
+#pragma once
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "checkpoint.h"
+
+// ==========================================
+// CONFIGURATION & CONSTANTS
+// ==========================================
+const int NUM_SETS = 64;
+const int WAYS = 16;
+const int CACHE_SIZE_LINES = NUM_SETS * WAYS;
+
+// Latency & Energy Constants (Cycles/Units)
+const int LATENCY_L3_HIT = 15;
+const int LATENCY_DRAM = 200;
+const int LATENCY_COHERENCE_PENALTY = 100; // Extra cost for evicting Modified/Shared lines
+
+// Perceptron Config
+const int PERCEPTRON_TABLE_SIZE = 2048; // Two tables of 2048 = 4096 total weights (<5KB)
+const int MAX_WEIGHT = 127;
+const int MIN_WEIGHT = -128;
+const int THRESHOLD = 35;      // Training threshold (increased from 25 for stability)
+const int VETO_OVERRIDE = -100; // If vote < -100, ignore Coherence Veto (Definitely Dead)
+
+// Bloom Filter Config (Ghost Buffer)
+const int BLOOM_SIZE = 1024; // 1024 bits
+const int BLOOM_HASHES = 3;
+
+// SHiP / SDBP Config
+const int SHCT_SIZE = 1024; // Signature History Counter Table size
+
+// Sampling Config
+const int SAMPLING_MODULO = 16; // Sample 1 in 16 sets (6.25% instead of 3%)
+
+// Phase Detection Config (COALESCE)
+// Two-sided CUSUM on the per-epoch miss rate against its mean since the last
+// change. An alarm halves every perceptron weight and trains with a bigger
+// step for a while, so stale +127 weights from the old phase don't outvote
+// what the new phase is teaching.
+const int PHASE_EPOCH = 4096;          // Accesses per miss-rate sample
+const int PHASE_WARMUP_EPOCHS = 4;     // Samples taken to set the new mean, no alarms
+const double PHASE_CUSUM_SLACK = 0.05; // Per-epoch drift tolerated (k)
+const double PHASE_CUSUM_LIMIT = 0.5;  // Alarm when accumulated drift exceeds this (h)
+const int PHASE_DECAY_SHIFT = 1;       // Weights >>= 1 on a phase change
+const int PHASE_BOOST_STEP = 4;        // Training step while boosted (normally 1)
+const int PHASE_BOOST_EPOCHS = 16;
+
+// Tiered memory (COALESCE): a confident reuse vote (above THRESHOLD) is
+// scaled up by how much more the line's tier costs to refetch than the
+// cheapest one, in percent of that extra cost. Lines with no confident reuse
+// get nothing, or far-memory streams would pin themselves in the cache. The protection is
+// also spent as it is used (as in depreciating cost-sensitive LRU): a line
+// starts with its extra refetch cost as credit, and every time it survives
+// in place of the victim it would otherwise have been, the victim's refetch
+// cost is taken off, down to 0, where it stays until a hit restores it.
+const int TIER_COST_WEIGHT = 100;
+const int TIER_CREDIT_REFILL = INT_MIN; // Credit not set yet: its tier's extra cost
+
+// The knobs a parameter sweep turns (--sweep). Defaults are the tuned values.
+struct CoalesceParams
+{
+    int threshold = THRESHOLD;         // Keep training while |vote| <= this
+    int veto_override = VETO_OVERRIDE; // At or below this vote, the veto is ignored
+    int veto_modified = 150;           // Unclassified lines: bias for MODIFIED
+    int veto_sharers = 75;             // Unclassified lines: bias for 2+ sharers
+    int sharing_veto_percent = 100;    // Classified lines: SHARING_VETO scaled by this
+};
+
+// ==========================================
+// DATA STRUCTURES
+// ==========================================
+
+enum MESI_State
+{
+    INVALID = 0,
+    SHARED = 1,
+    EXCLUSIVE = 2,
+    MODIFIED = 3
+};
+
+// Sharing pattern of a line, from the coherence request history (see
+// CoherenceDirectory). Lines with the same sharer count can cost very
+// different amounts to lose: a read-shared line only has to be refetched,
+// a migratory one moves with a read-modify-write from core to core, and a
+// producer-consumer line is about to be read by someone else.
+enum SharingClass
+{
+    SHARING_UNCLASSIFIED = 0, // Trace carries no coherence history
+    SHARING_PRIVATE = 1,
+    SHARING_READ_SHARED = 2,
+    SHARING_MIGRATORY = 3,
+    SHARING_PRODUCER_CONSUMER = 4,
+    SHARING_WRITE_SHARED = 5, // Several writers, no hand-off pattern
+};
+const int SHARING_CLASSES = 6;
+const char *const SHARING_CLASS_NAMES[SHARING_CLASSES] = {"unclassified", "private", "read-shared",
+                                                          "migratory",    "prod-cons", "write-shared"};
+// COALESCE veto per class, replacing the MODIFIED/sharers bonus when the class
+// is known. A private dirty line owes its writeback whenever it goes, so it
+// gets no protection; a producer-consumer line is about to be read by another
+// core and is the most expensive to lose.
+const int SHARING_VETO[SHARING_CLASSES] = {0, 0, 75, 150, 225, 150};
+
+// Packed into 16 bytes so a 64MB LLC model (1M lines) needs 16MB of line
+// metadata. Replacement state (LRU stacks, RRPVs, dead bits) lives in each
+// policy's own tables, never here. The PC is kept as the same 12-bit
+// signature CompactGhostEntry and the NoC flit carry; every PC-indexed table
+// hashes no more than those low bits. MODIFIED doubles as the dirty bit.
+const int PC_SIGNATURE_BITS = 12;
+const uint64_t PC_SIGNATURE_MASK = (1u << PC_SIGNATURE_BITS) - 1;
+
+struct CacheLine
+{
+    uint64_t tag;
+    uint32_t pc : PC_SIGNATURE_BITS; // PC signature
+    uint32_t valid : 1;
+    MESI_State state : 2;
+    uint32_t sharers : 8;   // Sharer count, as in the trace record
+    uint32_t sharing : 3;   // SharingClass
+    uint32_t early : 1;     // Written back / self-invalidated ahead of eviction (eager mode)
+    uint32_t tier : 2;      // Memory tier the line was fetched from (tiered backend)
+
+    CacheLine()
+        : tag(0), pc(0), valid(false), state(INVALID), sharers(0), sharing(SHARING_UNCLASSIFIED), early(false),
+          tier(0)
+    {
+    }
+
+    // A valid line, as installed on a miss
+    CacheLine(uint64_t t, uint64_t p, int s, MESI_State st, int sharing_class = SHARING_UNCLASSIFIED, int mem_tier = 0)
+        : tag(t), pc(p & PC_SIGNATURE_MASK), valid(true), state(st), sharers(std::min(s, 255)),
+          sharing(sharing_class), early(false), tier(mem_tier)
+    {
+    }
+};
+static_assert(sizeof(CacheLine) == 16, "CacheLine must stay 16 bytes");
+
+// FNV-1a steps, for ReplacementPolicy::state_hash()
+const uint64_t STATE_HASH_SEED = 0xcbf29ce484222325ULL;
+
+inline uint64_t hash_value(uint64_t h, uint64_t v) { return (h ^ v) * 0x100000001b3ULL; }
+
+template <typename T> uint64_t hash_table(uint64_t h, const std::vector<T> &table)
+{
+    for (const T &v : table)
+        h = hash_value(h, (uint64_t)v);
+    return h;
+}
+
+// Everything but the tag
+inline uint64_t hash_line(uint64_t h, const CacheLine &l)
+{
+    return hash_value(h, l.valid | l.pc << 1 | (uint64_t)l.state << 13 | (uint64_t)l.sharers << 15 |
+                             (uint64_t)l.sharing << 23 | (uint64_t)l.early << 26 | (uint64_t)l.tier << 27);
+}
+
+// ==========================================
+// GHOST BUFFER ENTRY (Fixed Implementation)
+// ==========================================
+// FIX: Store complete feature vector, not just tag+PC
+// struct GhostEntry
+// {
+//     uint64_t tag;
+//     uint64_t pc;
+//     int sharers;
+//     MESI_State state;
+    
+//     GhostEntry() : tag(0), pc(0), sharers(0), state(INVALID) {}
+//     GhostEntry(uint64_t t, uint64_t p, int s, MESI_State st) 
+//         : tag(t), pc(p), sharers(s), state(st) {}
+// };
+// ==========================================
+// COMPACT GHOST ENTRY (Flit-Compatible)
+// ==========================================
+// This matches the 12-bit PC signature that will be transported
+// via NoC flit piggybacking in the hardware implementation.
+// Total storage: 32 bits (4 bytes) per entry
+struct CompactGhostEntry
+{
+    uint32_t packed; // Bit-packed: [PC_sig(12) | Tag_partial(14) | Sharers(3) | State(2) | Valid(1)]
+    
+    CompactGhostEntry() : packed(0) {}
+    
+    // Pack constructor
+    CompactGhostEntry(uint64_t tag, uint64_t pc, int sharers, MESI_State state)
+    {
+        uint32_t pc_sig = (pc & 0xFFF);          // 12 bits - matches NoC flit signature
+        uint32_t tag_partial = (tag & 0x3FFF);   // 14 bits - enough to avoid most collisions
+        uint32_t sharer_bits = (sharers & 0x7);  // 3 bits - supports 0-7 sharers
+        uint32_t state_bits = (state & 0x3);     // 2 bits - MESI (4 states)
+        
+        packed = (pc_sig << 20) |        // Bits [31:20]
+                 (tag_partial << 6) |    // Bits [19:6]
+                 (sharer_bits << 3) |    // Bits [5:3]
+                 (state_bits << 1) |     // Bits [2:1]
+                 1;                      // Bit [0] = valid
+    }
+    
+    // Unpack methods
+    bool is_valid() const { return packed & 0x1; }
+    uint32_t get_pc_sig() const { return (packed >> 20) & 0xFFF; }
+    uint32_t get_tag_partial() const { return (packed >> 6) & 0x3FFF; }
+    int get_sharers() const { return (packed >> 3) & 0x7; }
+    MESI_State get_state() const { return (MESI_State)((packed >> 1) & 0x3); }
+    
+    // Match function (checks PC signature and partial tag)
+    bool matches(uint64_t tag, uint64_t pc) const
+    {
+        if (!is_valid()) return false;
+        return (get_pc_sig() == (pc & 0xFFF)) && 
+               (get_tag_partial() == (tag & 0x3FFF));
+    }
+};
+
+
+// ==========================================
+// BLOOM FILTER WITH FEATURE STORAGE
+// ==========================================
+class BloomFilter
+{
+    int num_bits;
+    std::vector<bool> bit_array;
+    // FIX: Store actual evicted line features indexed by Bloom hash
+    // This is a "ghost tag directory" - we store up to BLOOM_SIZE entries
+    std::vector<CompactGhostEntry> ghost_tags;
+    int insertion_ptr; // Round-robin pointer for limited ghost storage
+
+public:
+    static constexpr int GHOST_CAPACITY = 256; // Reduced from 1024
+
+    explicit BloomFilter(int bits = BLOOM_SIZE, int ghost_capacity = GHOST_CAPACITY) : num_bits(bits), insertion_ptr(0)
+    { 
+        bit_array.resize(num_bits, false); 
+        ghost_tags.resize(ghost_capacity);
+    }
+
+    uint64_t bit_index(uint64_t tag, uint64_t pc, int i) const
+    {
+        return (tag ^ pc ^ (i * 0x9e3779b9)) % num_bits;
+    }
+
+    // Plain set membership on the bit array, no ghost features.
+    // This is what the TinyLFU doorkeeper uses.
+    bool contains(uint64_t key) const
+    {
+        for (int i = 0; i < BLOOM_HASHES; i++)
+            if (!bit_array[bit_index(key, 0, i)])
+                return false;
+        return true;
+    }
+
+    void mark(uint64_t key)
+    {
+        for (int i = 0; i < BLOOM_HASHES; i++)
+            bit_array[bit_index(key, 0, i)] = true;
+    }
+
+    void clear() 
+    { 
+        std::fill(bit_array.begin(), bit_array.end(), false); 
+        std::fill(ghost_tags.begin(), ghost_tags.end(), CompactGhostEntry());
+        insertion_ptr = 0;
+    }
+
+    void checkpoint(StateArchive &a) { a.io(bit_array, ghost_tags, insertion_ptr); }
+
+    // FIX: Store complete feature vector on eviction
+    void insert(uint64_t tag, uint64_t pc, int sharers, MESI_State state)
+    {
+        for (int i = 0; i < BLOOM_HASHES; i++)
+        {
+            uint64_t hash = bit_index(tag, pc, i);
+            bit_array[hash] = true;
+            
+            // Store the actual entry at the first hash position
+            // if (i == 0)
+            //     ghost_tags[hash] = GhostEntry(tag, pc, sharers, state);
+        }
+        // Step 2: Store compact entry in ghost directory (round-robin replacement)
+        // We use a simple direct-mapped cache indexed by hash to avoid full associative search
+        uint64_t ghost_hash = (tag ^ pc) % ghost_tags.size();
+        ghost_tags[ghost_hash] = CompactGhostEntry(tag, pc, sharers, state);
+    }
+
+    // FIX: Return the stored feature vector if found
+    // bool lookup(uint64_t tag, uint64_t pc, GhostEntry& out_entry)
+    // {
+    //     // Check all hash positions
+    //     for (int i = 0; i < BLOOM_HASHES; i++)
+    //     {
+    //         uint64_t hash = (tag ^ pc ^ (i * 0x9e3779b9)) % BLOOM_SIZE;
+    //         if (!bit_array[hash])
+    //             return false; // Definite miss
+    //     }
+        
+    //     // Potential hit - retrieve stored entry from first hash
+    //     uint64_t primary_hash = (tag ^ pc) % BLOOM_SIZE;
+    //     GhostEntry& stored = ghost_tags[primary_hash];
+        
+    //     // Verify it's actually the same line (not a hash collision)
+    //     if (stored.tag == tag && stored.pc == pc)
+    //     {
+    //         out_entry = stored;
+    //         return true;
+    //     }
+        
+    //     return false; // Hash collision
+    // }
+    bool lookup(uint64_t tag, uint64_t pc, int& out_sharers, MESI_State& out_state)
+    {
+        // Step 1: Fast Bloom filter check (eliminates definite misses)
+        for (int i = 0; i < BLOOM_HASHES; i++)
+        {
+            uint64_t hash = bit_index(tag, pc, i);
+            if (!bit_array[hash])
+                return false; // Definite miss
+        }
+        
+        // Step 2: Check ghost directory (may be a collision)
+        uint64_t ghost_hash = (tag ^ pc) % ghost_tags.size();
+        const CompactGhostEntry& entry = ghost_tags[ghost_hash];
+        
+        if (entry.matches(tag, pc))
+        {
+            // Hit! Unpack the stored features
+            out_sharers = entry.get_sharers();
+            out_state = entry.get_state();
+            return true;
+        }
+        
+        return false; // Bloom filter false positive or ghost eviction
+    }
+};
+
+// ==========================================
+// PERCEPTRON BRAIN (Dual Hashed)
+// ==========================================
+class PerceptronBrain
+{
+    std::vector<int> table0; // Hash(PC, State) - "Coherence Context"
+    std::vector<int> table1; // Hash(PC, Sharers) - "Sharing Context"
+    std::vector<int> table2; // Hash(PC, SharingClass) - "Sharing Pattern", classified lines, trained on hits only
+
+public:
+    PerceptronBrain()
+    {
+        table0.resize(PERCEPTRON_TABLE_SIZE, 0);
+        table1.resize(PERCEPTRON_TABLE_SIZE, 0);
+        table2.resize(PERCEPTRON_TABLE_SIZE, 0);
+        reset();
+    }
+
+    void reset()
+    {
+        std::fill(table2.begin(), table2.end(), 0);
+
+        // FIX: Cold Start Initialization
+        // Initialize with a slight negative bias for low-sharer, non-modified lines
+        // This helps the perceptron start with "streaming data is probably dead" assumption
+        for (int i = 0; i < PERCEPTRON_TABLE_SIZE; i++)
+        {
+            // Small random initialization to break symmetry
+            // Bias towards negative for low-sharing scenarios
+            table0[i] = -5 + (i % 11); // Range: -5 to +5
+            table1[i] = -5 + ((i * 7) % 11);
+        }
+    }
+
+    static int get_hash0(uint64_t pc, MESI_State state)
+    {
+        uint64_t h = pc ^ 0x9e3779b9;
+        h ^= (state << 8);
+        return h % PERCEPTRON_TABLE_SIZE;
+    }
+
+    static int get_hash1(uint64_t pc, int sharers)
+    {
+        uint64_t h = pc ^ 0x85ebca6b;
+        h ^= (sharers << 4);
+        return h % PERCEPTRON_TABLE_SIZE;
+    }
+
+    // Keyed by (PC, sharing class) together: the pair is mixed so the class
+    // reaches the index bits, not XORed in above them
+    static int get_hash2(uint64_t pc, int sharing)
+    {
+        uint64_t h = ((pc & PC_SIGNATURE_MASK) << 3 | (uint64_t)sharing) * 0x9e3779b97f4a7c15ULL;
+        return (h >> 32) % PERCEPTRON_TABLE_SIZE;
+    }
+
+    int predict_raw(uint64_t pc, int sharers, MESI_State state, int sharing = SHARING_UNCLASSIFIED) const
+    {
+        int vote = table0[get_hash0(pc, state)] + table1[get_hash1(pc, sharers)];
+        if (sharing != SHARING_UNCLASSIFIED)
+            vote += table2[get_hash2(pc, sharing)];
+        return vote;
+    }
+
+    void train(uint64_t pc, int sharers, MESI_State state, bool positive, int current_vote, int step = 1,
+               int sharing = SHARING_UNCLASSIFIED, int threshold = THRESHOLD)
+    {
+        // Dynamic Threshold Logic:
+        // Train if (1) Mispredicted OR (2) Low Confidence
+        bool mispredicted = (positive && current_vote <= 0) || (!positive && current_vote > 0);
+        bool low_confidence = std::abs(current_vote) <= threshold;
+
+        if (mispredicted || low_confidence)
+        {
+            int h0 = get_hash0(pc, state);
+            int h1 = get_hash1(pc, sharers);
+
+            int direction = positive ? step : -step;
+
+            // Update both tables (with saturation bounds)
+            table0[h0] = std::max(MIN_WEIGHT, std::min(MAX_WEIGHT, table0[h0] + direction));
+            table1[h1] = std::max(MIN_WEIGHT, std::min(MAX_WEIGHT, table1[h1] + direction));
+            if (sharing != SHARING_UNCLASSIFIED)
+            {
+                int h2 = get_hash2(pc, sharing);
+                table2[h2] = std::max(MIN_WEIGHT, std::min(MAX_WEIGHT, table2[h2] + direction));
+            }
+        }
+    }
+
+    uint64_t state_hash(uint64_t h) const { return hash_table(hash_table(hash_table(h, table0), table1), table2); }
+
+    void checkpoint(StateArchive &a) { a.io(table0, table1, table2); }
+
+    // Shrink every weight toward zero (rounding toward zero) - forget, but not all at once
+    void decay(int shift)
+    {
+        for (int i = 0; i < PERCEPTRON_TABLE_SIZE; i++)
+        {
+            table0[i] /= (1 << shift);
+            table1[i] /= (1 << shift);
+            table2[i] /= (1 << shift);
+        }
+    }
+
+    // Element-wise mean of several brains, written back into all of them.
+    // Lets independently trained copies (e.g. cache shards) share what they learned.
+    static void average(const std::vector<PerceptronBrain *> &brains)
+    {
+        if (brains.size() < 2)
+            return;
+        int n = (int)brains.size();
+        for (int i = 0; i < PERCEPTRON_TABLE_SIZE; i++)
+        {
+            int sum0 = 0, sum1 = 0, sum2 = 0;
+            for (PerceptronBrain *b : brains)
+            {
+                sum0 += b->table0[i];
+                sum1 += b->table1[i];
+                sum2 += b->table2[i];
+            }
+            for (PerceptronBrain *b : brains)
+            {
+                b->table0[i] = sum0 / n;
+                b->table1[i] = sum1 / n;
+                b->table2[i] = sum2 / n;
+            }
+        }
+    }
+};
+
+// ==========================================
+// ABSTRACT POLICY BASE
+// ==========================================
+class ReplacementPolicy
+{
+protected:
+    // Geometry of the cache this instance manages. Defaults to the simulated
+    // L3; the software cache library and scaled-down runs pass their own.
+    int num_sets;
+    int ways;
+    // Refetch cost per memory tier (CacheLine::tier); empty without a tiered backend
+    std::vector<int> tier_cost;
+
+public:
+    ReplacementPolicy(int sets = NUM_SETS, int assoc = WAYS) : num_sets(sets), ways(assoc) {}
+
+    virtual void update_on_hit(int set_idx, int way, const CacheLine &line) = 0;
+    virtual void update_on_miss(int set_idx, int way, uint64_t pc, uint64_t tag) = 0;
+    virtual int find_victim(int set_idx, const CacheLine *set, uint64_t pc, int sharers, MESI_State state) = 0;
+    // The way find_victim would pick for an incoming `tag`, changing nothing.
+    // An admission filter (TinyLFU) asks before deciding whether the policy
+    // sees the miss at all. -1 = can't tell without find_victim itself.
+    virtual int peek_victim(int set_idx, const CacheLine *set, uint64_t tag, uint64_t pc, int sharers,
+                            MESI_State state)
+    {
+        return -1;
+    }
+    virtual std::string name() = 0;
+    // Back to the state the constructor left, without reallocating, so a
+    // sweep can reuse one instance per configuration. Tier costs survive.
+    virtual void reset() = 0;
+    // Called on a miss, before find_victim, with the tag about to be installed.
+    // Only policies that keep ghost history by tag (ARC) need it.
+    virtual void on_miss(int set_idx, uint64_t tag) {}
+    // Called when a valid line is replaced, before the new line is installed
+    virtual void on_evict(int set_idx, int way, const CacheLine &victim) {}
+    // Core issuing the accesses that follow. Only called when it changes, and
+    // never for single-core runs.
+    virtual void set_core(int core) {}
+    // Extra lines printed under the policy's stats row
+    virtual void print_report(std::ostream &out) {}
+    // Confident the line will not be referenced again. Only dead-block
+    // predictors answer; the simulator's eager mode cleans such lines early.
+    virtual bool predict_dead(const CacheLine &line) { return false; }
+    // Fingerprint of the replacement state for steady-state detection
+    // (--extrapolate). Tags and tag-indexed history are left out: the long
+    // scenarios keep moving their addresses. 0 = not comparable.
+    virtual uint64_t state_hash() const { return 0; }
+    // Save or restore everything the policy learned (checkpoint.h). Geometry
+    // and tier costs come from the constructor and set_tier_costs.
+    virtual void checkpoint(StateArchive &a) { a.fail(name() + " cannot be checkpointed"); }
+    // Called once when a tiered memory backend is configured
+    virtual void set_tier_costs(const std::vector<int> &cost) { tier_cost = cost; }
+    // Taking over a warm cache (Simulator::switch_policy), once per set.
+    // Policies that find free ways by scanning set[w].valid need nothing;
+    // those that keep their own free lists (ARC, LIRS, CLOCK-Pro) must
+    // account for the lines already resident, or they evict them as empty.
+    virtual void adopt(int set_idx, const CacheLine *set) {}
+    virtual ~ReplacementPolicy() {}
+
+protected:
+    // Resident lines enter as if just installed, in way order
+    void adopt_as_installed(int set_idx, const CacheLine *set)
+    {
+        for (int w = 0; w < ways; w++)
+            if (set[w].valid)
+                update_on_miss(set_idx, w, set[w].pc, set[w].tag);
+    }
+};
+
+// ==========================================
+// POLICY 1: LRU (Baseline)
+// ==========================================
+class LRU_Policy : public ReplacementPolicy
+{
+    std::vector<int> stacks; // [set * ways + way] = recency position, 0 = MRU
+
+public:
+    LRU_Policy(int sets = NUM_SETS, int assoc = WAYS) : ReplacementPolicy(sets, assoc), stacks((size_t)sets * assoc)
+    {
+        LRU_Policy::reset();
+    }
+
+    void reset() override
+    {
+        for (size_t i = 0; i < stacks.size(); i++)
+            stacks[i] = (int)(i % ways);
+    }
+
+    uint64_t state_hash() const override { return hash_table(STATE_HASH_SEED, stacks); }
+
+    void checkpoint(StateArchive &a) override { a.io(stacks); }
+
+    void update_stack(int set_idx, int way)
+    {
+        int old_pos = stacks[set_idx * ways + way];
+        for (int w = 0; w < ways; w++)
+        {
+            if (stacks[set_idx * ways + w] < old_pos)
+                stacks[set_idx * ways + w]++;
+        }
+        stacks[set_idx * ways + way] = 0; // MRU
+    }
+
+    void update_on_hit(int set_idx, int way, const CacheLine &line) override { update_stack(set_idx, way); }
+    void update_on_miss(int set_idx, int way, uint64_t pc, uint64_t tag) override { update_stack(set_idx, way); }
+
+    int find_victim(int set_idx, const CacheLine *set, uint64_t pc, int sharers, MESI_State state) override
+    {
+        for (int w = 0; w < ways; w++)
+        {
+            if (!set[w].valid)
+                return w;
+            if (stacks[set_idx * ways + w] == ways - 1)
+                return w; // LRU position
+        }
+        return 0;
+    }
+
+    // find_victim only reads the stacks
+    int peek_victim(int set_idx, const CacheLine *set, uint64_t tag, uint64_t pc, int sharers,
+                    MESI_State state) override
+    {
+        return LRU_Policy::find_victim(set_idx, set, pc, sharers, state);
+    }
+    std::string name() override { return "LRU"; }
+};
+
+// ==========================================
+// POLICY 2: SRRIP (Baseline)
+// ==========================================
+class SRRIP_Policy : public ReplacementPolicy
+{
+protected:
+    std::vector<int> rrpv; // 2-bit, [set * ways + way]
+public:
+    SRRIP_Policy(int sets = NUM_SETS, int assoc = WAYS) : ReplacementPolicy(sets, assoc), rrpv((size_t)sets * assoc, 3)
+    {
+    }
+
+    void reset() override { std::fill(rrpv.begin(), rrpv.end(), 3); }
+    uint64_t state_hash() const override { return hash_table(STATE_HASH_SEED, rrpv); }
+
+    void checkpoint(StateArchive &a) override { a.io(rrpv); }
+
+    void update_on_hit(int set_idx, int way, const CacheLine &line) override
+    {
+        rrpv[set_idx * ways + way] = 0; // Promote to Immediate
+    }
+
+    void update_on_miss(int set_idx, int way, uint64_t pc, uint64_t tag) override
+    {
+        rrpv[set_idx * ways + way] = 2; // Insert at Long (Not Distant)
+    }
+
+    int find_victim(int set_idx, const CacheLine *set, uint64_t pc, int sharers, MESI_State state) override
+    {
+        while (true)
+        {
+            for (int w = 0; w < ways; w++)
+            {
+                if (!set[w].valid)
+                    return w;
+                if (rrpv[set_idx * ways + w] == 3)
+                    return w;
+            }
+            // Age all
+            for (int w = 0; w < ways; w++)
+            {
+                if (rrpv[set_idx * ways + w] < 3)
+                    rrpv[set_idx * ways + w]++;
+            }
+        }
+    }
+
+    // Aging reaches 3 first in the ways with the highest RRPV
+    int peek_victim(int set_idx, const CacheLine *set, uint64_t tag, uint64_t pc, int sharers,
+                    MESI_State state) override
+    {
+        int victim = 0;
+        for (int w = 0; w < ways; w++)
+        {
+            if (!set[w].valid || rrpv[set_idx * ways + w] == 3)
+                return w;
+            if (rrpv[set_idx * ways + w] > rrpv[set_idx * ways + victim])
+                victim = w;
+        }
+        return victim;
+    }
+    std::string name() override { return "SRRIP"; }
+};
+
+// ==========================================
+// POLICY 3: SHiP (PC-Aware Baseline)
+// ==========================================
+class SHiP_Policy : public SRRIP_Policy
+{
+    std::vector<int> shct; // Signature History Counter Table
+public:
+    SHiP_Policy(int sets = NUM_SETS, int assoc = WAYS) : SRRIP_Policy(sets, assoc)
+    {
+        shct.resize(SHCT_SIZE, 0);
+    }
+
+    void reset() override
+    {
+        SRRIP_Policy::reset();
+        std::fill(shct.begin(), shct.end(), 0);
+    }
+
+    uint64_t state_hash() const override { return hash_table(SRRIP_Policy::state_hash(), shct); }
+
+    void checkpoint(StateArchive &a) override
+    {
+        SRRIP_Policy::checkpoint(a);
+        a.io(shct);
+    }
+
+    int get_sig(uint64_t pc) { return pc % SHCT_SIZE; }
+
+    void update_on_hit(int set_idx, int way, const CacheLine &line) override
+    {
+        rrpv[set_idx * ways + way] = 0;
+        int sig = get_sig(line.pc);
+        if (shct[sig] > 0)
+            shct[sig]--;
+    }
+
+    void update_on_miss(int set_idx, int way, uint64_t pc, uint64_t tag) override
+    {
+        int sig = get_sig(pc);
+        if (shct[sig] >= 2)
+            rrpv[set_idx * ways + way] = 3;
+        else
+            rrpv[set_idx * ways + way] = 2;
+    }
+
+    int find_victim(int set_idx, const CacheLine *set, uint64_t pc, int sharers, MESI_State state) override
+    {
+        int victim = SRRIP_Policy::find_victim(set_idx, set, pc, sharers, state);
+        return victim;
+    }
+
+    std::string name() override { return "SHiP"; }
+};
+
+// ==========================================
+// POLICY 4: SDBP (Sampling Dead Block)
+// ==========================================
+class SDBP_Policy : public LRU_Policy
+{
+    std::vector<int> dead_table;
+public:
+    SDBP_Policy(int sets = NUM_SETS, int assoc = WAYS) : LRU_Policy(sets, assoc)
+    {
+        dead_table.resize(SHCT_SIZE, 0);
+    }
+
+    void reset() override
+    {
+        LRU_Policy::reset();
+        std::fill(dead_table.begin(), dead_table.end(), 0);
+    }
+
+    uint64_t state_hash() const override { return hash_table(LRU_Policy::state_hash(), dead_table); }
+
+    void checkpoint(StateArchive &a) override
+    {
+        LRU_Policy::checkpoint(a);
+        a.io(dead_table);
+    }
+
+    int get_hash(uint64_t pc) { return pc % SHCT_SIZE; }
+
+    void update_on_hit(int set_idx, int way, const CacheLine &line) override
+    {
+        LRU_Policy::update_on_hit(set_idx, way, line);
+        int h = get_hash(line.pc);
+        if (dead_table[h] > 0)
+            dead_table[h]--;
+    }
+
+    int find_victim(int set_idx, const CacheLine *set, uint64_t pc, int sharers, MESI_State state) override
+    {
+        // 1. Check for Dead Predictions
+        for (int w = 0; w < ways; w++)
+        {
+            if (!set[w].valid)
+                return w;
+            if (dead_table[get_hash(set[w].pc)] >= 2)
+            {
+                return w;
+            }
+        }
+        // 2. Fallback to LRU
+        return LRU_Policy::find_victim(set_idx, set, pc, sharers, state);
+    }
+
+    int peek_victim(int set_idx, const CacheLine *set, uint64_t tag, uint64_t pc, int sharers,
+                    MESI_State state) override
+    {
+        return SDBP_Policy::find_victim(set_idx, set, pc, sharers, state);
+    }
+
+    void on_evict(int set_idx, int way, const CacheLine &victim) override
+    {
+        int h = get_hash(victim.pc);
+        if (dead_table[h] < 3)
+            dead_table[h]++;
+    }
+
+    std::string name() override { return "SDBP (Sim)"; }
+};
+
+// ==========================================
+// POLICY 5: COALESCE (FIXED VERSION)
+// ==========================================
+class COALESCE_Policy : public ReplacementPolicy
+{
+    CoalesceParams params;
+    PerceptronBrain brain;
+    // Sampler state exists only for sampled sets: ghosts[set_idx / SAMPLING_MODULO]
+    std::vector<BloomFilter> ghosts;
+
+    // FIX: Increased sampling from 3% to 6.25% (1 in 16 instead of 1 in 32)
+    // More training opportunities = faster learning
+    static bool is_sampled(int set_idx) { return (unsigned)set_idx % SAMPLING_MODULO == 0; }
+    BloomFilter &ghost(int set_idx) { return ghosts[(unsigned)set_idx / SAMPLING_MODULO]; }
+
+    // Phase detector (see PHASE_* above)
+    uint64_t accesses = 0;
+    uint64_t epoch_misses = 0;
+    double phase_mean = 0; // Mean epoch miss rate since the last change
+    double cusum_up = 0, cusum_down = 0;
+    int phase_epochs = 0;
+    int boost_epochs = 0; // Epochs of boosted training left
+
+    std::vector<int> tier_scale;  // Per tier, percent added to positive votes (TIER_COST_WEIGHT)
+    std::vector<int> tier_credit; // Per line (set * ways + way), cycles, or TIER_CREDIT_REFILL
+
+    int train_step() const { return boost_epochs > 0 ? PHASE_BOOST_STEP : 1; }
+
+    void observe(bool miss)
+    {
+        epoch_misses += miss;
+        if (++accesses % PHASE_EPOCH != 0)
+            return;
+
+        double rate = (double)epoch_misses / PHASE_EPOCH;
+        epoch_misses = 0;
+        if (boost_epochs > 0)
+            boost_epochs--;
+        if (++phase_epochs > PHASE_WARMUP_EPOCHS)
+        {
+            cusum_up = std::max(0.0, cusum_up + rate - phase_mean - PHASE_CUSUM_SLACK);
+            cusum_down = std::max(0.0, cusum_down + phase_mean - rate - PHASE_CUSUM_SLACK);
+            if (cusum_up > PHASE_CUSUM_LIMIT || cusum_down > PHASE_CUSUM_LIMIT)
+            {
+                // New phase: forget half of what the old one taught, learn fast
+                phase_changes.push_back(accesses);
+                brain.decay(PHASE_DECAY_SHIFT);
+                boost_epochs = PHASE_BOOST_EPOCHS;
+                phase_epochs = 0;
+                phase_mean = cusum_up = cusum_down = 0;
+                return;
+            }
+        }
+        phase_mean += (rate - phase_mean) / phase_epochs;
+    }
+
+public:
+    std::vector<uint64_t> phase_changes; // Access count at each detected change
+
+    COALESCE_Policy(int sets = NUM_SETS, int assoc = WAYS, const CoalesceParams &knobs = CoalesceParams())
+        : ReplacementPolicy(sets, assoc), params(knobs), ghosts((sets + SAMPLING_MODULO - 1) / SAMPLING_MODULO)
+    {
+    }
+
+    // New knobs mid-run (--branches); what the brain learned so far stays
+    void set_params(const CoalesceParams &knobs) { params = knobs; }
+
+    void reset() override
+    {
+        brain.reset();
+        for (BloomFilter &g : ghosts)
+            g.clear();
+        accesses = epoch_misses = 0;
+        phase_mean = cusum_up = cusum_down = 0;
+        phase_epochs = boost_epochs = 0;
+        phase_changes.clear();
+        std::fill(tier_credit.begin(), tier_credit.end(), TIER_CREDIT_REFILL);
+    }
+
+    // Weights, the boost countdown and where we are in the phase epoch. The
+    // running miss-rate mean keeps converging without ever repeating, and the
+    // ghosts are indexed by tag, so neither is part of it.
+    uint64_t state_hash() const override
+    {
+        uint64_t h = hash_table(brain.state_hash(STATE_HASH_SEED), tier_credit);
+        return hash_value(hash_value(h, boost_epochs), accesses % PHASE_EPOCH);
+    }
+
+    void checkpoint(StateArchive &a) override
+    {
+        a.io(brain, ghosts, accesses, epoch_misses, phase_mean, cusum_up, cusum_down, phase_epochs, boost_epochs,
+             tier_credit, phase_changes);
+    }
+
+    void update_on_hit(int set_idx, int way, const CacheLine &line) override
+    {
+        // POSITIVE REINFORCEMENT: This line was useful!
+        // Train the perceptron that this (PC, Sharers, State) combination is GOOD
+        if (is_sampled(set_idx))
+        {
+            int vote = brain.predict_raw(line.pc, line.sharers, line.state, line.sharing);
+            brain.train(line.pc, line.sharers, line.state, true, vote, train_step(), line.sharing, params.threshold);
+        }
+        if (!tier_credit.empty())
+            tier_credit[set_idx * ways + way] = TIER_CREDIT_REFILL;
+        observe(false);
+    }
+
+    // void update_on_miss(int set_idx, int way, uint64_t pc, uint64_t tag) override
+    // {
+    //     // FIX: Ghost Buffer Check with CORRECT feature training
+    //     // If we previously evicted this line (it's in the ghost buffer),
+    //     // it means we made a MISTAKE - train positively with ACTUAL features
+    //     if (is_sampled[set_idx])
+    //     {
+    //         GhostEntry ghost;
+    //         if (ghosts[set_idx].lookup(tag, pc, ghost))
+    //         {
+    //             // CRITICAL FIX: Train with the ACTUAL evicted line's features
+    //             // Not hardcoded (0, EXCLUSIVE)!
+    //             int vote = brain.predict_raw(ghost.pc, ghost.sharers, ghost.state);
+                
+    //             // Strong positive reinforcement (5x) because this is a confirmed mistake
+    //             for(int k = 0; k < 5; k++) 
+    //             {
+    //                 brain.train(ghost.pc, ghost.sharers, ghost.state, true, vote);
+    //             }
+    //         }
+    //     }
+    // }
+    void update_on_miss(int set_idx, int way, uint64_t pc, uint64_t tag) override
+    {
+        // Ghost buffer check with UNPACKED features
+        if (is_sampled(set_idx))
+        {
+            int ghost_sharers;
+            MESI_State ghost_state;
+            
+            if (ghost(set_idx).lookup(tag, pc, ghost_sharers, ghost_state))
+            {
+                // Premature eviction detected! Train positively with ACTUAL features
+                int vote = brain.predict_raw(pc, ghost_sharers, ghost_state);
+                
+                // Strong reinforcement (5x) - this is confirmed ground truth.
+                // The ghost entry's 32 bits hold no sharing class, so the vote
+                // and training leave table2 out: it learns from hits only.
+                for(int k = 0; k < 5; k++) 
+                {
+                    brain.train(pc, ghost_sharers, ghost_state, true, vote, train_step(), SHARING_UNCLASSIFIED,
+                                params.threshold);
+                }
+            }
+        }
+        if (!tier_credit.empty())
+            tier_credit[set_idx * ways + way] = 0; // Nothing to protect until it is reused
+        observe(true);
+    }
+
+
+    // Refetch-cost credit of a line that has none yet: its tier's extra cost
+    int refill_credit(const CacheLine &line) const
+    {
+        return tier_cost[line.tier] - *std::min_element(tier_cost.begin(), tier_cost.end());
+    }
+
+    // The line with the lowest vote, and in `unprotected` the one that would
+    // have gone had refetch cost been ignored. Reads only, so TinyLFU can ask
+    // (peek_victim) before the policy is told about the miss.
+    int choose_victim(int set_idx, const CacheLine *set, int &unprotected) const
+    {
+        int victim = -1;
+        int min_vote = 999999;
+        unprotected = -1;
+        int min_unprotected = 999999;
+
+        for (int w = 0; w < ways; w++)
+        {
+            if (!set[w].valid)
+                return w;
+
+            // STEP 1: Get Raw Perceptron Prediction
+            // This is the learned "reuse likelihood" based on PC + Sharers + State
+            // (+ sharing pattern, when the trace carries one)
+            int raw_vote = brain.predict_raw(set[w].pc, set[w].sharers, set[w].state, set[w].sharing);
+            int final_vote = raw_vote;
+
+            // STEP 2: Apply Coherence Veto (Cost-Aware Bias)
+            // FIX: Changed from "sharers > 2" to "sharers >= 2"
+            // This protects lines with 2+ sharers (working sets in our benchmark)
+            // 
+            // VETO OVERRIDE: If raw_vote is extremely negative (< VETO_OVERRIDE),
+            // it means the perceptron is CONFIDENT this line is dead.
+            // In this case, we override the veto to allow eviction of dead-but-shared lines.
+            // This solves the "Streaming Modified Data" pathology.
+            if (raw_vote > params.veto_override && set[w].sharing != SHARING_UNCLASSIFIED)
+            {
+                final_vote += SHARING_VETO[set[w].sharing] * params.sharing_veto_percent / 100;
+            }
+            else if (raw_vote > params.veto_override)
+            {
+                // Apply cost-based protection
+                if (set[w].state == MODIFIED)
+                {
+                    // MODIFIED lines are expensive to evict (write-back to DRAM + invalidations)
+                    final_vote += params.veto_modified; // Increased from 100 for stronger protection
+                }
+                
+                if (set[w].sharers >= 2) // FIX: Was "sharers > 2"
+                {
+                    // Multi-sharer lines trigger coherence traffic on eviction
+                    final_vote += params.veto_sharers; // Increased from 50
+                }
+            }
+            // else: Perceptron is confident this is dead, ignore veto
+
+            // Refetch cost: reuse of a far-memory line is worth more
+            if (!tier_scale.empty())
+            {
+                if (final_vote < min_unprotected)
+                {
+                    min_unprotected = final_vote;
+                    unprotected = w;
+                }
+                int credit = tier_credit[set_idx * ways + w];
+                if (credit == TIER_CREDIT_REFILL)
+                    credit = refill_credit(set[w]);
+                if (raw_vote > params.threshold && credit > 0)
+                    final_vote += raw_vote * tier_scale[set[w].tier] / 100;
+            }
+
+            // Select minimum vote as victim
+            if (final_vote < min_vote)
+            {
+                min_vote = final_vote;
+                victim = w;
+            }
+        }
+        return victim;
+    }
+
+    int find_victim(int set_idx, const CacheLine *set, uint64_t pc, int sharers, MESI_State state) override
+    {
+        int unprotected;
+        int victim = choose_victim(set_idx, set, unprotected);
+        if (!tier_scale.empty())
+        {
+            // Every line looked at keeps the credit it was scored with
+            for (int w = 0; w < (set[victim].valid ? ways : victim); w++)
+                if (tier_credit[set_idx * ways + w] == TIER_CREDIT_REFILL)
+                    tier_credit[set_idx * ways + w] = refill_credit(set[w]);
+        }
+        if (!set[victim].valid)
+            return victim;
+
+        // The line that was kept instead pays for it
+        if (unprotected >= 0 && unprotected != victim)
+        {
+            int &credit = tier_credit[set_idx * ways + unprotected];
+            credit = std::max(0, credit - tier_cost[set[victim].tier]); // Spent stays spent until a hit
+        }
+
+        // STEP 3: Record Eviction in Ghost Buffer (with FULL features)
+        // FIX: Store complete feature vector, not just tag+PC
+        if (is_sampled(set_idx) && victim >= 0)
+        {
+            CacheLine v = set[victim];
+            ghost(set_idx).insert(v.tag, v.pc, v.sharers, v.state);
+
+            // FIX: DO NOT train negative immediately!
+            // We don't know if this line is dead until it's either:
+            // (a) Never accessed again (stays in ghost buffer forever)
+            // (b) Accessed again (ghost buffer hit triggers positive training)
+            //
+            // Training negative here creates the "premature punishment" death spiral.
+            // Let the ghost buffer handle all training - it has ground truth.
+        }
+
+        return victim;
+    }
+
+    int peek_victim(int set_idx, const CacheLine *set, uint64_t tag, uint64_t pc, int sharers,
+                    MESI_State state) override
+    {
+        int unprotected;
+        return choose_victim(set_idx, set, unprotected);
+    }
+
+    PerceptronBrain &perceptron() { return brain; }
+
+    void set_tier_costs(const std::vector<int> &cost) override
+    {
+        ReplacementPolicy::set_tier_costs(cost);
+        int cheapest = std::max(1, *std::min_element(cost.begin(), cost.end()));
+        tier_scale.clear();
+        for (int c : cost)
+            tier_scale.push_back((c - cheapest) * TIER_COST_WEIGHT / cheapest);
+        tier_credit.assign((size_t)num_sets * ways, TIER_CREDIT_REFILL);
+    }
+
+    // Training is positive-only (hits and ghost hits), so a non-positive vote
+    // means this line's features have never been seen to earn a reuse
+    bool predict_dead(const CacheLine &line) override
+    {
+        return brain.predict_raw(line.pc, line.sharers, line.state, line.sharing) <= 0;
+    }
+
+    void print_report(std::ostream &out) override
+    {
+        if (phase_changes.empty())
+            return;
+        out << "    phase changes: " << phase_changes.size() << " (weights >>" << PHASE_DECAY_SHIFT << ", step x"
+            << PHASE_BOOST_STEP << " for " << PHASE_BOOST_EPOCHS << " epochs), at access";
+        const size_t MAX_SHOWN = 8;
+        for (size_t i = 0; i < phase_changes.size() && i < MAX_SHOWN; i++)
+            out << " " << phase_changes[i];
+        if (phase_changes.size() > MAX_SHOWN)
+            out << " ...";
+        out << "\n";
+    }
+
+    std::string name() override { return "COALESCE-Fixed"; }
+};
+
+// ==========================================
+// PAGE-CACHE POLICIES: SHARED PLUMBING
+// ==========================================
+// ARC, LIRS and CLOCK-Pro are what buffer pools and OS page caches run.
+// They keep recency lists over resident blocks plus "ghost" (non-resident)
+// history by tag, the same idea as CompactGhostEntry, and every operation
+// has to be O(1) because page caches are close to fully associative.
+//
+// Each set owns a pool of nodes: node w < ways is the resident block in
+// way w, the rest are ghost slots holding only a tag. Lists are threaded
+// through the pool by index, so moving a block between lists never
+// allocates.
+const int LIRS_HIR_PERCENT = 1; // Resident HIR share of a set (LIRS paper default)
+
+struct NodeLists
+{
+    struct List
+    {
+        int head = -1; // MRU end
+        int tail = -1; // LRU end
+        int size = 0;
+    };
+
+    std::vector<int> prev, next;
+
+    void init(size_t nodes)
+    {
+        prev.assign(nodes, -1);
+        next.assign(nodes, -1);
+    }
+
+    void push_front(List &l, int n)
+    {
+        prev[n] = -1;
+        next[n] = l.head;
+        if (l.head >= 0)
+            prev[l.head] = n;
+        else
+            l.tail = n;
+        l.head = n;
+        l.size++;
+    }
+
+    void push_back(List &l, int n)
+    {
+        next[n] = -1;
+        prev[n] = l.tail;
+        if (l.tail >= 0)
+            next[l.tail] = n;
+        else
+            l.head = n;
+        l.tail = n;
+        l.size++;
+    }
+
+    // Inserts n just before pos (towards the head)
+    void insert_before(List &l, int pos, int n)
+    {
+        if (pos == l.head)
+        {
+            push_front(l, n);
+            return;
+        }
+        prev[n] = prev[pos];
+        next[n] = pos;
+        next[prev[pos]] = n;
+        prev[pos] = n;
+        l.size++;
+    }
+
+    void remove(List &l, int n)
+    {
+        if (prev[n] >= 0)
+            next[prev[n]] = next[n];
+        else
+            l.head = next[n];
+        if (next[n] >= 0)
+            prev[next[n]] = prev[n];
+        else
+            l.tail = prev[n];
+        prev[n] = next[n] = -1;
+        l.size--;
+    }
+
+    void checkpoint(StateArchive &a) { a.io(prev, next); }
+
+    // Circular successor, for clock hands
+    int cyclic_next(const List &l, int n) const { return next[n] >= 0 ? next[n] : l.head; }
+};
+
+// ==========================================
+// POLICY 6: ARC (Adaptive Replacement Cache)
+// ==========================================
+// T1 = seen once recently, T2 = seen at least twice; B1/B2 are their ghost
+// lists. A hit in B1 means T1 was too small and grows the target p, a hit
+// in B2 shrinks it. Megiddo & Modha, FAST'03, applied per set.
+class ARC_Policy : public ReplacementPolicy
+{
+    enum Where : uint8_t { FREE, T1, T2, B1, B2, GHOST_FREE };
+    static constexpr int NUM_LISTS = 6;
+
+    int nodes_per_set;
+    NodeLists links;
+    std::vector<NodeLists::List> lists; // [set * NUM_LISTS + Where]
+    std::vector<uint8_t> where;         // [node]
+    std::vector<uint64_t> ghost_tag;    // [node], ghost slots only
+    std::vector<std::unordered_map<uint64_t, int>> ghost_index;
+    std::vector<int> target_t1; // p
+    std::vector<uint64_t> incoming; // Tag announced by on_miss
+
+    NodeLists::List &list(int set_idx, Where w) { return lists[set_idx * NUM_LISTS + w]; }
+    int node(int set_idx, int i) const { return set_idx * nodes_per_set + i; }
+
+    void move(int set_idx, int n, Where to, bool mru = true)
+    {
+        links.remove(list(set_idx, (Where)where[n]), n);
+        if (mru)
+            links.push_front(list(set_idx, to), n);
+        else
+            links.push_back(list(set_idx, to), n);
+        where[n] = to;
+    }
+
+    void drop_ghost(int set_idx, int g)
+    {
+        ghost_index[set_idx].erase(ghost_tag[g]);
+        move(set_idx, g, GHOST_FREE);
+    }
+
+    // p after the adaptation ARC applies when `tag` misses
+    int adapted_target(int set_idx, uint64_t tag) const
+    {
+        auto it = ghost_index[set_idx].find(tag);
+        int p = target_t1[set_idx];
+        if (it == ghost_index[set_idx].end())
+            return p;
+        const NodeLists::List &b1 = lists[set_idx * NUM_LISTS + B1];
+        const NodeLists::List &b2 = lists[set_idx * NUM_LISTS + B2];
+        if (where[it->second] == B1)
+            return std::min(ways, p + std::max(1, b2.size / std::max(1, b1.size)));
+        return std::max(0, p - std::max(1, b1.size / std::max(1, b2.size)));
+    }
+
+public:
+    ARC_Policy(int sets = NUM_SETS, int assoc = WAYS)
+        : ReplacementPolicy(sets, assoc), nodes_per_set(2 * assoc), lists((size_t)sets * NUM_LISTS),
+          where((size_t)sets * 2 * assoc), ghost_tag((size_t)sets * 2 * assoc), ghost_index(sets),
+          target_t1(sets, 0), incoming(sets, 0)
+    {
+        ARC_Policy::reset();
+    }
+
+    void reset() override
+    {
+        links.init((size_t)num_sets * nodes_per_set);
+        std::fill(lists.begin(), lists.end(), NodeLists::List());
+        std::fill(ghost_tag.begin(), ghost_tag.end(), 0);
+        for (auto &index : ghost_index)
+            index.clear();
+        std::fill(target_t1.begin(), target_t1.end(), 0);
+        std::fill(incoming.begin(), incoming.end(), 0);
+        for (int s = 0; s < num_sets; s++)
+        {
+            for (int i = 0; i < ways; i++)
+            {
+                links.push_back(list(s, FREE), node(s, i));
+                where[node(s, i)] = FREE;
+                links.push_back(list(s, GHOST_FREE), node(s, ways + i));
+                where[node(s, ways + i)] = GHOST_FREE;
+            }
+        }
+    }
+
+    void on_miss(int set_idx, uint64_t tag) override { incoming[set_idx] = tag; }
+
+    void update_on_hit(int set_idx, int way, const CacheLine &line) override
+    {
+        move(set_idx, node(set_idx, way), T2);
+    }
+
+    // A free way, or REPLACE(x, p) for the incoming `tag`
+    int choose_victim(int set_idx, uint64_t tag) const
+    {
+        const NodeLists::List &free = lists[set_idx * NUM_LISTS + FREE];
+        if (free.size > 0)
+            return free.head - set_idx * nodes_per_set;
+
+        const NodeLists::List &t1 = lists[set_idx * NUM_LISTS + T1];
+        const NodeLists::List &t2 = lists[set_idx * NUM_LISTS + T2];
+        auto g = ghost_index[set_idx].find(tag);
+        bool in_b2 = g != ghost_index[set_idx].end() && where[g->second] == B2;
+        int p = adapted_target(set_idx, tag);
+
+        if (t1.size > 0 && (t1.size > p || (in_b2 && t1.size == p) || t2.size == 0))
+            return t1.tail - set_idx * nodes_per_set;
+        return t2.tail - set_idx * nodes_per_set;
+    }
+
+    int find_victim(int set_idx, const CacheLine *set, uint64_t pc, int sharers, MESI_State state) override
+    {
+        return choose_victim(set_idx, incoming[set_idx]);
+    }
+
+    int peek_victim(int set_idx, const CacheLine *set, uint64_t tag, uint64_t pc, int sharers,
+                    MESI_State state) override
+    {
+        return choose_victim(set_idx, tag);
+    }
+
+    void on_evict(int set_idx, int way, const CacheLine &victim) override
+    {
+        int n = node(set_idx, way);
+        NodeLists::List &t1 = list(set_idx, T1);
+        NodeLists::List &b1 = list(set_idx, B1);
+        NodeLists::List &b2 = list(set_idx, B2);
+        bool ghost_hit = ghost_index[set_idx].count(incoming[set_idx]) != 0;
+
+        if (!ghost_hit)
+        {
+            if (t1.size + b1.size >= ways)
+            {
+                if (t1.size < ways && b1.size > 0)
+                    drop_ghost(set_idx, b1.tail);
+                else
+                {
+                    // L1 is all resident: the T1 block leaves without a ghost
+                    move(set_idx, n, FREE);
+                    return;
+                }
+            }
+            else if (t1.size + list(set_idx, T2).size + b1.size + b2.size >= 2 * ways && b2.size > 0)
+                drop_ghost(set_idx, b2.tail);
+        }
+
+        NodeLists::List &spare = list(set_idx, GHOST_FREE);
+        if (spare.size == 0)
+            drop_ghost(set_idx, b2.size > 0 ? b2.tail : b1.tail);
+        int g = spare.head;
+        ghost_tag[g] = victim.tag;
+        ghost_index[set_idx][victim.tag] = g;
+        move(set_idx, g, where[n] == T1 ? B1 : B2);
+        move(set_idx, n, FREE);
+    }
+
+    void update_on_miss(int set_idx, int way, uint64_t pc, uint64_t tag) override
+    {
+        int n = node(set_idx, way);
+        auto it = ghost_index[set_idx].find(tag);
+        if (it == ghost_index[set_idx].end())
+        {
+            move(set_idx, n, T1);
+            return;
+        }
+        target_t1[set_idx] = adapted_target(set_idx, tag);
+        drop_ghost(set_idx, it->second);
+        move(set_idx, n, T2);
+    }
+
+    void checkpoint(StateArchive &a) override { a.io(links, lists, where, ghost_tag, ghost_index, target_t1, incoming); }
+
+    void adopt(int set_idx, const CacheLine *set) override { adopt_as_installed(set_idx, set); }
+
+    std::string name() override { return "ARC"; }
+};
+
+// ==========================================
+// POLICY 7: LIRS (Low Inter-reference Recency Set)
+// ==========================================
+// Blocks are ranked by reuse distance rather than recency. LIR blocks (short
+// reuse distance) hold ~99% of a set; the rest is a FIFO of resident HIR
+// blocks, the only eviction candidates. Stack S keeps recency for LIR,
+// resident HIR and ghost HIR blocks; a HIR block re-referenced while still
+// in S has proven a short reuse distance and is promoted. Jiang & Zhang,
+// SIGMETRICS'02, applied per set.
+class LIRS_Policy : public ReplacementPolicy
+{
+    enum Status : uint8_t { NODE_FREE, LIR, HIR_RESIDENT, HIR_GHOST };
+
+    int nodes_per_set;
+    int lir_capacity;
+    NodeLists stack_links; // S
+    NodeLists queue_links; // Q for resident HIR, ghost age order for HIR_GHOST
+    std::vector<NodeLists::List> stack, queue, ghosts;
+    std::vector<std::vector<int>> free_ways, free_ghosts;
+    std::vector<uint8_t> status;
+    std::vector<bool> in_stack;
+    std::vector<uint64_t> ghost_tag;
+    std::vector<std::unordered_map<uint64_t, int>> ghost_index;
+    std::vector<int> lir_count;
+
+    int node(int set_idx, int i) const { return set_idx * nodes_per_set + i; }
+
+    void stack_remove(int set_idx, int n)
+    {
+        if (in_stack[n])
+            stack_links.remove(stack[set_idx], n);
+        in_stack[n] = false;
+    }
+
+    void stack_push(int set_idx, int n)
+    {
+        stack_remove(set_idx, n);
+        stack_links.push_front(stack[set_idx], n);
+        in_stack[n] = true;
+    }
+
+    void release_ghost(int set_idx, int g)
+    {
+        stack_remove(set_idx, g);
+        queue_links.remove(ghosts[set_idx], g);
+        ghost_index[set_idx].erase(ghost_tag[g]);
+        status[g] = NODE_FREE;
+        free_ghosts[set_idx].push_back(g);
+    }
+
+    // Stack bottom must be a LIR block
+    void prune(int set_idx)
+    {
+        NodeLists::List &s = stack[set_idx];
+        while (s.tail >= 0 && status[s.tail] != LIR)
+        {
+            int n = s.tail;
+            if (status[n] == HIR_GHOST)
+                release_ghost(set_idx, n);
+            else
+                stack_remove(set_idx, n);
+        }
+    }
+
+    // Bottom LIR block becomes resident HIR at the tail of Q
+    void demote_bottom(int set_idx)
+    {
+        int n = stack[set_idx].tail;
+        if (n < 0)
+            return;
+        stack_remove(set_idx, n);
+        status[n] = HIR_RESIDENT;
+        lir_count[set_idx]--;
+        queue_links.push_back(queue[set_idx], n);
+        prune(set_idx);
+    }
+
+    // Takes way node n for a new block. Usually it is on the free list; a way
+    // the owner invalidated behind our back (coalesce::Cache::erase) is
+    // still linked in and gets dropped without leaving a ghost.
+    void claim(int set_idx, int n)
+    {
+        if (status[n] == NODE_FREE)
+        {
+            std::vector<int> &fw = free_ways[set_idx];
+            fw.erase(std::find(fw.rbegin(), fw.rend(), n).base() - 1); // Almost always the back
+            return;
+        }
+        if (status[n] == LIR)
+            lir_count[set_idx]--;
+        else
+            queue_links.remove(queue[set_idx], n);
+        stack_remove(set_idx, n);
+        prune(set_idx);
+    }
+
+public:
+    LIRS_Policy(int sets = NUM_SETS, int assoc = WAYS)
+        : ReplacementPolicy(sets, assoc), nodes_per_set(2 * assoc),
+          lir_capacity(std::max(1, assoc - std::max(1, assoc * LIRS_HIR_PERCENT / 100))), stack(sets),
+          queue(sets), ghosts(sets), free_ways(sets), free_ghosts(sets), status((size_t)sets * 2 * assoc, NODE_FREE),
+          in_stack((size_t)sets * 2 * assoc, false), ghost_tag((size_t)sets * 2 * assoc), ghost_index(sets),
+          lir_count(sets, 0)
+    {
+        LIRS_Policy::reset();
+    }
+
+    void reset() override
+    {
+        stack_links.init((size_t)num_sets * nodes_per_set);
+        queue_links.init((size_t)num_sets * nodes_per_set);
+        for (auto *lists : {&stack, &queue, &ghosts})
+            std::fill(lists->begin(), lists->end(), NodeLists::List());
+        std::fill(status.begin(), status.end(), NODE_FREE);
+        std::fill(in_stack.begin(), in_stack.end(), false);
+        std::fill(ghost_tag.begin(), ghost_tag.end(), 0);
+        std::fill(lir_count.begin(), lir_count.end(), 0);
+        for (int s = 0; s < num_sets; s++)
+        {
+            ghost_index[s].clear();
+            free_ways[s].clear();
+            free_ghosts[s].clear();
+            for (int i = ways - 1; i >= 0; i--)
+            {
+                free_ways[s].push_back(node(s, i));
+                free_ghosts[s].push_back(node(s, ways + i));
+            }
+        }
+    }
+
+    void update_on_hit(int set_idx, int way, const CacheLine &line) override
+    {
+        int n = node(set_idx, way);
+        if (status[n] == LIR)
+        {
+            bool was_bottom = stack[set_idx].tail == n;
+            stack_push(set_idx, n);
+            if (was_bottom)
+                prune(set_idx);
+            return;
+        }
+
+        // Resident HIR
+        if (in_stack[n])
+        {
+            queue_links.remove(queue[set_idx], n);
+            status[n] = LIR;
+            lir_count[set_idx]++;
+            stack_push(set_idx, n);
+            if (lir_count[set_idx] > lir_capacity)
+                demote_bottom(set_idx);
+        }
+        else
+        {
+            stack_push(set_idx, n);
+            queue_links.remove(queue[set_idx], n);
+            queue_links.push_back(queue[set_idx], n);
+        }
+    }
+
+    int find_victim(int set_idx, const CacheLine *set, uint64_t pc, int sharers, MESI_State state) override
+    {
+        if (!free_ways[set_idx].empty())
+            return free_ways[set_idx].back() - set_idx * nodes_per_set;
+        int n = queue[set_idx].head >= 0 ? queue[set_idx].head : stack[set_idx].tail;
+        return n - set_idx * nodes_per_set;
+    }
+
+    // find_victim only reads the free list and Q
+    int peek_victim(int set_idx, const CacheLine *set, uint64_t tag, uint64_t pc, int sharers,
+                    MESI_State state) override
+    {
+        return LIRS_Policy::find_victim(set_idx, set, pc, sharers, state);
+    }
+
+    void on_evict(int set_idx, int way, const CacheLine &victim) override
+    {
+        int n = node(set_idx, way);
+        if (status[n] == LIR)
+        {
+            // Only reachable when Q is empty (LIR capacity == ways)
+            stack_remove(set_idx, n);
+            lir_count[set_idx]--;
+            prune(set_idx);
+        }
+        else
+        {
+            queue_links.remove(queue[set_idx], n);
+            if (in_stack[n])
+            {
+                // Keep its place in S as a ghost so a quick return is recognised
+                if (free_ghosts[set_idx].empty())
+                    release_ghost(set_idx, ghosts[set_idx].head);
+                int g = free_ghosts[set_idx].back();
+                free_ghosts[set_idx].pop_back();
+                stack_links.insert_before(stack[set_idx], n, g);
+                in_stack[g] = true;
+                status[g] = HIR_GHOST;
+                ghost_tag[g] = victim.tag;
+                ghost_index[set_idx][victim.tag] = g;
+                queue_links.push_back(ghosts[set_idx], g);
+                stack_remove(set_idx, n);
+            }
+        }
+        status[n] = NODE_FREE;
+        free_ways[set_idx].push_back(n);
+    }
+
+    void update_on_miss(int set_idx, int way, uint64_t pc, uint64_t tag) override
+    {
+        int n = node(set_idx, way);
+        claim(set_idx, n);
+
+        auto it = ghost_index[set_idx].find(tag);
+        if (it != ghost_index[set_idx].end())
+        {
+            // Returned while still in S: short reuse distance, straight to LIR
+            release_ghost(set_idx, it->second);
+            status[n] = LIR;
+            lir_count[set_idx]++;
+            stack_push(set_idx, n);
+            if (lir_count[set_idx] > lir_capacity)
+                demote_bottom(set_idx);
+        }
+        else if (lir_count[set_idx] < lir_capacity)
+        {
+            status[n] = LIR;
+            lir_count[set_idx]++;
+            stack_push(set_idx, n);
+        }
+        else
+        {
+            status[n] = HIR_RESIDENT;
+            stack_push(set_idx, n);
+            queue_links.push_back(queue[set_idx], n);
+        }
+    }
+
+    void checkpoint(StateArchive &a) override
+    {
+        a.io(stack_links, queue_links, stack, queue, ghosts, free_ways, free_ghosts, status, in_stack, ghost_tag,
+             ghost_index, lir_count);
+    }
+
+    void adopt(int set_idx, const CacheLine *set) override { adopt_as_installed(set_idx, set); }
+
+    std::string name() override { return "LIRS"; }
+};
+
+// ==========================================
+// POLICY 8: CLOCK-Pro
+// ==========================================
+// LIRS approximated with clock hands, the form Linux and NetBSD
+// experimented with. One circular list holds hot, cold-resident and
+// cold-ghost blocks. hand_cold looks for an unreferenced cold block to
+// evict, hand_hot demotes unreferenced hot blocks and ends stale test
+// periods, hand_test bounds the ghosts. The cold share mc adapts: a ghost
+// hit grows it, a test period that expires unused shrinks it.
+// Jiang, Chen & Zhang, USENIX ATC'05, applied per set.
+class CLOCKPro_Policy : public ReplacementPolicy
+{
+    int nodes_per_set;
+    NodeLists links;
+    std::vector<NodeLists::List> clock;
+    std::vector<int> hand_hot, hand_cold, hand_test;
+    std::vector<std::vector<int>> free_ways, free_ghosts;
+    std::vector<uint8_t> hot, referenced, in_test, resident, linked;
+    std::vector<uint64_t> ghost_tag;
+    std::vector<std::unordered_map<uint64_t, int>> ghost_index;
+    std::vector<int> hot_count, cold_target;
+
+    int node(int set_idx, int i) const { return set_idx * nodes_per_set + i; }
+
+    // Newest position is just behind hand_hot, which points at the oldest block
+    void insert_head(int set_idx, int n)
+    {
+        NodeLists::List &l = clock[set_idx];
+        if (l.size == 0)
+        {
+            links.push_back(l, n);
+            hand_hot[set_idx] = hand_cold[set_idx] = hand_test[set_idx] = n;
+        }
+        else
+            links.insert_before(l, hand_hot[set_idx], n);
+        linked[n] = 1;
+    }
+
+    void unlink(int set_idx, int n)
+    {
+        NodeLists::List &l = clock[set_idx];
+        int succ = l.size > 1 ? links.cyclic_next(l, n) : -1;
+        for (std::vector<int> *hand : {&hand_hot, &hand_cold, &hand_test})
+            if ((*hand)[set_idx] == n)
+                (*hand)[set_idx] = succ;
+        links.remove(l, n);
+        linked[n] = 0;
+    }
+
+    void release_ghost(int set_idx, int g)
+    {
+        unlink(set_idx, g);
+        ghost_index[set_idx].erase(ghost_tag[g]);
+        free_ghosts[set_idx].push_back(g);
+    }
+
+    void advance(std::vector<int> &hand, int set_idx)
+    {
+        hand[set_idx] = links.cyclic_next(clock[set_idx], hand[set_idx]);
+    }
+
+    // A test period ran out without a re-reference: cold blocks get less room
+    void end_test(int set_idx, int n)
+    {
+        in_test[n] = 0;
+        cold_target[set_idx] = std::max(1, cold_target[set_idx] - 1);
+    }
+
+    void run_hand_hot(int set_idx)
+    {
+        for (int guard = 2 * clock[set_idx].size + 2; guard > 0 && hot_count[set_idx] > 0; guard--)
+        {
+            int n = hand_hot[set_idx];
+            if (hot[n])
+            {
+                advance(hand_hot, set_idx);
+                if (referenced[n])
+                    referenced[n] = 0;
+                else
+                {
+                    hot[n] = 0;
+                    hot_count[set_idx]--;
+                    return;
+                }
+            }
+            else if (in_test[n])
+            {
+                end_test(set_idx, n);
+                if (!resident[n])
+                    release_ghost(set_idx, n); // Moves the hand on
+                else
+                    advance(hand_hot, set_idx);
+            }
+            else
+                advance(hand_hot, set_idx);
+        }
+    }
+
+    void run_hand_test(int set_idx)
+    {
+        for (int guard = clock[set_idx].size + 1; guard > 0; guard--)
+        {
+            int n = hand_test[set_idx];
+            if (!hot[n] && in_test[n])
+            {
+                end_test(set_idx, n);
+                if (!resident[n])
+                {
+                    release_ghost(set_idx, n);
+                    return;
+                }
+            }
+            advance(hand_test, set_idx);
+        }
+    }
+
+    void rebalance(int set_idx)
+    {
+        while (hot_count[set_idx] > ways - cold_target[set_idx])
+        {
+            int before = hot_count[set_idx];
+            run_hand_hot(set_idx);
+            if (hot_count[set_idx] == before)
+                break;
+        }
+    }
+
+    // Same contract as LIRS_Policy::claim
+    void claim(int set_idx, int n)
+    {
+        if (!resident[n])
+        {
+            std::vector<int> &fw = free_ways[set_idx];
+            fw.erase(std::find(fw.rbegin(), fw.rend(), n).base() - 1);
+            return;
+        }
+        if (hot[n])
+            hot_count[set_idx]--;
+        unlink(set_idx, n);
+    }
+
+public:
+    CLOCKPro_Policy(int sets = NUM_SETS, int assoc = WAYS)
+        : ReplacementPolicy(sets, assoc), nodes_per_set(2 * assoc), clock(sets), hand_hot(sets, -1),
+          hand_cold(sets, -1), hand_test(sets, -1), free_ways(sets), free_ghosts(sets),
+          hot((size_t)sets * 2 * assoc, 0), referenced((size_t)sets * 2 * assoc, 0),
+          in_test((size_t)sets * 2 * assoc, 0), resident((size_t)sets * 2 * assoc, 0),
+          linked((size_t)sets * 2 * assoc, 0), ghost_tag((size_t)sets * 2 * assoc), ghost_index(sets),
+          hot_count(sets, 0), cold_target(sets, std::max(1, assoc / 2))
+    {
+        CLOCKPro_Policy::reset();
+    }
+
+    void reset() override
+    {
+        links.init((size_t)num_sets * nodes_per_set);
+        std::fill(clock.begin(), clock.end(), NodeLists::List());
+        for (std::vector<int> *hand : {&hand_hot, &hand_cold, &hand_test})
+            std::fill(hand->begin(), hand->end(), -1);
+        for (std::vector<uint8_t> *flags : {&hot, &referenced, &in_test, &resident, &linked})
+            std::fill(flags->begin(), flags->end(), 0);
+        std::fill(ghost_tag.begin(), ghost_tag.end(), 0);
+        std::fill(hot_count.begin(), hot_count.end(), 0);
+        std::fill(cold_target.begin(), cold_target.end(), std::max(1, ways / 2));
+        for (int s = 0; s < num_sets; s++)
+        {
+            ghost_index[s].clear();
+            free_ways[s].clear();
+            free_ghosts[s].clear();
+            for (int i = ways - 1; i >= 0; i--)
+            {
+                free_ways[s].push_back(node(s, i));
+                free_ghosts[s].push_back(node(s, ways + i));
+            }
+        }
+    }
+
+    void update_on_hit(int set_idx, int way, const CacheLine &line) override
+    {
+        referenced[node(set_idx, way)] = 1;
+    }
+
+    int find_victim(int set_idx, const CacheLine *set, uint64_t pc, int sharers, MESI_State state) override
+    {
+        if (!free_ways[set_idx].empty())
+            return free_ways[set_idx].back() - set_idx * nodes_per_set;
+
+        for (int guard = 4 * clock[set_idx].size + 4; guard > 0; guard--)
+        {
+            int n = hand_cold[set_idx];
+            if (hot[n] || !resident[n])
+            {
+                advance(hand_cold, set_idx);
+                continue;
+            }
+            if (!referenced[n])
+                return n - set_idx * nodes_per_set;
+
+            referenced[n] = 0;
+            if (in_test[n])
+            {
+                // Re-referenced within its test period: reuse distance beats the coldest hot block
+                in_test[n] = 0;
+                hot[n] = 1;
+                hot_count[set_idx]++;
+                advance(hand_cold, set_idx);
+                rebalance(set_idx);
+            }
+            else
+            {
+                // Start a new test period at the list head
+                in_test[n] = 1;
+                advance(hand_cold, set_idx);
+                if (clock[set_idx].size > 1)
+                {
+                    unlink(set_idx, n);
+                    insert_head(set_idx, n);
+                }
+            }
+        }
+        // Everything resident is hot: demote one and take it
+        run_hand_hot(set_idx);
+        hand_cold[set_idx] = hand_hot[set_idx];
+        for (int n = clock[set_idx].head; n >= 0; n = links.next[n])
+            if (resident[n] && !hot[n])
+                return n - set_idx * nodes_per_set;
+        return 0;
+    }
+
+    // First unreferenced cold block from hand_cold: find_victim skips the
+    // referenced ones on the way (they start a test period or turn hot).
+    // A demotion while it rebalances can hand it a nearer block; that rare
+    // case, and a set with no such block, are left to find_victim (-1).
+    int peek_victim(int set_idx, const CacheLine *set, uint64_t tag, uint64_t pc, int sharers,
+                    MESI_State state) override
+    {
+        if (!free_ways[set_idx].empty())
+            return free_ways[set_idx].back() - set_idx * nodes_per_set;
+        int n = hand_cold[set_idx];
+        for (int i = 0; n >= 0 && i < clock[set_idx].size; i++, n = links.cyclic_next(clock[set_idx], n))
+            if (resident[n] && !hot[n] && !referenced[n])
+                return n - set_idx * nodes_per_set;
+        return -1;
+    }
+
+    void on_evict(int set_idx, int way, const CacheLine &victim) override
+    {
+        int n = node(set_idx, way);
+        if (hot[n])
+        {
+            hot[n] = 0;
+            hot_count[set_idx]--;
+        }
+        if (in_test[n] && linked[n])
+        {
+            // Stays in the clock as a ghost until its test period ends
+            if (free_ghosts[set_idx].empty())
+                run_hand_test(set_idx);
+            if (!free_ghosts[set_idx].empty())
+            {
+                int g = free_ghosts[set_idx].back();
+                free_ghosts[set_idx].pop_back();
+                links.insert_before(clock[set_idx], n, g);
+                linked[g] = 1;
+                hot[g] = referenced[g] = resident[g] = 0;
+                in_test[g] = 1;
+                ghost_tag[g] = victim.tag;
+                ghost_index[set_idx][victim.tag] = g;
+                for (std::vector<int> *hand : {&hand_hot, &hand_test})
+                    if ((*hand)[set_idx] == n)
+                        (*hand)[set_idx] = g;
+            }
+        }
+        if (linked[n])
+            unlink(set_idx, n);
+        resident[n] = referenced[n] = in_test[n] = 0;
+        free_ways[set_idx].push_back(n);
+    }
+
+    void update_on_miss(int set_idx, int way, uint64_t pc, uint64_t tag) override
+    {
+        int n = node(set_idx, way);
+        claim(set_idx, n);
+        resident[n] = 1;
+        referenced[n] = 0;
+
+        auto it = ghost_index[set_idx].find(tag);
+        if (it != ghost_index[set_idx].end())
+        {
+            // Ghost hit: the cold area was too small
+            release_ghost(set_idx, it->second);
+            cold_target[set_idx] = std::min(std::max(1, ways - 1), cold_target[set_idx] + 1);
+            hot[n] = 1;
+            in_test[n] = 0;
+            hot_count[set_idx]++;
+            insert_head(set_idx, n);
+            rebalance(set_idx);
+        }
+        else if (hot_count[set_idx] < ways - cold_target[set_idx])
+        {
+            hot[n] = 1; // Filling up: the first blocks seed the hot area
+            in_test[n] = 0;
+            hot_count[set_idx]++;
+            insert_head(set_idx, n);
+        }
+        else
+        {
+            hot[n] = 0;
+            in_test[n] = 1;
+            insert_head(set_idx, n);
+        }
+    }
+
+    void checkpoint(StateArchive &a) override
+    {
+        a.io(links, clock, hand_hot, hand_cold, hand_test, free_ways, free_ghosts, hot, referenced, in_test, resident,
+             linked, ghost_tag, ghost_index, hot_count, cold_target);
+    }
+
+    void adopt(int set_idx, const CacheLine *set) override { adopt_as_installed(set_idx, set); }
+
+    std::string name() override { return "CLOCK-Pro"; }
+};
+
+// ==========================================
+// TINYLFU ADMISSION (W-TinyLFU)
+// ==========================================
+// Frequency-based admission in front of any ReplacementPolicy. New lines
+// land in a small LRU window first; when the window overflows, its LRU
+// line ("candidate") competes with the policy's victim in the main cache
+// and only gets in if it has been seen more often. One-shot scans never
+// build frequency, so they die in the window instead of flushing the
+// working set.
+//
+//   FrequencySketch - count-min, 4-bit counters packed 16 per word,
+//                     all counters halved every sample_size increments
+//                     so old popularity fades
+//   doorkeeper      - BloomFilter that absorbs the first occurrence of a
+//                     key, so one-hit wonders never touch the sketch
+const int TINYLFU_WINDOW_PERCENT = 1;  // Window = 1% of capacity (W-TinyLFU default)
+const int TINYLFU_SAMPLE_FACTOR = 10;  // Halve counters every 10 x capacity increments
+const int TINYLFU_DOORKEEPER_BITS = 8; // Doorkeeper bits per cached entry
+
+class FrequencySketch
+{
+    static constexpr int DEPTH = 4;
+    std::vector<uint64_t> table; // DEPTH rows of `width` 4-bit counters
+    uint64_t width_mask;
+    uint64_t additions = 0;
+    uint64_t sample_size;
+
+    static uint64_t mix(uint64_t x, int d)
+    {
+        x += 0x9e3779b97f4a7c15ULL * (d + 1);
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+        return x ^ (x >> 31);
+    }
+
+    int get(uint64_t counter) const { return (table[counter >> 4] >> ((counter & 15) * 4)) & 0xF; }
+
+public:
+    uint64_t resets = 0;
+
+    explicit FrequencySketch(size_t capacity)
+    {
+        uint64_t width = 16;
+        while (width < capacity)
+            width <<= 1;
+        width_mask = width - 1;
+        table.assign(DEPTH * width / 16, 0);
+        sample_size = std::max<uint64_t>(16, TINYLFU_SAMPLE_FACTOR * capacity);
+    }
+
+    void reset()
+    {
+        std::fill(table.begin(), table.end(), 0);
+        additions = resets = 0;
+    }
+
+    // Returns true when the increment triggered a halving (aging) pass
+    bool increment(uint64_t key)
+    {
+        for (int d = 0; d < DEPTH; d++)
+        {
+            uint64_t counter = d * (width_mask + 1) + (mix(key, d) & width_mask);
+            if (get(counter) < 15)
+                table[counter >> 4] += 1ULL << ((counter & 15) * 4);
+        }
+        if (++additions < sample_size)
+            return false;
+
+        for (uint64_t &word : table)
+            word = (word >> 1) & 0x7777777777777777ULL;
+        additions /= 2;
+        resets++;
+        return true;
+    }
+
+    void checkpoint(StateArchive &a) { a.io(table, additions, resets); }
+
+    int estimate(uint64_t key) const
+    {
+        int est = 15;
+        for (int d = 0; d < DEPTH; d++)
+            est = std::min(est, get(d * (width_mask + 1) + (mix(key, d) & width_mask)));
+        return est;
+    }
+};
+
+class TinyLFU
+{
+    FrequencySketch sketch;
+    BloomFilter doorkeeper;
+
+public:
+    uint64_t admitted = 0;
+    uint64_t rejected = 0;
+
+    explicit TinyLFU(size_t capacity)
+        : sketch(capacity), doorkeeper((int)std::max<size_t>(64, capacity * TINYLFU_DOORKEEPER_BITS), 0)
+    {
+    }
+
+    void reset()
+    {
+        sketch.reset();
+        doorkeeper.clear();
+        admitted = rejected = 0;
+    }
+
+    static size_t window_size(size_t capacity)
+    {
+        return std::max<size_t>(1, capacity * TINYLFU_WINDOW_PERCENT / 100);
+    }
+
+    // Call on every access (hit or miss)
+    void record(uint64_t key)
+    {
+        if (!doorkeeper.contains(key))
+        {
+            doorkeeper.mark(key);
+            return;
+        }
+        if (sketch.increment(key))
+            doorkeeper.clear(); // Age the doorkeeper together with the sketch
+    }
+
+    int frequency(uint64_t key) const { return sketch.estimate(key) + (doorkeeper.contains(key) ? 1 : 0); }
+
+    void checkpoint(StateArchive &a) { a.io(sketch, doorkeeper, admitted, rejected); }
+
+    bool admit(uint64_t candidate, uint64_t victim)
+    {
+        bool ok = frequency(candidate) > frequency(victim);
+        (ok ? admitted : rejected)++;
+        return ok;
+    }
+};
+
+// Small exact LRU used as the W-TinyLFU window region
+template <typename Key, typename Payload, typename Hash = std::hash<Key>>
+class AdmissionWindow
+{
+    size_t cap;
+    std::list<std::pair<Key, Payload>> order; // Front = MRU
+    std::unordered_map<Key, typename std::list<std::pair<Key, Payload>>::iterator, Hash> index;
+
+public:
+    explicit AdmissionWindow(size_t capacity) : cap(capacity) {}
+
+    size_t size() const { return order.size(); }
+    bool contains(const Key &key) const { return index.count(key) != 0; }
+
+    // Returns the payload and moves it to MRU, or nullptr
+    Payload *touch(const Key &key)
+    {
+        auto it = index.find(key);
+        if (it == index.end())
+            return nullptr;
+        order.splice(order.begin(), order, it->second);
+        return &it->second->second;
+    }
+
+    // Inserts at MRU. If that overflows the window, the LRU entry is moved
+    // into `overflow` and true is returned.
+    bool insert(const Key &key, Payload payload, std::pair<Key, Payload> &overflow)
+    {
+        order.emplace_front(key, std::move(payload));
+        index[key] = order.begin();
+        if (order.size() <= cap)
+            return false;
+        overflow = std::move(order.back());
+        index.erase(overflow.first);
+        order.pop_back();
+        return true;
+    }
+
+    bool erase(const Key &key)
+    {
+        auto it = index.find(key);
+        if (it == index.end())
+            return false;
+        order.erase(it->second);
+        index.erase(it);
+        return true;
+    }
+
+    void clear()
+    {
+        order.clear();
+        index.clear();
+    }
+
+    // The index points into `order`, so it is rebuilt rather than saved
+    void checkpoint(StateArchive &a)
+    {
+        a.io(order);
+        if (!a.loading())
+            return;
+        index.clear();
+        for (auto it = order.begin(); it != order.end(); ++it)
+            index[it->first] = it;
+    }
+};
@@ -0,0 +1,438 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "arena.h"
+#include "coalesce_policies.h"
+#include "trace.h"
+
+// ==========================================
+// LANE-PARALLEL COALESCE SWEEP
+// ==========================================
+// A sweep over CoalesceParams would otherwise replay the trace once per
+// setting. Here up to SWEEP_LANES settings run as lanes of one simulator,
+// and every access advances all of them together:
+//
+//   shared    - trace decode, set index, the access's perceptron and Bloom
+//               hashes, the phase detector's epoch clock
+//   per lane  - tags, line features, weights, ghost entries, phase state,
+//               stats. Every table is laid out configuration-minor
+//               ([entry * SWEEP_LANES + lane]): the lanes' copies of a way
+//               are one row, and so are their weights for one perceptron
+//               index. Tag compares and votes run across a row as plain
+//               loops the compiler vectorizes.
+//   Bloom     - one 16-bit word per filter bit, bit l for lane l
+//
+// Lanes that hold the same line features in a way vote with one row
+// operation. How much a sweep gains over separate runs therefore depends on
+// how far its settings let the lanes' contents drift apart: from about 2x
+// for far-apart thresholds on a miss-heavy trace to 5x when lanes mostly
+// agree.
+//
+// Each lane is exactly Simulator + COALESCE_Policy with its params (no
+// admission filter, tiered memory or eager writeback): the default lane
+// reproduces the COALESCE-Fixed row of a normal run.
+const int SWEEP_LANES = 16;
+
+// Knob names accepted by --sweep, in CoalesceParams order
+const char *const SWEEP_KNOBS[] = {"threshold", "override", "modified", "sharers", "sharing"};
+
+inline int &sweep_knob(CoalesceParams &p, int k)
+{
+    int *knobs[] = {&p.threshold, &p.veto_override, &p.veto_modified, &p.veto_sharers, &p.sharing_veto_percent};
+    return *knobs[k];
+}
+
+// "threshold=20,35,50:override=-100,-60" -> every combination, the first
+// knob varying slowest. Knobs not named keep their defaults.
+inline bool parse_sweep(const std::string &spec, std::vector<CoalesceParams> &out, std::string &error)
+{
+    out.assign(1, CoalesceParams());
+    std::istringstream in(spec);
+    std::string item;
+    while (std::getline(in, item, ':'))
+    {
+        size_t eq = item.find('=');
+        int k = 0;
+        while (k < 5 && item.compare(0, eq, SWEEP_KNOBS[k]) != 0)
+            k++;
+        if (eq == std::string::npos || k == 5)
+        {
+            error = "unknown sweep knob '" + item.substr(0, eq) + "' (threshold, override, modified, sharers, sharing)";
+            return false;
+        }
+        std::vector<int> values;
+        std::istringstream list(item.substr(eq + 1));
+        std::string v;
+        while (std::getline(list, v, ','))
+        {
+            char *end = nullptr;
+            long value = strtol(v.c_str(), &end, 10);
+            if (v.empty() || *end || value < INT32_MIN || value > INT32_MAX)
+            {
+                error = "sweep knob '" + item.substr(0, eq) + "': '" + v + "' is not a whole number";
+                return false;
+            }
+            values.push_back((int)value);
+        }
+        if (values.empty())
+        {
+            error = "no values for sweep knob '" + item.substr(0, eq) + "'";
+            return false;
+        }
+        std::vector<CoalesceParams> product;
+        for (const CoalesceParams &p : out)
+            for (int value : values)
+            {
+                product.push_back(p);
+                sweep_knob(product.back(), k) = value;
+            }
+        out.swap(product);
+    }
+    return true;
+}
+
+inline std::string sweep_label(CoalesceParams p)
+{
+    std::string label;
+    for (int k = 0; k < 5; k++)
+        label += std::string(k ? " " : "") + SWEEP_KNOBS[k] + "=" + std::to_string(sweep_knob(p, k));
+    return label;
+}
+
+class CoalesceSweep
+{
+    struct Phase
+    {
+        uint64_t epoch_misses = 0;
+        double mean = 0, cusum_up = 0, cusum_down = 0;
+        int epochs = 0;
+        int boost = 0;
+    };
+
+    static constexpr int GHOST_CAPACITY = BloomFilter::GHOST_CAPACITY;
+    static constexpr int NO_SHARING_ROW = PERCEPTRON_TABLE_SIZE; // All-zero weights: table2 for unclassified lines
+    static constexpr int VETO_KEYS = SHARING_CLASSES + 4;
+
+    int sets, ways, block_bits;
+    int lanes;
+    CoalesceParams params[SWEEP_LANES];
+    Arena arena;
+
+    // Lines (set * ways + way), [line * SWEEP_LANES + lane]. A line's
+    // CacheLine fields other than the tag are one feature word (see
+    // features()), so "same features" is a single compare.
+    uint64_t *tag;
+    uint32_t *feature;
+    uint16_t *valid;    // [line], one bit per lane
+
+    int8_t *weights[3]; // [index * SWEEP_LANES + lane], as PerceptronBrain's tables plus NO_SHARING_ROW.
+                        // Positive-only training keeps them in [-5, MAX_WEIGHT].
+    uint16_t *bloom;    // [sampled set * BLOOM_SIZE + bit], one bit per lane
+    uint32_t *ghost;    // [(sampled set * GHOST_CAPACITY + slot) * SWEEP_LANES + lane], CompactGhostEntry
+
+    uint64_t accesses = 0;
+    Phase phase[SWEEP_LANES];
+
+    // Per lane, the veto for each veto_key(): SHARING_VETO scaled by
+    // sharing_veto_percent for a classified line, else the MODIFIED and
+    // 2+ sharer vetoes
+    int veto_override[SWEEP_LANES];
+    int veto_table[VETO_KEYS][SWEEP_LANES];
+
+    // [sig:12 | state:2 | sharers:8 | sharing:3]
+    static uint32_t features(uint32_t sig, int st, int shr, int cls)
+    {
+        return sig | (uint32_t)st << 12 | (uint32_t)shr << 14 | (uint32_t)cls << 22;
+    }
+    static uint32_t sig_of(uint32_t f) { return f & PC_SIGNATURE_MASK; }
+    static MESI_State state_of(uint32_t f) { return (MESI_State)(f >> 12 & 3); }
+    static int sharers_of(uint32_t f) { return f >> 14 & 0xff; }
+    static int sharing_of(uint32_t f) { return f >> 22 & 7; }
+
+    static int veto_key(uint32_t f)
+    {
+        int cls = sharing_of(f);
+        return cls != SHARING_UNCLASSIFIED ? cls
+                                           : SHARING_CLASSES + (state_of(f) == MODIFIED) + 2 * (sharers_of(f) >= 2);
+    }
+
+    // BloomFilter::bit_index and the ghost directory slot, for BLOOM_SIZE bits
+    static int bloom_bit(uint64_t tag, uint64_t pc, int i) { return (tag ^ pc ^ (i * 0x9e3779b9)) % BLOOM_SIZE; }
+    static int ghost_slot(uint64_t tag, uint64_t pc) { return (tag ^ pc) % GHOST_CAPACITY; }
+
+    static size_t arena_bytes(size_t lines, size_t sampled)
+    {
+        size_t per_line = SWEEP_LANES * (sizeof(uint64_t) + sizeof(uint32_t)) + sizeof(uint16_t);
+        return lines * per_line + 3 * (PERCEPTRON_TABLE_SIZE + 1) * SWEEP_LANES +
+               sampled * (BLOOM_SIZE * sizeof(uint16_t) + GHOST_CAPACITY * SWEEP_LANES * sizeof(uint32_t)) +
+               8 * ARENA_ALIGN;
+    }
+
+    int8_t &weight(int table, int index, int lane) { return weights[table][index * SWEEP_LANES + lane]; }
+
+    // PerceptronBrain::predict_raw
+    int vote(int lane, int h0, int h1, int h2)
+    {
+        return weight(0, h0, lane) + weight(1, h1, lane) + weight(2, h2, lane);
+    }
+
+    // PerceptronBrain::train, positive only (COALESCE never trains negative)
+    void train(int lane, int h0, int h1, int h2, int v)
+    {
+        if (v > 0 && v > params[lane].threshold)
+            return;
+        int step = phase[lane].boost > 0 ? PHASE_BOOST_STEP : 1;
+        int8_t &w0 = weight(0, h0, lane), &w1 = weight(1, h1, lane);
+        w0 = std::min(MAX_WEIGHT, w0 + step);
+        w1 = std::min(MAX_WEIGHT, w1 + step);
+        if (h2 != NO_SHARING_ROW)
+        {
+            int8_t &w2 = weight(2, h2, lane);
+            w2 = std::min(MAX_WEIGHT, w2 + step);
+        }
+    }
+
+    // COALESCE_Policy::observe, for one lane; the epoch clock is shared
+    void observe(int lane, bool miss, bool epoch_end)
+    {
+        Phase &p = phase[lane];
+        p.epoch_misses += miss;
+        if (!epoch_end)
+            return;
+
+        double rate = (double)p.epoch_misses / PHASE_EPOCH;
+        p.epoch_misses = 0;
+        if (p.boost > 0)
+            p.boost--;
+        if (++p.epochs > PHASE_WARMUP_EPOCHS)
+        {
+            p.cusum_up = std::max(0.0, p.cusum_up + rate - p.mean - PHASE_CUSUM_SLACK);
+            p.cusum_down = std::max(0.0, p.cusum_down + p.mean - rate - PHASE_CUSUM_SLACK);
+            if (p.cusum_up > PHASE_CUSUM_LIMIT || p.cusum_down > PHASE_CUSUM_LIMIT)
+            {
+                phase_changes[lane]++;
+                for (int t = 0; t < 3; t++)
+                    for (int i = 0; i < PERCEPTRON_TABLE_SIZE; i++)
+                        weight(t, i, lane) /= (1 << PHASE_DECAY_SHIFT);
+                p.boost = PHASE_BOOST_EPOCHS;
+                p.epochs = 0;
+                p.mean = p.cusum_up = p.cusum_down = 0;
+                return;
+            }
+        }
+        p.mean += (rate - p.mean) / p.epochs;
+    }
+
+    // COALESCE_Policy::find_victim for every lane at once, way by way. The
+    // lanes' weights for one perceptron index are a contiguous row, so the
+    // vote of one feature word is three row loads and adds for all lanes
+    // together. A way costs one such step per distinct feature word the
+    // lanes hold there, usually one or two. Lanes that hit or still have a
+    // free way get an answer too; it goes unused.
+    void find_victims(size_t base, int *victim)
+    {
+        int min_vote[SWEEP_LANES];
+        std::fill(min_vote, min_vote + SWEEP_LANES, 999999);
+        for (int w = 0; w < ways; w++)
+        {
+            const uint32_t *f = feature + (base + w) * SWEEP_LANES;
+            int final_vote[SWEEP_LANES];
+            for (uint16_t todo = 0xffff; todo;)
+            {
+                uint32_t x = f[__builtin_ctz(todo)];
+                uint32_t sig = sig_of(x);
+                int cls = sharing_of(x);
+                const int8_t *w0 = weights[0] + PerceptronBrain::get_hash0(sig, state_of(x)) * SWEEP_LANES;
+                const int8_t *w1 = weights[1] + PerceptronBrain::get_hash1(sig, sharers_of(x)) * SWEEP_LANES;
+                const int8_t *w2 = weights[2] +
+                                   (cls != SHARING_UNCLASSIFIED ? PerceptronBrain::get_hash2(sig, cls) : NO_SHARING_ROW) *
+                                       SWEEP_LANES;
+                const int *veto = veto_table[veto_key(x)];
+                for (int l = 0; l < SWEEP_LANES; l++)
+                {
+                    int raw = w0[l] + w1[l] + w2[l];
+                    int vetoed = raw + veto[l];
+                    int v = raw > veto_override[l] ? vetoed : raw;
+                    final_vote[l] = f[l] == x ? v : final_vote[l];
+                }
+                for (int l = 0; l < SWEEP_LANES; l++)
+                    todo &= ~((uint16_t)(f[l] == x) << l);
+            }
+            for (int l = 0; l < SWEEP_LANES; l++)
+            {
+                victim[l] = final_vote[l] < min_vote[l] ? w : victim[l];
+                min_vote[l] = std::min(min_vote[l], final_vote[l]);
+            }
+        }
+    }
+
+public:
+    uint64_t hits[SWEEP_LANES] = {};
+    uint64_t misses[SWEEP_LANES] = {};
+    uint64_t total_latency[SWEEP_LANES] = {};
+    uint64_t phase_changes[SWEEP_LANES] = {};
+
+    CoalesceSweep(const std::vector<CoalesceParams> &configs, int num_sets = NUM_SETS, int assoc = WAYS,
+                  int log2_block = 6)
+        : sets(num_sets), ways(assoc), block_bits(log2_block),
+          lanes(std::min<int>(SWEEP_LANES, (int)configs.size())),
+          arena(arena_bytes((size_t)num_sets * assoc, (num_sets + SAMPLING_MODULO - 1) / SAMPLING_MODULO))
+    {
+        size_t lines = (size_t)sets * ways;
+        size_t sampled = (sets + SAMPLING_MODULO - 1) / SAMPLING_MODULO;
+        std::copy(configs.begin(), configs.begin() + lanes, params);
+        for (int l = 0; l < SWEEP_LANES; l++)
+        {
+            veto_override[l] = params[l].veto_override;
+            for (int c = 0; c < SHARING_CLASSES; c++)
+                veto_table[c][l] = SHARING_VETO[c] * params[l].sharing_veto_percent / 100;
+            for (int k = SHARING_CLASSES; k < VETO_KEYS; k++)
+                veto_table[k][l] = ((k - SHARING_CLASSES) & 1 ? params[l].veto_modified : 0) +
+                                   ((k - SHARING_CLASSES) & 2 ? params[l].veto_sharers : 0);
+        }
+        tag = arena.alloc<uint64_t>(lines * SWEEP_LANES);
+        feature = arena.alloc<uint32_t>(lines * SWEEP_LANES);
+        valid = arena.alloc<uint16_t>(lines);
+        for (int t = 0; t < 3; t++)
+            weights[t] = arena.alloc<int8_t>((PERCEPTRON_TABLE_SIZE + 1) * SWEEP_LANES);
+        bloom = arena.alloc<uint16_t>(sampled * BLOOM_SIZE);
+        ghost = arena.alloc<uint32_t>(sampled * GHOST_CAPACITY * SWEEP_LANES);
+
+        // PerceptronBrain's cold-start weights in every lane
+        for (int i = 0; i < PERCEPTRON_TABLE_SIZE; i++)
+            for (int l = 0; l < SWEEP_LANES; l++)
+            {
+                weight(0, i, l) = -5 + (i % 11);
+                weight(1, i, l) = -5 + ((i * 7) % 11);
+            }
+    }
+
+    void access(uint64_t addr, uint64_t full_pc, int access_sharers, MESI_State st, int access_sharing)
+    {
+        int set_idx = (addr >> block_bits) % sets;
+        size_t base = (size_t)set_idx * ways;
+        bool sampled = set_idx % SAMPLING_MODULO == 0;
+        bool epoch_end = ++accesses % PHASE_EPOCH == 0;
+
+        // Everything about the access itself, once for all lanes
+        uint32_t sig = full_pc & PC_SIGNATURE_MASK;
+        int shr = std::min(access_sharers, 255);
+        uint32_t x = features(sig, st, shr, access_sharing);
+        int h0 = PerceptronBrain::get_hash0(sig, st);
+        int h1 = PerceptronBrain::get_hash1(sig, shr);
+        int h2 = access_sharing != SHARING_UNCLASSIFIED ? PerceptronBrain::get_hash2(sig, access_sharing)
+                                                        : NO_SHARING_ROW;
+
+        // Tag compare across lanes, one mask per way; `full` has a lane's
+        // bit when none of its ways is free
+        int hit_way[SWEEP_LANES];
+        uint16_t hit = 0, full = 0xffff;
+        for (int w = 0; w < ways; w++)
+        {
+            const uint64_t *t = tag + (base + w) * SWEEP_LANES;
+            uint16_t match = 0;
+            for (int l = 0; l < SWEEP_LANES; l++)
+                match |= (uint16_t)(t[l] == addr) << l;
+            match &= valid[base + w];
+            full &= valid[base + w];
+            for (uint16_t m = match; m; m &= m - 1)
+                hit_way[__builtin_ctz(m)] = w;
+            hit |= match;
+        }
+
+        // Victims for the lanes that missed, all in one pass over the set
+        int victim_way[SWEEP_LANES];
+        uint16_t active = (uint16_t)((1u << lanes) - 1);
+        if (~hit & full & active)
+            find_victims(base, victim_way);
+
+        // Where this access sits in the sampled set's Bloom words and ghost directory
+        size_t sampled_idx = set_idx / SAMPLING_MODULO;
+        uint16_t *b = bloom + sampled_idx * BLOOM_SIZE;
+        int bit[BLOOM_HASHES];
+        for (int k = 0; k < BLOOM_HASHES; k++)
+            bit[k] = bloom_bit(addr, full_pc, k);
+        size_t slot = (sampled_idx * GHOST_CAPACITY + ghost_slot(addr, full_pc)) * SWEEP_LANES;
+
+        for (int l = 0; l < lanes; l++)
+        {
+            if (hit >> l & 1)
+            {
+                hits[l]++;
+                total_latency[l] += LATENCY_L3_HIT;
+                feature[(base + hit_way[l]) * SWEEP_LANES + l] = x;
+                if (sampled)
+                    train(l, h0, h1, h2, vote(l, h0, h1, h2));
+                observe(l, false, epoch_end);
+                continue;
+            }
+
+            misses[l]++;
+            total_latency[l] += LATENCY_DRAM;
+            int victim = 0;
+            if (!(full >> l & 1))
+            {
+                while (valid[base + victim] >> l & 1)
+                    victim++;
+            }
+            else
+            {
+                victim = victim_way[l];
+                size_t i = (base + victim) * SWEEP_LANES + l;
+                uint32_t v = feature[i];
+                if (sampled)
+                {
+                    for (int k = 0; k < BLOOM_HASHES; k++)
+                        b[bloom_bit(tag[i], sig_of(v), k)] |= 1 << l;
+                    ghost[(sampled_idx * GHOST_CAPACITY + ghost_slot(tag[i], sig_of(v))) * SWEEP_LANES + l] =
+                        CompactGhostEntry(tag[i], sig_of(v), sharers_of(v), state_of(v)).packed;
+                }
+                if (state_of(v) == MODIFIED || sharers_of(v) > 1)
+                    total_latency[l] += LATENCY_COHERENCE_PENALTY;
+            }
+
+            size_t i = (base + victim) * SWEEP_LANES + l;
+            tag[i] = addr;
+            feature[i] = x;
+            valid[base + victim] |= 1 << l;
+
+            // Ghost hit: evicted too early, train up with the features it had
+            // (looked up after the victim went in, as COALESCE_Policy does).
+            // Ghost entries carry no sharing class, so table2 is left out
+            if (sampled && (b[bit[0]] & b[bit[1]] & b[bit[2]]) >> l & 1)
+            {
+                CompactGhostEntry g;
+                g.packed = ghost[slot + l];
+                if (g.matches(addr, full_pc))
+                {
+                    int g0 = PerceptronBrain::get_hash0(full_pc, g.get_state());
+                    int g1 = PerceptronBrain::get_hash1(full_pc, g.get_sharers());
+                    int gv = vote(l, g0, g1, NO_SHARING_ROW);
+                    for (int k = 0; k < 5; k++)
+                        train(l, g0, g1, NO_SHARING_ROW, gv);
+                }
+            }
+            observe(l, true, epoch_end);
+        }
+    }
+
+    // Same address handling as Simulator::access_batch
+    void access_batch(const TraceRecord *recs, size_t n, bool byte_addresses)
+    {
+        int shift = (!byte_addresses && block_bits > 6) ? 6 : 0;
+        uint64_t mask = (byte_addresses || shift) ? ~((1ULL << block_bits) - 1) : ~(uint64_t)0;
+        for (size_t i = 0; i < n; i++)
+        {
+            const TraceRecord &r = recs[i];
+            int cls = (r.flags & TRACE_FLAG_SHARING_MASK) >> TRACE_FLAG_SHARING_SHIFT;
+            access((r.addr << shift) & mask, r.pc, r.sharers, (MESI_State)(r.flags & TRACE_FLAG_STATE_MASK),
+                   cls < SHARING_CLASSES ? cls : SHARING_UNCLASSIFIED);
+        }
+    }
+};
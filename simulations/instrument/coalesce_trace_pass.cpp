@@ -0,0 +1,113 @@
+// ==========================================
+// COALESCE TRACE PASS (LLVM new pass manager plugin)
+// ==========================================
+// Inserts a call before every load, store and atomic RMW/CAS:
+//   __coalesce_trace_load(ptr, size)   /   __coalesce_trace_store(ptr, size)
+// The hooks live in coalesce_trace_rt.cpp and record the call site PC.
+//
+// Runs at the end of the optimization pipeline, so values promoted to
+// registers are never traced and the overhead tracks what the real binary
+// does. Accesses that provably hit the local stack frame (direct alloca
+// addresses) are skipped by default since they never reach a shared cache in
+// any interesting way; set COALESCE_TRACE_STACK=1 at compile time to keep them.
+//
+//   clang -O2 -fpass-plugin=./libCoalesceTracePass.so app.c coalesce_trace_rt.o -pthread
+//   opt -load-pass-plugin=./libCoalesceTracePass.so -passes=coalesce-trace in.ll
+
+#include "llvm/IR/Function.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/PassManager.h"
+#include "llvm/Passes/PassBuilder.h"
+#include "llvm/Passes/PassPlugin.h"
+
+#include <cstdlib>
+#include <vector>
+
+using namespace llvm;
+
+namespace
+{
+
+struct CoalesceTracePass : PassInfoMixin<CoalesceTracePass>
+{
+    PreservedAnalyses run(Module &M, ModuleAnalysisManager &)
+    {
+        LLVMContext &Ctx = M.getContext();
+        const DataLayout &DL = M.getDataLayout();
+        Type *VoidTy = Type::getVoidTy(Ctx);
+        Type *I32Ty = Type::getInt32Ty(Ctx);
+        PointerType *PtrTy = PointerType::get(Type::getInt8Ty(Ctx), 0);
+
+        FunctionCallee LoadHook = M.getOrInsertFunction("__coalesce_trace_load", VoidTy, PtrTy, I32Ty);
+        FunctionCallee StoreHook = M.getOrInsertFunction("__coalesce_trace_store", VoidTy, PtrTy, I32Ty);
+        bool TraceStack = getenv("COALESCE_TRACE_STACK") != nullptr;
+
+        bool Changed = false;
+        for (Function &F : M)
+        {
+            if (F.isDeclaration() || F.getName().startswith("__coalesce_trace"))
+                continue;
+
+            // Collect first, inserting calls while iterating would revisit them
+            struct Site
+            {
+                Instruction *I;
+                Value *Ptr;
+                Type *Ty;
+                bool IsWrite;
+            };
+            std::vector<Site> Sites;
+
+            for (BasicBlock &BB : F)
+            {
+                for (Instruction &I : BB)
+                {
+                    if (auto *LI = dyn_cast<LoadInst>(&I))
+                        Sites.push_back({LI, LI->getPointerOperand(), LI->getType(), false});
+                    else if (auto *SI = dyn_cast<StoreInst>(&I))
+                        Sites.push_back({SI, SI->getPointerOperand(), SI->getValueOperand()->getType(), true});
+                    else if (auto *RMW = dyn_cast<AtomicRMWInst>(&I))
+                        Sites.push_back({RMW, RMW->getPointerOperand(), RMW->getValOperand()->getType(), true});
+                    else if (auto *CAS = dyn_cast<AtomicCmpXchgInst>(&I))
+                        Sites.push_back({CAS, CAS->getPointerOperand(), CAS->getCompareOperand()->getType(), true});
+                }
+            }
+
+            for (const Site &S : Sites)
+            {
+                if (S.Ptr->getType()->getPointerAddressSpace() != 0)
+                    continue; // GPU / special address spaces
+                if (!TraceStack && isa<AllocaInst>(S.Ptr->stripPointerCasts()))
+                    continue;
+
+                IRBuilder<> IRB(S.I);
+                uint64_t Size = DL.getTypeStoreSize(S.Ty).getFixedSize();
+                Value *Addr = IRB.CreatePointerCast(S.Ptr, PtrTy);
+                IRB.CreateCall(S.IsWrite ? StoreHook : LoadHook, {Addr, ConstantInt::get(I32Ty, Size)});
+                Changed = true;
+            }
+        }
+        return Changed ? PreservedAnalyses::none() : PreservedAnalyses::all();
+    }
+
+    static bool isRequired() { return true; } // Also run at -O0
+};
+
+} // namespace
+
+extern "C" LLVM_ATTRIBUTE_WEAK PassPluginLibraryInfo llvmGetPassPluginInfo()
+{
+    return {LLVM_PLUGIN_API_VERSION, "CoalesceTrace", "0.1", [](PassBuilder &PB) {
+                PB.registerOptimizerLastEPCallback([](ModulePassManager &MPM, OptimizationLevel) {
+                    MPM.addPass(CoalesceTracePass());
+                });
+                PB.registerPipelineParsingCallback([](StringRef Name, ModulePassManager &MPM, ArrayRef<PassBuilder::PipelineElement>) {
+                    if (Name != "coalesce-trace")
+                        return false;
+                    MPM.addPass(CoalesceTracePass());
+                    return true;
+                });
+            }};
+}
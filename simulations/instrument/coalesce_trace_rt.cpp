@@ -0,0 +1,219 @@
+// ==========================================
+// COALESCE TRACE RUNTIME
+// ==========================================
+// Link this into a program built with either
+//   clang -fpass-plugin=libCoalesceTracePass.so ...      (any clang >= 14)
+//   clang -fsanitize-coverage=trace-loads,trace-stores   (clang >= 16, no plugin)
+// and every instrumented load/store is logged as a native trace record
+// (thread, PC, address, size, r/w) - see ../trace.h.
+//
+// Hot path: each thread appends to its own single-producer ring, no locks and
+// no syscalls. A background thread drains all rings in large batches into a
+// TraceWriter, so the application only stalls if the writer falls a full ring
+// behind.
+//
+// Environment:
+//   COALESCE_TRACE=SPEC      output: file, FIFO, '-' or unix:PATH (default coalesce.trace)
+//   COALESCE_TRACE_RING=N    records per thread ring, power of two (default 65536)
+//
+// This file must NOT be instrumented itself.
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+
+#include "../trace.h"
+
+extern "C" char __executable_start __attribute__((weak));
+extern "C" char etext __attribute__((weak));
+
+namespace
+{
+
+// ==========================================
+// PER-THREAD SPSC RING
+// ==========================================
+struct alignas(64) ThreadRing
+{
+    std::atomic<uint64_t> head{0}; // Written by the owning thread
+    char pad0[64 - sizeof(std::atomic<uint64_t>)];
+    std::atomic<uint64_t> tail{0}; // Written by the flusher
+    char pad1[64 - sizeof(std::atomic<uint64_t>)];
+
+    TraceRecord *slots = nullptr;
+    uint64_t mask = 0;
+    uint16_t tid = 0;
+    std::atomic<bool> retired{false};
+    ThreadRing *next = nullptr; // Registry list, push-only
+};
+
+std::atomic<ThreadRing *> g_rings{nullptr};
+std::atomic<uint16_t> g_next_tid{0};
+std::atomic<bool> g_running{false};
+std::atomic<uint64_t> g_stalls{0};
+uint64_t g_ring_size = 1 << 16;
+uintptr_t g_exe_base = 0;
+uintptr_t g_exe_text_end = 0;
+
+TraceWriter *g_writer = nullptr;
+std::thread *g_flusher = nullptr;
+
+thread_local ThreadRing *t_ring = nullptr;
+thread_local bool t_in_runtime = false; // Blocks re-entry from libc/STL calls
+
+// Unregisters the ring on thread exit; the flusher drains what is left
+struct RingOwner
+{
+    ~RingOwner()
+    {
+        if (t_ring)
+            t_ring->retired.store(true, std::memory_order_release);
+        t_ring = nullptr;
+    }
+};
+thread_local RingOwner t_owner;
+
+ThreadRing *register_thread()
+{
+    t_in_runtime = true;
+    ThreadRing *r = new ThreadRing();
+    r->slots = new TraceRecord[g_ring_size];
+    r->mask = g_ring_size - 1;
+    r->tid = g_next_tid.fetch_add(1, std::memory_order_relaxed);
+
+    ThreadRing *old = g_rings.load(std::memory_order_relaxed);
+    do
+        r->next = old;
+    while (!g_rings.compare_exchange_weak(old, r, std::memory_order_release, std::memory_order_relaxed));
+
+    (void)&t_owner; // Touch it so the destructor is registered for this thread
+    t_ring = r;
+    t_in_runtime = false;
+    return r;
+}
+
+// Drain everything currently published in one ring. Returns records moved.
+uint64_t drain(ThreadRing *r)
+{
+    uint64_t tail = r->tail.load(std::memory_order_relaxed);
+    uint64_t head = r->head.load(std::memory_order_acquire);
+    for (uint64_t i = tail; i < head; i++)
+        g_writer->write(r->slots[i & r->mask]);
+    r->tail.store(head, std::memory_order_release);
+    return head - tail;
+}
+
+void flusher_main()
+{
+    t_in_runtime = true;
+    while (true)
+    {
+        bool running = g_running.load(std::memory_order_acquire);
+        uint64_t moved = 0;
+        for (ThreadRing *r = g_rings.load(std::memory_order_acquire); r; r = r->next)
+            moved += drain(r);
+        if (!running)
+            break;
+        if (moved == 0)
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+    g_writer->flush();
+}
+
+inline void log_access(uintptr_t pc, const void *addr, uint32_t size, bool is_write)
+{
+    if (t_in_runtime || !g_running.load(std::memory_order_relaxed))
+        return;
+    ThreadRing *r = t_ring ? t_ring : register_thread();
+
+    uint64_t head = r->head.load(std::memory_order_relaxed);
+    if (head - r->tail.load(std::memory_order_acquire) > r->mask)
+    {
+        // Ring full: wait for the flusher rather than drop accesses
+        g_stalls.fetch_add(1, std::memory_order_relaxed);
+        while (head - r->tail.load(std::memory_order_acquire) > r->mask)
+            std::this_thread::yield();
+    }
+
+    TraceRecord &rec = r->slots[head & r->mask];
+    rec.addr = (uint64_t)(uintptr_t)addr;
+    rec.pc = pc < g_exe_text_end ? pc - g_exe_base : pc; // Stable across ASLR runs for the main binary
+    rec.size = size;
+    rec.core = r->tid;
+    rec.sharers = 0;
+    rec.flags = is_write ? TRACE_FLAG_WRITE : 0;
+    r->head.store(head + 1, std::memory_order_release);
+}
+
+__attribute__((constructor)) void coalesce_trace_init()
+{
+    t_in_runtime = true;
+    const char *spec = getenv("COALESCE_TRACE");
+    const char *ring = getenv("COALESCE_TRACE_RING");
+    if (ring)
+    {
+        uint64_t n = strtoull(ring, nullptr, 0);
+        g_ring_size = 1024;
+        while (g_ring_size < n)
+            g_ring_size <<= 1;
+    }
+    if (&__executable_start && &etext)
+    {
+        g_exe_base = (uintptr_t)&__executable_start;
+        g_exe_text_end = (uintptr_t)&etext;
+    }
+
+    g_writer = new TraceWriter(1 << 16);
+    if (!g_writer->open(spec ? spec : "coalesce.trace", TRACE_HDR_BYTE_ADDRESSES | TRACE_HDR_NEEDS_COHERENCE))
+    {
+        fprintf(stderr, "[coalesce-trace] disabled: %s\n", g_writer->error.c_str());
+        t_in_runtime = false;
+        return;
+    }
+    g_running.store(true, std::memory_order_release);
+    g_flusher = new std::thread(flusher_main);
+    t_in_runtime = false;
+}
+
+__attribute__((destructor)) void coalesce_trace_fini()
+{
+    if (!g_running.load())
+        return;
+    t_in_runtime = true;
+    g_running.store(false, std::memory_order_release);
+    g_flusher->join();
+    g_writer->finish();
+    fprintf(stderr, "[coalesce-trace] %llu records from %u threads (%llu ring stalls)\n",
+            (unsigned long long)g_writer->records_written, (unsigned)g_next_tid.load(),
+            (unsigned long long)g_stalls.load());
+}
+
+} // namespace
+
+// ==========================================
+// HOOKS
+// ==========================================
+// The return address of the hook is the instruction right after the call in
+// the instrumented code, which identifies the load/store site.
+#define COALESCE_PC() ((uintptr_t)__builtin_return_address(0))
+
+extern "C"
+{
+    // Emitted by the CoalesceTrace pass
+    void __coalesce_trace_load(void *addr, uint32_t size) { log_access(COALESCE_PC(), addr, size, false); }
+    void __coalesce_trace_store(void *addr, uint32_t size) { log_access(COALESCE_PC(), addr, size, true); }
+
+    // Emitted by -fsanitize-coverage=trace-loads,trace-stores
+    void __sanitizer_cov_load1(uint8_t *addr) { log_access(COALESCE_PC(), addr, 1, false); }
+    void __sanitizer_cov_load2(uint16_t *addr) { log_access(COALESCE_PC(), addr, 2, false); }
+    void __sanitizer_cov_load4(uint32_t *addr) { log_access(COALESCE_PC(), addr, 4, false); }
+    void __sanitizer_cov_load8(uint64_t *addr) { log_access(COALESCE_PC(), addr, 8, false); }
+    void __sanitizer_cov_load16(__int128 *addr) { log_access(COALESCE_PC(), addr, 16, false); }
+    void __sanitizer_cov_store1(uint8_t *addr) { log_access(COALESCE_PC(), addr, 1, true); }
+    void __sanitizer_cov_store2(uint16_t *addr) { log_access(COALESCE_PC(), addr, 2, true); }
+    void __sanitizer_cov_store4(uint32_t *addr) { log_access(COALESCE_PC(), addr, 4, true); }
+    void __sanitizer_cov_store8(uint64_t *addr) { log_access(COALESCE_PC(), addr, 8, true); }
+    void __sanitizer_cov_store16(__int128 *addr) { log_access(COALESCE_PC(), addr, 16, true); }
+}
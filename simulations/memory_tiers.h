@@ -0,0 +1,273 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "coalesce_policies.h"
+
+// ==========================================
+// TIERED MEMORY BACKEND
+// ==========================================
+// LATENCY_DRAM charges every miss the same. Behind a real L3 there may be
+// local DRAM plus CXL-attached memory at 2-3x the latency, so a miss costs
+// whatever the tier holding its page costs, and a dirty eviction pays that
+// tier's write latency. Pages go to a tier by explicit range first, then by
+// the placement policy:
+//
+//   first-touch - tiers fill in the order listed, each up to its capacity,
+//                 like an OS allocating on first fault
+//   interleave  - pages rotate over the tiers (page number mod tier count)
+//
+// Config file (--memory=FILE), '#' starts a comment:
+//
+//   # name  read write bytes/cycle pages     (0 = unlimited)
+//   tier local 200  100   0          65536
+//   tier cxl   480  260   16         0
+//   placement first-touch
+//   range 0x40000 0x4ffff cxl                (pages FIRST..LAST, inclusive)
+//
+// Bandwidth is modelled as serialization only: moving B bytes adds
+// B / bandwidth cycles. Requests don't queue behind each other.
+const int MAX_MEMORY_TIERS = 4;      // CacheLine keeps the tier in 2 bits
+const int TIER_PAGE_BITS = 12;       // Placement granularity: 4KB pages
+const int CXL_READ_LATENCY = 480;    // Default far tier for the built-in placements
+const int CXL_WRITE_LATENCY = 260;
+const int CXL_BYTES_PER_CYCLE = 16;
+
+struct MemoryTier
+{
+    std::string name;
+    int read_latency = LATENCY_DRAM;
+    int write_latency = LATENCY_COHERENCE_PENALTY; // Same as the flat model's dirty eviction
+    int bytes_per_cycle = 0;                       // 0 = unlimited
+    uint64_t capacity_pages = 0;                   // 0 = unlimited
+
+    uint64_t pages = 0;
+    uint64_t reads = 0, read_cycles = 0;
+    uint64_t writebacks = 0, write_cycles = 0;
+
+    int transfer(int bytes) const { return bytes_per_cycle ? (bytes + bytes_per_cycle - 1) / bytes_per_cycle : 0; }
+};
+
+class TieredMemory
+{
+    struct Range
+    {
+        uint64_t first, last;
+        int tier;
+    };
+
+    std::vector<Range> ranges;
+    bool interleave = false;
+    std::unordered_map<uint64_t, uint8_t> placed; // First-touch: page -> tier
+    int filling = 0;                              // First-touch: tier taking new pages
+
+    bool fail(const std::string &msg)
+    {
+        error = msg;
+        return false;
+    }
+
+    int find_tier(const std::string &name) const
+    {
+        for (size_t t = 0; t < tiers.size(); t++)
+            if (tiers[t].name == name)
+                return (int)t;
+        return -1;
+    }
+
+    bool load(const std::string &path)
+    {
+        std::ifstream in(path);
+        if (!in)
+            return fail("cannot open " + path);
+
+        std::string text;
+        int line_no = 0;
+        while (std::getline(in, text))
+        {
+            line_no++;
+            std::istringstream line(text.substr(0, text.find('#')));
+            std::string key;
+            if (!(line >> key))
+                continue;
+            std::string where = path + ":" + std::to_string(line_no) + ": ";
+
+            if (key == "tier")
+            {
+                MemoryTier t;
+                if (!(line >> t.name >> t.read_latency >> t.write_latency))
+                    return fail(where + "expected 'tier NAME READ WRITE [BYTES/CYCLE [PAGES]]'");
+                long long pages = 0; // Signed, so a negative count is caught rather than wrapped
+                line >> t.bytes_per_cycle >> pages;
+                if (t.read_latency <= 0 || t.write_latency < 0 || t.bytes_per_cycle < 0 || pages < 0)
+                    return fail(where + "read latency must be at least 1; write latency, bytes/cycle and pages "
+                                        "can't be negative");
+                t.capacity_pages = pages;
+                if (tiers.size() == MAX_MEMORY_TIERS)
+                    return fail(where + "at most " + std::to_string(MAX_MEMORY_TIERS) + " tiers");
+                tiers.push_back(t);
+            }
+            else if (key == "placement")
+            {
+                std::string p;
+                line >> p;
+                if (p != "first-touch" && p != "interleave")
+                    return fail(where + "placement is first-touch or interleave");
+                interleave = p == "interleave";
+            }
+            else if (key == "range")
+            {
+                std::string first, last, name;
+                if (!(line >> first >> last >> name))
+                    return fail(where + "expected 'range FIRST_PAGE LAST_PAGE TIER'");
+                int t = find_tier(name);
+                if (t < 0)
+                    return fail(where + "unknown tier '" + name + "' (declare tiers first)");
+                ranges.push_back({strtoull(first.c_str(), nullptr, 0), strtoull(last.c_str(), nullptr, 0), t});
+            }
+            else
+                return fail(where + "unknown keyword '" + key + "'");
+        }
+        if (tiers.empty())
+            return fail(path + ": no tiers");
+        return true;
+    }
+
+public:
+    std::vector<MemoryTier> tiers;
+    std::string error;
+
+    // SPEC: FILE, "first-touch:PAGES" (PAGES of local DRAM, the rest on CXL)
+    // or "interleave" (local and CXL page by page)
+    bool configure(const std::string &spec)
+    {
+        tiers.clear();
+        ranges.clear();
+        placed.clear();
+        interleave = false;
+        filling = 0;
+        MemoryTier local, cxl;
+        local.name = "local";
+        cxl.name = "cxl";
+        cxl.read_latency = CXL_READ_LATENCY;
+        cxl.write_latency = CXL_WRITE_LATENCY;
+        cxl.bytes_per_cycle = CXL_BYTES_PER_CYCLE;
+
+        if (spec.compare(0, 12, "first-touch:") == 0)
+        {
+            local.capacity_pages = std::max(1ULL, strtoull(spec.c_str() + 12, nullptr, 0));
+            tiers = {local, cxl};
+            return true;
+        }
+        if (spec == "interleave")
+        {
+            tiers = {local, cxl};
+            interleave = true;
+            return true;
+        }
+        return load(spec);
+    }
+
+    // Forget page placement and statistics, keep the configuration
+    void reset()
+    {
+        placed.clear();
+        filling = 0;
+        for (MemoryTier &t : tiers)
+            t.pages = t.reads = t.read_cycles = t.writebacks = t.write_cycles = 0;
+    }
+
+    // The configuration in one line, for result-cache keys
+    std::string describe() const
+    {
+        std::ostringstream out;
+        out << (interleave ? "interleave" : "first-touch");
+        for (const MemoryTier &t : tiers)
+            out << " " << t.name << ":" << t.read_latency << "/" << t.write_latency << "/" << t.bytes_per_cycle << "/"
+                << t.capacity_pages;
+        for (const Range &r : ranges)
+            out << " " << r.first << "-" << r.last << ":" << r.tier;
+        return out.str();
+    }
+
+    // Placement and statistics; the tiers themselves come from the config
+    void checkpoint(StateArchive &a)
+    {
+        a.expect((uint64_t)tiers.size(), "memory tiers");
+        for (MemoryTier &t : tiers)
+            a.io(t.pages, t.reads, t.read_cycles, t.writebacks, t.write_cycles);
+        a.io(placed, filling);
+    }
+
+    int tier_of(uint64_t addr)
+    {
+        uint64_t page = addr >> TIER_PAGE_BITS;
+        for (const Range &r : ranges)
+            if (page >= r.first && page <= r.last)
+                return r.tier;
+        if (interleave)
+            return (int)(page % tiers.size());
+
+        auto it = placed.find(page);
+        if (it != placed.end())
+            return it->second;
+        while (filling + 1 < (int)tiers.size() && tiers[filling].capacity_pages &&
+               tiers[filling].pages >= tiers[filling].capacity_pages)
+            filling++;
+        tiers[filling].pages++;
+        placed[page] = (uint8_t)filling;
+        return filling;
+    }
+
+    // Cost of a miss served from / a dirty eviction sent to `tier`
+    int read(int tier, int bytes)
+    {
+        MemoryTier &t = tiers[tier];
+        int cycles = t.read_latency + t.transfer(bytes);
+        t.reads++;
+        t.read_cycles += cycles;
+        return cycles;
+    }
+
+    int write_cost(int tier, int bytes) const { return tiers[tier].write_latency + tiers[tier].transfer(bytes); }
+
+    void record_writeback(int tier, int cycles)
+    {
+        tiers[tier].writebacks++;
+        tiers[tier].write_cycles += cycles;
+    }
+
+    // What a policy pays to bring a line back, per tier
+    std::vector<int> refetch_costs(int bytes) const
+    {
+        std::vector<int> cost;
+        for (const MemoryTier &t : tiers)
+            cost.push_back(t.read_latency + t.transfer(bytes));
+        return cost;
+    }
+
+    void print(std::ostream &out) const
+    {
+        uint64_t reads = 0;
+        for (const MemoryTier &t : tiers)
+            reads += t.reads;
+        out << "    tiers:";
+        for (size_t i = 0; i < tiers.size(); i++)
+        {
+            const MemoryTier &t = tiers[i];
+            out << (i ? " |" : "") << " " << t.name << " " << t.reads << " misses (" << std::fixed
+                << std::setprecision(1) << 100.0 * t.reads / std::max<uint64_t>(1, reads) << "%), "
+                << t.read_cycles + t.write_cycles << " cyc, " << t.writebacks << " writebacks";
+        }
+        out << "\n";
+    }
+};
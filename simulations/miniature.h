@@ -0,0 +1,94 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#include "trace_summary.h"
+
+// ==========================================
+// MINIATURE SIMULATION (approximate MRCs)
+// ==========================================
+// Stack distances give LRU's whole miss-ratio curve in one pass, but SRRIP,
+// SHiP or COALESCE need one simulation per cache size. Miniature simulation
+// makes each of those cheap:
+//
+//   sampling  - a block is kept when its address hash falls in a 1/R slice,
+//               so every access to a sampled block is kept and none to the
+//               others (reuse and sharing survive intact)
+//   scaling   - the sampled stream runs in a cache R times smaller, so the
+//               ratio of footprint to capacity, and with it the miss ratio,
+//               matches the full cache
+//   error     - the slice is cut into MRC_MINIATURES disjoint parts, each
+//               simulated on its own. Their spread is the error bar: the
+//               standard error of the combined miss ratio.
+//
+// The whole curve costs about 1/R of one full simulation per size, plus one
+// pass to hash the trace.
+const int MRC_MINIATURES = 4;
+const int MRC_MIN_LINES = 4; // Smaller miniatures are noise, not a cache
+
+class SpatialSampler
+{
+    uint64_t buckets;
+
+public:
+    // 1 in `rate` blocks overall, 1 in MRC_MINIATURES * rate per miniature
+    explicit SpatialSampler(int rate) : buckets((uint64_t)MRC_MINIATURES * std::max(1, rate)) {}
+
+    uint64_t scale() const { return buckets; }
+
+    // Miniature that owns `block`, or -1 when it is not sampled
+    int pick(uint64_t block) const
+    {
+        uint64_t b = summary_hash(block) % buckets;
+        return b < (uint64_t)MRC_MINIATURES ? (int)b : -1;
+    }
+};
+
+// One (policy, size) point of a curve, from its miniatures
+struct MrcPoint
+{
+    uint64_t misses[MRC_MINIATURES] = {};
+    uint64_t accesses[MRC_MINIATURES] = {};
+    bool too_small = false;
+
+    bool sampled() const
+    {
+        for (uint64_t n : accesses)
+            if (n)
+                return true;
+        return false;
+    }
+
+    double miss_ratio() const
+    {
+        uint64_t m = 0, n = 0;
+        for (int i = 0; i < MRC_MINIATURES; i++)
+        {
+            m += misses[i];
+            n += accesses[i];
+        }
+        return n ? (double)m / n : 0;
+    }
+
+    // Standard error of the mean over the miniatures that saw traffic
+    double std_error() const
+    {
+        double sum = 0, sum_sq = 0;
+        int k = 0;
+        for (int i = 0; i < MRC_MINIATURES; i++)
+        {
+            if (!accesses[i])
+                continue;
+            double r = (double)misses[i] / accesses[i];
+            sum += r;
+            sum_sq += r * r;
+            k++;
+        }
+        if (k < 2)
+            return 0;
+        double var = (sum_sq - sum * sum / k) / (k - 1);
+        return std::sqrt(std::max(0.0, var) / k);
+    }
+};
@@ -0,0 +1,615 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "coalesce_policies.h"
+#include "trace.h"
+
+// ==========================================
+// VARIABLE-SIZE OBJECT CACHE (CDN / KV tiers)
+// ==========================================
+// The L3 model assumes every block is 64 bytes. CDN and KV caches hold
+// objects from a few bytes to megabytes under a byte budget, where one
+// large object can displace thousands of small ones and "hit ratio" splits
+// into object hit ratio (request latency) and byte hit ratio (backend
+// bandwidth).
+//
+// Trace mapping: addr = object id, size = object size in bytes, pc = the
+// request class (URL pattern, API endpoint, table), state/sharers = cost
+// hints exactly as in coalesce::Cache.
+//
+// Objects live in dense slots owned by the simulator, so policies keep their
+// own per-object state in plain vectors indexed by slot and never need a
+// second hash map. Every policy is O(log n) or better per request.
+
+const int OBJ_SAMPLE_SIZE = 64;                   // Eviction candidates sampled by the learned policy
+const int OBJ_GHOST_CAPACITY = 1 << 18;           // Evicted objects remembered for training
+const int ADAPTSIZE_INTERVAL = 250000;            // Requests between AdaptSize re-tunings
+const double ADAPTSIZE_EWMA = 0.3;                // Weight of the newest interval in request rates
+const size_t ADAPTSIZE_MODEL_OBJECTS = 4096;      // Objects sampled when evaluating the model
+
+struct CachedObject
+{
+    uint64_t key = 0;
+    uint32_t size = 0;
+    uint64_t pc = 0;
+    int sharers = 0;
+    MESI_State state = INVALID;
+    uint64_t last_access = 0;
+    uint32_t requests = 0;
+};
+
+// Cost of refetching an object, same rule as the L3 eviction penalty
+inline int object_cost(const CachedObject &o)
+{
+    return LATENCY_DRAM + ((o.state == MODIFIED || o.sharers > 1) ? LATENCY_COHERENCE_PENALTY : 0);
+}
+
+// log2 bucket of the object size: 0 = 1B, 20 = 1MB, capped at 31
+inline int size_class(uint32_t size)
+{
+    return size ? std::min(31, 63 - __builtin_clzll(size)) : 0;
+}
+
+// ==========================================
+// ABSTRACT OBJECT POLICY
+// ==========================================
+class ObjectPolicy
+{
+public:
+    // Every request, before the lookup. Lets policies keep request statistics
+    // and ghost history for objects that are not cached.
+    virtual void on_request(const CachedObject &req) {}
+    // A missed object fits: should it be cached at all?
+    virtual bool admit(const CachedObject &req) { return true; }
+    virtual void on_insert(int slot, const CachedObject &obj) = 0;
+    virtual void on_hit(int slot, const CachedObject &obj) = 0;
+    virtual int victim(const std::vector<CachedObject> &objects) = 0;
+    virtual void on_evict(int slot, const CachedObject &obj) = 0;
+    virtual std::string name() = 0;
+    virtual ~ObjectPolicy() {}
+};
+
+// ==========================================
+// OBJECT POLICY 1: LRU (Baseline)
+// ==========================================
+class ObjectLRU : public ObjectPolicy
+{
+protected:
+    NodeLists links;
+    NodeLists::List order; // Head = MRU
+
+    void ensure(int slot)
+    {
+        if ((size_t)slot >= links.prev.size())
+        {
+            size_t n = std::max<size_t>(slot + 1, links.prev.size() * 2);
+            links.prev.resize(n, -1);
+            links.next.resize(n, -1);
+        }
+    }
+
+public:
+    void on_insert(int slot, const CachedObject &obj) override
+    {
+        ensure(slot);
+        links.push_front(order, slot);
+    }
+
+    void on_hit(int slot, const CachedObject &obj) override
+    {
+        links.remove(order, slot);
+        links.push_front(order, slot);
+    }
+
+    int victim(const std::vector<CachedObject> &objects) override { return order.tail; }
+    void on_evict(int slot, const CachedObject &obj) override { links.remove(order, slot); }
+    std::string name() override { return "LRU"; }
+};
+
+// ==========================================
+// OBJECT POLICY 2: GDSF (GreedyDual-Size-Frequency)
+// ==========================================
+// priority = L + frequency * cost / size, evict the minimum and raise the
+// inflation value L to it, so objects that stop being requested age out.
+// Indexed binary min-heap over slots: O(log n) insert, update and evict.
+class ObjectGDSF : public ObjectPolicy
+{
+    std::vector<int> heap;        // Slots, heap-ordered by priority
+    std::vector<int> pos;         // [slot] -> index in heap, -1 if absent
+    std::vector<double> priority; // [slot]
+    double inflation = 0;
+
+    bool less(int a, int b) const { return priority[heap[a]] < priority[heap[b]]; }
+
+    void swap_at(int a, int b)
+    {
+        std::swap(heap[a], heap[b]);
+        pos[heap[a]] = a;
+        pos[heap[b]] = b;
+    }
+
+    void sift_up(int i)
+    {
+        while (i > 0 && less(i, (i - 1) / 2))
+        {
+            swap_at(i, (i - 1) / 2);
+            i = (i - 1) / 2;
+        }
+    }
+
+    void sift_down(int i)
+    {
+        int n = (int)heap.size();
+        while (true)
+        {
+            int l = 2 * i + 1, r = l + 1, m = i;
+            if (l < n && less(l, m))
+                m = l;
+            if (r < n && less(r, m))
+                m = r;
+            if (m == i)
+                return;
+            swap_at(i, m);
+            i = m;
+        }
+    }
+
+    double value(const CachedObject &o) const
+    {
+        return inflation + (double)o.requests * object_cost(o) / std::max<uint32_t>(1, o.size);
+    }
+
+public:
+    void on_insert(int slot, const CachedObject &obj) override
+    {
+        if ((size_t)slot >= pos.size())
+        {
+            pos.resize(slot + 1, -1);
+            priority.resize(slot + 1, 0);
+        }
+        priority[slot] = value(obj);
+        pos[slot] = (int)heap.size();
+        heap.push_back(slot);
+        sift_up(pos[slot]);
+    }
+
+    void on_hit(int slot, const CachedObject &obj) override
+    {
+        // Priority only grows on a hit
+        priority[slot] = value(obj);
+        sift_down(pos[slot]);
+    }
+
+    int victim(const std::vector<CachedObject> &objects) override { return heap.empty() ? -1 : heap[0]; }
+
+    void on_evict(int slot, const CachedObject &obj) override
+    {
+        inflation = std::max(inflation, priority[slot]);
+        int i = pos[slot];
+        int last = (int)heap.size() - 1;
+        if (i != last)
+            swap_at(i, last);
+        heap.pop_back();
+        pos[slot] = -1;
+        if (i < (int)heap.size())
+        {
+            sift_down(i);
+            sift_up(i);
+        }
+    }
+
+    std::string name() override { return "GDSF"; }
+};
+
+// ==========================================
+// OBJECT POLICY 3: AdaptSize
+// ==========================================
+// LRU eviction behind a size-aware admission filter: a missed object is
+// admitted with probability exp(-size / c). Every ADAPTSIZE_INTERVAL
+// requests, c is re-tuned with the paper's Markov model of an LRU cache:
+// for each candidate c, solve for the characteristic time T at which the
+// expected bytes in cache equal the capacity, and keep the c with the best
+// predicted object hit ratio. Berger et al., NSDI'17. The model runs on at
+// most ADAPTSIZE_MODEL_OBJECTS tracked objects against a proportionally
+// scaled capacity, so tuning stays a few operations per request.
+class ObjectAdaptSize : public ObjectLRU
+{
+    struct Rate
+    {
+        double requests = 0;
+        uint32_t size = 0;
+    };
+
+    uint64_t capacity;
+    double c;
+    uint64_t seen = 0;
+    uint64_t rng = 0x2545F4914F6CDD1DULL;
+    std::unordered_map<uint64_t, Rate> interval; // Request rates, smoothed across intervals
+
+    double uniform()
+    {
+        rng ^= rng << 13;
+        rng ^= rng >> 7;
+        rng ^= rng << 17;
+        return (rng >> 11) * (1.0 / 9007199254740992.0);
+    }
+
+    // Probability an object with `rate` requests/interval is cached at characteristic time t
+    static double in_cache(double rate, double t, double admit)
+    {
+        double e = std::expm1(std::min(rate * t, 50.0));
+        return e * admit / (1 + admit * e);
+    }
+
+    // Object hit ratio the model predicts for admission parameter cand, on a
+    // sample of the tracked objects against a proportionally scaled capacity
+    static double predicted_hit_ratio(const std::vector<Rate> &sample, double cap, double cand)
+    {
+        std::vector<double> admit(sample.size());
+        for (size_t i = 0; i < sample.size(); i++)
+            admit[i] = std::exp(-(double)sample[i].size / cand);
+        auto bytes = [&](double t) {
+            double sum = 0;
+            for (size_t i = 0; i < sample.size(); i++)
+                sum += sample[i].size * in_cache(sample[i].requests, t, admit[i]);
+            return sum;
+        };
+
+        // Bisection on T: bytes(T) is monotonic
+        double lo = 0, hi = 1;
+        while (bytes(hi) < cap && hi < 1e12)
+            hi *= 2;
+        for (int it = 0; it < 30; it++)
+        {
+            double mid = (lo + hi) / 2;
+            (bytes(mid) < cap ? lo : hi) = mid;
+        }
+
+        double hit = 0, total = 0;
+        for (size_t i = 0; i < sample.size(); i++)
+        {
+            hit += sample[i].requests * in_cache(sample[i].requests, hi, admit[i]);
+            total += sample[i].requests;
+        }
+        return total > 0 ? hit / total : 0;
+    }
+
+    void retune()
+    {
+        std::vector<Rate> sample;
+        size_t stride = interval.size() / ADAPTSIZE_MODEL_OBJECTS + 1;
+        size_t i = 0;
+        for (const auto &kv : interval)
+            if (i++ % stride == 0)
+                sample.push_back(kv.second);
+        double cap = (double)capacity * sample.size() / std::max<size_t>(1, interval.size());
+
+        double best_ohr = -1;
+        for (double cand = 64; cand <= (double)capacity; cand *= 2)
+        {
+            double ohr = predicted_hit_ratio(sample, cap, cand);
+            if (ohr > best_ohr)
+            {
+                best_ohr = ohr;
+                c = cand;
+            }
+        }
+
+        // Age the rates; forget objects that have gone quiet
+        for (auto it = interval.begin(); it != interval.end();)
+        {
+            it->second.requests *= (1 - ADAPTSIZE_EWMA);
+            if (it->second.requests < 0.1)
+                it = interval.erase(it);
+            else
+                ++it;
+        }
+    }
+
+public:
+    uint64_t tunings = 0;
+
+    explicit ObjectAdaptSize(uint64_t capacity_bytes) : capacity(capacity_bytes), c((double)capacity_bytes / 1024) {}
+
+    void on_request(const CachedObject &req) override
+    {
+        Rate &r = interval[req.key];
+        r.requests += ADAPTSIZE_EWMA;
+        r.size = req.size;
+        if (++seen % ADAPTSIZE_INTERVAL == 0)
+        {
+            retune();
+            tunings++;
+        }
+    }
+
+    bool admit(const CachedObject &req) override { return uniform() < std::exp(-(double)req.size / c); }
+
+    double admission_parameter() const { return c; }
+
+    std::string name() override { return "AdaptSize"; }
+};
+
+// ==========================================
+// OBJECT POLICY 4: COALESCE-Size (Learned)
+// ==========================================
+// The L3 PerceptronBrain with the log2 size class in the slot the L3 uses
+// for the sharer count: table0 learns reuse per (request class, cost),
+// table1 per (request class, size class). Eviction samples OBJ_SAMPLE_SIZE
+// resident objects, as LRB does, and removes the one with the lowest vote
+// after the same cost veto COALESCE applies; ties go to the least
+// requested, then least recently used. Sampling alone rarely finds the handful of huge objects among many
+// small ones, so a negative vote on a miss also bypasses the cache.
+//
+// Ground truth is delayed, like the L3 ghost buffer: hits and re-requests
+// of recently evicted or bypassed objects train positive, and ghosts that
+// age out of the ring unrequested train negative.
+class ObjectCOALESCE : public ObjectPolicy
+{
+    struct Ghost
+    {
+        uint64_t key = 0;
+        uint64_t pc = 0;
+        int size_cls = 0;
+        MESI_State state = INVALID;
+        bool live = false;
+    };
+
+    PerceptronBrain brain;
+    std::vector<int> resident; // Dense list of cached slots, for sampling
+    std::vector<int> where;    // [slot] -> index in resident
+    std::vector<Ghost> ghosts;
+    std::unordered_map<uint64_t, int> ghost_index;
+    int ghost_head = 0;
+    uint64_t rng = 0x9E3779B97F4A7C15ULL;
+
+    uint64_t next_random()
+    {
+        rng ^= rng << 13;
+        rng ^= rng >> 7;
+        rng ^= rng << 17;
+        return rng;
+    }
+
+    void train(uint64_t pc, int size_cls, MESI_State state, bool positive, int repeat = 1)
+    {
+        int vote = brain.predict_raw(pc, size_cls, state);
+        for (int k = 0; k < repeat; k++)
+            brain.train(pc, size_cls, state, positive, vote);
+    }
+
+    void remember(const CachedObject &obj)
+    {
+        // Oldest ghost never came back: it really was dead
+        Ghost &g = ghosts[ghost_head];
+        if (g.live)
+        {
+            train(g.pc, g.size_cls, g.state, false);
+            ghost_index.erase(g.key);
+        }
+        g = {obj.key, obj.pc, size_class(obj.size), obj.state, true};
+        ghost_index[obj.key] = ghost_head;
+        ghost_head = (ghost_head + 1) % OBJ_GHOST_CAPACITY;
+    }
+
+    // Tie-break between equal votes: fewer requests, then least recently used
+    static bool older(const CachedObject &a, const CachedObject &b)
+    {
+        return a.requests != b.requests ? a.requests < b.requests : a.last_access < b.last_access;
+    }
+
+    int score(const CachedObject &o)
+    {
+        int raw = brain.predict_raw(o.pc, size_class(o.size), o.state);
+        int vote = raw;
+        if (raw > VETO_OVERRIDE)
+        {
+            if (o.state == MODIFIED)
+                vote += 150;
+            if (o.sharers >= 2)
+                vote += 75;
+        }
+        return vote;
+    }
+
+public:
+    uint64_t ghost_hits = 0;
+
+    ObjectCOALESCE() : ghosts(OBJ_GHOST_CAPACITY) {}
+
+    void on_request(const CachedObject &req) override
+    {
+        auto it = ghost_index.find(req.key);
+        if (it == ghost_index.end())
+            return;
+        // Evicted too early: confirmed mistake, same 5x reinforcement as the L3
+        Ghost &g = ghosts[it->second];
+        train(g.pc, g.size_cls, g.state, true, 5);
+        g.live = false;
+        ghost_index.erase(it);
+        ghost_hits++;
+    }
+
+    bool admit(const CachedObject &req) override
+    {
+        if (score(req) >= 0)
+            return true;
+        remember(req); // A re-request proves the bypass wrong
+        return false;
+    }
+
+    void on_insert(int slot, const CachedObject &obj) override
+    {
+        if ((size_t)slot >= where.size())
+            where.resize(slot + 1, -1);
+        where[slot] = (int)resident.size();
+        resident.push_back(slot);
+    }
+
+    void on_hit(int slot, const CachedObject &obj) override
+    {
+        train(obj.pc, size_class(obj.size), obj.state, true);
+    }
+
+    int victim(const std::vector<CachedObject> &objects) override
+    {
+        if (resident.empty())
+            return -1;
+        int best = -1, best_vote = 0;
+        int samples = std::min<int>(OBJ_SAMPLE_SIZE, (int)resident.size());
+        for (int i = 0; i < samples; i++)
+        {
+            int slot = resident[next_random() % resident.size()];
+            const CachedObject &o = objects[slot];
+            int vote = score(o);
+            if (best < 0 || vote < best_vote || (vote == best_vote && older(o, objects[best])))
+            {
+                best = slot;
+                best_vote = vote;
+            }
+        }
+        return best;
+    }
+
+    void on_evict(int slot, const CachedObject &obj) override
+    {
+        int i = where[slot];
+        where[resident.back()] = i;
+        resident[i] = resident.back();
+        resident.pop_back();
+        where[slot] = -1;
+        remember(obj);
+    }
+
+    std::string name() override { return "COALESCE-Size"; }
+};
+
+// ==========================================
+// OBJECT CACHE SIMULATOR
+// ==========================================
+class ObjectCacheSimulator
+{
+    ObjectPolicy *policy;
+    uint64_t capacity;
+    uint64_t used = 0;
+    uint64_t clock = 0;
+
+    std::unordered_map<uint64_t, int> index; // Object id -> slot
+    std::vector<CachedObject> objects;       // [slot]
+    std::vector<int> free_slots;
+
+    void evict(int slot)
+    {
+        CachedObject &o = objects[slot];
+        policy->on_evict(slot, o);
+        used -= o.size;
+        index.erase(o.key);
+        free_slots.push_back(slot);
+        evictions++;
+    }
+
+public:
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t bytes_hit = 0;
+    uint64_t bytes_missed = 0;
+    uint64_t evictions = 0;
+    uint64_t not_admitted = 0; // Too large, or rejected by the policy
+    uint64_t total_latency = 0;
+
+    ObjectCacheSimulator(ObjectPolicy *p, uint64_t capacity_bytes) : policy(p), capacity(capacity_bytes) {}
+
+    void access(uint64_t key, uint32_t size, uint64_t pc, int sharers, MESI_State state)
+    {
+        CachedObject req;
+        req.key = key;
+        req.size = std::max<uint32_t>(1, size);
+        req.pc = pc;
+        req.sharers = sharers;
+        req.state = state;
+        req.last_access = ++clock;
+        policy->on_request(req);
+
+        auto it = index.find(key);
+        if (it != index.end())
+        {
+            CachedObject &o = objects[it->second];
+            if (o.size == req.size)
+            {
+                hits++;
+                bytes_hit += o.size;
+                total_latency += LATENCY_L3_HIT;
+                o.pc = pc;
+                o.sharers = sharers;
+                o.state = state;
+                o.last_access = clock;
+                o.requests++;
+                policy->on_hit(it->second, o);
+                return;
+            }
+            // The object changed size (new version): refetch it
+            evict(it->second);
+        }
+
+        misses++;
+        bytes_missed += req.size;
+        total_latency += object_cost(req);
+
+        if (req.size > capacity || !policy->admit(req))
+        {
+            not_admitted++;
+            return;
+        }
+        while (used + req.size > capacity)
+        {
+            int v = policy->victim(objects);
+            if (v < 0)
+                break;
+            evict(v);
+        }
+
+        int slot;
+        if (!free_slots.empty())
+        {
+            slot = free_slots.back();
+            free_slots.pop_back();
+        }
+        else
+        {
+            slot = (int)objects.size();
+            objects.emplace_back();
+        }
+        req.requests = 1;
+        objects[slot] = req;
+        index[key] = slot;
+        used += req.size;
+        policy->on_insert(slot, objects[slot]);
+    }
+
+    void access_batch(const TraceRecord *recs, size_t n)
+    {
+        for (size_t i = 0; i < n; i++)
+        {
+            const TraceRecord &r = recs[i];
+            access(r.addr, r.size, r.pc, r.sharers, (MESI_State)(r.flags & TRACE_FLAG_STATE_MASK));
+        }
+    }
+
+    void print_stats()
+    {
+        uint64_t requests = hits + misses;
+        std::cout << std::left << std::setw(20) << policy->name() << " | Hit Rate: " << std::fixed
+                  << std::setprecision(2) << std::setw(6) << 100.0 * hits / std::max<uint64_t>(1, requests) << "%"
+                  << " | Byte Hit Rate: " << std::setw(6)
+                  << 100.0 * bytes_hit / std::max<uint64_t>(1, bytes_hit + bytes_missed) << "%"
+                  << " | Backend: " << std::setprecision(1) << bytes_missed / 1048576.0 << " MB"
+                  << " | Objects: " << index.size() << " | Not admitted: " << not_admitted << "\n";
+    }
+};
@@ -0,0 +1,239 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <cerrno>
+#include <cstdio>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "trace_summary.h"
+
+// ==========================================
+// RESULT CACHE (--result-cache)
+// ==========================================
+// Nightly evaluations re-run the same (trace, policy, parameters) tuples.
+// Every simulation that reaches a clean end-of-stream is stored under a hash
+// of three things, and a later run with the same hash prints the stored
+// stats instead of simulating:
+//
+//   engine        - the running executable's contents, so a rebuilt engine
+//                   (new policy code, a fixed bug) never reuses old results
+//   trace         - block-index checksums: the file hashed in
+//                   RESULT_BLOCK_BYTES blocks, then the block hashes in
+//                   order. Remembered per (path, size, mtime, inode), so an
+//                   unchanged file is read once, not on every run
+//   configuration - only what changes that one simulation: its policy and
+//                   knobs, geometry, admission, eager mode, memory tiers,
+//                   and the RL weights for RL alone. Other policies in the
+//                   list, --threads and --batch are left out, so
+//                   `--policy=lru,coalesce` after `--policy=lru` simulates
+//                   only COALESCE
+//
+// Entries are small files in DIR, written to a temporary name and renamed.
+// Each holds its full configuration string, which is compared on lookup, so
+// a hash collision can't hand back another run's stats. Only regular trace
+// files are cached: a stream can't be hashed before it is consumed.
+const uint64_t RESULT_BLOCK_BYTES = 64ULL << 20;
+const char *const RESULT_CACHE_MAGIC = "coalesce-result 1";
+
+// Word-at-a-time hash of a buffer, chained from `seed`
+inline uint64_t buffer_hash(const char *p, size_t n, uint64_t seed)
+{
+    uint64_t h = summary_hash(seed ^ n);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        uint64_t w;
+        memcpy(&w, p + i, 8);
+        h = summary_hash(h ^ w);
+    }
+    uint64_t tail = 0;
+    memcpy(&tail, p + i, n - i);
+    return summary_hash(h ^ tail);
+}
+
+inline std::string hex64(uint64_t v)
+{
+    std::ostringstream s;
+    s << std::hex << std::setw(16) << std::setfill('0') << v;
+    return s.str();
+}
+
+// Everything stored for one simulation
+struct CachedResult
+{
+    uint64_t records = 0;         // Trace records simulated
+    std::vector<uint64_t> values; // Counters the caller reads back
+    std::string text;             // Stats as printed
+};
+
+class ResultCache
+{
+    std::string dir;
+    uint64_t engine = 0;
+    uint64_t trace = 0;
+
+    bool fail(const std::string &msg)
+    {
+        error = msg;
+        return false;
+    }
+
+    static bool make_dirs(const std::string &path)
+    {
+        for (size_t pos = 1; pos <= path.size(); pos++)
+            if (pos == path.size() || path[pos] == '/')
+            {
+                std::string prefix = path.substr(0, pos);
+                if (mkdir(prefix.c_str(), 0755) != 0 && errno != EEXIST)
+                    return false;
+            }
+        return true;
+    }
+
+    // Block-index checksum of a regular file, remembered in DIR/files under
+    // the file's identity so it is only computed again when the file changes
+    bool file_hash(const std::string &path, uint64_t &hash)
+    {
+        struct stat st;
+        if (stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode))
+            return fail(path + " is not a regular file");
+        std::ostringstream identity;
+        identity << path << " " << st.st_size << " " << st.st_mtim.tv_sec << "." << st.st_mtim.tv_nsec << " "
+                 << st.st_ino << " " << st.st_dev;
+        std::string id = identity.str();
+        std::string memo = dir + "/files/" + hex64(buffer_hash(id.data(), id.size(), 0));
+
+        std::ifstream in(memo);
+        std::string saved_id, saved_hash;
+        if (std::getline(in, saved_id) && std::getline(in, saved_hash) && saved_id == id)
+        {
+            hash = strtoull(saved_hash.c_str(), nullptr, 16);
+            return true;
+        }
+
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return fail("cannot open " + path + ": " + strerror(errno));
+#ifdef POSIX_FADV_SEQUENTIAL
+        posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+        std::vector<char> block(RESULT_BLOCK_BYTES);
+        hash = summary_hash(st.st_size);
+        for (uint64_t index = 0;; index++)
+        {
+            size_t got = 0;
+            while (got < block.size())
+            {
+                ssize_t n = ::read(fd, block.data() + got, block.size() - got);
+                if (n < 0 && errno == EINTR)
+                    continue;
+                if (n <= 0)
+                    break;
+                got += n;
+            }
+            if (got == 0)
+                break;
+            hash = summary_hash(hash ^ buffer_hash(block.data(), got, index));
+        }
+        ::close(fd);
+
+        write_atomic(memo, id + "\n" + hex64(hash) + "\n");
+        return true;
+    }
+
+    bool write_atomic(const std::string &path, const std::string &data)
+    {
+        std::string tmp = path + ".tmp" + std::to_string(getpid());
+        {
+            std::ofstream out(tmp, std::ios::binary);
+            if (!(out << data))
+                return false;
+        }
+        return rename(tmp.c_str(), path.c_str()) == 0;
+    }
+
+    std::string entry_path(const std::string &config) const
+    {
+        uint64_t h = summary_hash(summary_hash(engine) ^ trace);
+        return dir + "/" + hex64(buffer_hash(config.data(), config.size(), h)) + ".result";
+    }
+
+public:
+    std::string error;
+    uint64_t hits = 0;
+    uint64_t stored = 0;
+
+    // False (with `error`) when results for `trace_path` can't be cached
+    bool open(const std::string &directory, const std::string &trace_path)
+    {
+        dir = directory;
+        if (!make_dirs(dir + "/files"))
+            return fail("cannot create " + dir + ": " + strerror(errno));
+        char exe[4096];
+        ssize_t n = readlink("/proc/self/exe", exe, sizeof(exe) - 1);
+        if (n <= 0)
+            return fail("cannot locate the engine executable");
+        exe[n] = 0;
+        return file_hash(exe, engine) && file_hash(trace_path, trace);
+    }
+
+    // Content hash of another input, e.g. an RL weights file, for a config
+    std::string input_hash(const std::string &path)
+    {
+        uint64_t h = 0;
+        return file_hash(path, h) ? hex64(h) : "unhashable:" + path;
+    }
+
+    bool lookup(const std::string &config, CachedResult &out)
+    {
+        std::ifstream in(entry_path(config), std::ios::binary);
+        std::string magic, key, field;
+        size_t count = 0, text_bytes = 0;
+        if (!std::getline(in, magic) || magic != RESULT_CACHE_MAGIC || !std::getline(in, key) || key != config)
+            return false;
+        CachedResult r;
+        if (!(in >> field >> r.records) || field != "records" || !(in >> field >> count) || field != "values")
+            return false;
+        r.values.resize(count);
+        for (uint64_t &v : r.values)
+            in >> v;
+        if (!(in >> field >> text_bytes) || field != "text" || in.get() != '\n')
+            return false;
+        r.text.resize(text_bytes);
+        if (!in.read(&r.text[0], text_bytes))
+            return false;
+        out = r;
+        hits++;
+        return true;
+    }
+
+    void print(std::ostream &out, size_t reused, size_t total) const
+    {
+        out << "Result cache: " << reused << " of " << total << " policies from " << dir;
+        if (stored)
+            out << ", " << stored << " stored";
+        out << "\n";
+    }
+
+    void store(const std::string &config, const CachedResult &result)
+    {
+        std::ostringstream out;
+        out << RESULT_CACHE_MAGIC << "\n" << config << "\nrecords " << result.records << "\nvalues "
+            << result.values.size();
+        for (uint64_t v : result.values)
+            out << " " << v;
+        out << "\ntext " << result.text.size() << "\n" << result.text;
+        if (write_atomic(entry_path(config), out.str()))
+            stored++;
+    }
+};
@@ -0,0 +1,456 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "coalesce_policies.h"
+
+// ==========================================
+// ONLINE RL EVICTION AGENT
+// ==========================================
+// old/rl_cache_sim.cpp was a one-step bandit on a 128-entry double table:
+// no discounting, no penalty for evicting something that comes back. This
+// is the full version, sized for the main engine:
+//
+//   state   - hashed features of a line at its last access:
+//             PC, (PC, MESI), (PC, sharers), (PC, hits so far)
+//   value   - V(s) = expected discounted future reuse, a linear function
+//             over those one-hot features in Q8.8 fixed point (int16
+//             weights, 4 lookups per line)
+//   action  - evict the line with the lowest V; among equals, the newest
+//             one, so a set of look-alike lines holds on to what it has
+//             instead of cycling like LRU. 1 in 64 decisions explore at
+//             random
+//   reward  - delayed, from ground truth: a hit or a ghost-buffer hit
+//             closes the line's segment with reward = refill cost and
+//             bootstraps on the new state (TD(0)); a ghost that ages out
+//             unreferenced closes it with 0 (terminal)
+//   learner - experiences go to a ring-buffer replay; every
+//             RL_TRAIN_INTERVAL experiences a mini-batch of RL_BATCH is
+//             sampled and applied as one accumulated update
+//
+// Experiences leave the policy through ExperienceSink and weights come in as
+// a shared RLValueFunction, so acting and learning can live on different
+// threads. By default every RL_Policy owns a ReplayLearner and learns
+// online.
+const int RL_FEATURES = 4;
+const int RL_TABLE_SIZE = 1024;            // Weights per feature
+const int RL_ONE = 256;                    // 1.0 in Q8.8
+const double RL_GAMMA = 0.9;               // Discount per RL_TIME_SCALE accesses to the set
+const int RL_TIME_SCALE = 16;
+const int RL_REPLAY_SIZE = 4096;           // Experiences kept for replay
+const int RL_BATCH = 32;                   // Experiences per mini-batch
+const int RL_TRAIN_INTERVAL = 64;          // New experiences between mini-batches
+const int RL_LR_SHIFT = 4;                 // Per-feature step = TD error >> 4
+const int RL_EXPLORE_MASK = 63;            // Explore 1 in 64 decisions
+const int RL_INIT_WEIGHT = RL_ONE / 8;     // V starts at 0.5 everywhere: ages decide, i.e. LRU
+
+struct RLExperience
+{
+    uint16_t features[RL_FEATURES];
+    uint16_t next[RL_FEATURES];
+    int16_t reward;    // Q8.8
+    uint16_t discount; // Q8.8, gamma^(elapsed time)
+    bool terminal;
+};
+
+// ==========================================
+// VALUE FUNCTION (Fixed-Point Linear)
+// ==========================================
+class RLValueFunction
+{
+    std::vector<int16_t> weights; // [feature * RL_TABLE_SIZE + bucket], features pre-offset
+    std::vector<int32_t> grad;    // Scratch for train(), all zero between calls
+    std::vector<int32_t> hits;
+
+public:
+    uint64_t updates = 0;
+
+    RLValueFunction()
+        : weights(RL_FEATURES * RL_TABLE_SIZE, RL_INIT_WEIGHT), grad(RL_FEATURES * RL_TABLE_SIZE, 0),
+          hits(RL_FEATURES * RL_TABLE_SIZE, 0)
+    {
+    }
+
+    void reset()
+    {
+        std::fill(weights.begin(), weights.end(), RL_INIT_WEIGHT);
+        updates = 0;
+    }
+
+    int value(const uint16_t *features) const
+    {
+        int v = 0;
+        for (int f = 0; f < RL_FEATURES; f++)
+            v += weights[features[f]];
+        return v;
+    }
+
+    // TD(0) target in Q8.8
+    int target(const RLExperience &e) const
+    {
+        if (e.terminal)
+            return e.reward;
+        return (e.discount * (e.reward + value(e.next))) >> 8;
+    }
+
+    // One step for the whole batch. TD errors are all computed against the
+    // same weights; each weight then moves by the mean error of the samples
+    // that touch it, so rare PCs learn as fast as common ones.
+    void train(const RLExperience *batch, int n)
+    {
+        uint16_t touched[RL_BATCH * RL_FEATURES];
+        int k = 0;
+        n = std::min(n, RL_BATCH);
+        for (int i = 0; i < n; i++)
+        {
+            int err = target(batch[i]) - value(batch[i].features);
+            for (int f = 0; f < RL_FEATURES; f++)
+            {
+                uint16_t idx = batch[i].features[f];
+                if (hits[idx]++ == 0)
+                    touched[k++] = idx;
+                grad[idx] += err;
+            }
+        }
+        for (int j = 0; j < k; j++)
+        {
+            uint16_t idx = touched[j];
+            int w = weights[idx] + (grad[idx] / hits[idx]) / (1 << RL_LR_SHIFT);
+            weights[idx] = (int16_t)std::max(-32768, std::min(32767, w));
+            grad[idx] = 0;
+            hits[idx] = 0;
+        }
+        updates++;
+    }
+
+    void checkpoint(StateArchive &a) { a.io(weights, updates); }
+
+    // Raw Q8.8 weights, so a model trained by --train-rl can seed later runs
+    bool save(const std::string &path) const
+    {
+        std::ofstream out(path, std::ios::binary);
+        uint32_t count = (uint32_t)weights.size();
+        out.write("CRLW", 4);
+        out.write((const char *)&count, sizeof(count));
+        out.write((const char *)weights.data(), count * sizeof(int16_t));
+        return (bool)out;
+    }
+
+    bool load(const std::string &path)
+    {
+        std::ifstream in(path, std::ios::binary);
+        char magic[4];
+        uint32_t count = 0;
+        if (!in.read(magic, 4) || std::string(magic, 4) != "CRLW" || !in.read((char *)&count, sizeof(count)) ||
+            count != weights.size())
+            return false;
+        return (bool)in.read((char *)weights.data(), count * sizeof(int16_t));
+    }
+};
+
+// ==========================================
+// EXPERIENCE SINK + REPLAY LEARNER
+// ==========================================
+class ExperienceSink
+{
+public:
+    virtual void push(const RLExperience &e) = 0;
+    virtual ~ExperienceSink() {}
+};
+
+// Ring buffer of recent experiences, trained from in random mini-batches so
+// consecutive (highly correlated) evictions don't dominate an update
+class ReplayLearner : public ExperienceSink
+{
+    std::vector<RLExperience> ring;
+    uint64_t pushed = 0;
+    uint64_t rng = 0x853C49E6748FEA9BULL;
+    std::shared_ptr<RLValueFunction> model;
+
+public:
+    explicit ReplayLearner(std::shared_ptr<RLValueFunction> m, int capacity = RL_REPLAY_SIZE)
+        : ring(capacity), model(std::move(m))
+    {
+    }
+
+    void reset()
+    {
+        std::fill(ring.begin(), ring.end(), RLExperience());
+        pushed = 0;
+        rng = 0x853C49E6748FEA9BULL;
+    }
+
+    void push(const RLExperience &e) override
+    {
+        ring[pushed % ring.size()] = e;
+        if (++pushed % RL_TRAIN_INTERVAL == 0)
+            train_batch();
+    }
+
+    void train_batch()
+    {
+        size_t filled = std::min<uint64_t>(pushed, ring.size());
+        if (filled == 0)
+            return;
+        RLExperience batch[RL_BATCH];
+        for (int i = 0; i < RL_BATCH; i++)
+        {
+            rng ^= rng << 13;
+            rng ^= rng >> 7;
+            rng ^= rng << 17;
+            batch[i] = ring[rng % filled];
+        }
+        model->train(batch, RL_BATCH);
+    }
+
+    uint64_t experiences() const { return pushed; }
+
+    // The model is saved by whoever owns it
+    void checkpoint(StateArchive &a) { a.io(ring, pushed, rng); }
+};
+
+// ==========================================
+// POLICY 9: RL (Online TD Agent)
+// ==========================================
+class RL_Policy : public ReplacementPolicy
+{
+    struct LineState
+    {
+        uint16_t features[RL_FEATURES] = {};
+        uint64_t last_access = 0;
+        uint8_t hits = 0;
+        int16_t reward = RL_ONE; // Refill cost of this line, the reward if it is reused
+    };
+
+    struct Ghost
+    {
+        uint64_t tag = 0;
+        LineState line;
+        bool live = false;
+    };
+
+    std::shared_ptr<RLValueFunction> owned_model;
+    std::unique_ptr<ReplayLearner> owned_learner;
+    std::shared_ptr<const RLValueFunction> model;
+    ExperienceSink *sink;
+
+    std::vector<LineState> lines; // [set * ways + way]
+    std::vector<Ghost> ghosts;    // Ring of recent evictions, as many as there are lines
+    std::unordered_map<uint64_t, int> ghost_index;
+    size_t ghost_head = 0;
+    uint16_t discount_by_log2[64];
+
+    uint64_t now = 0; // Accesses seen by this policy
+    uint64_t rng = 0x2545F4914F6CDD1DULL;
+    int incoming_sharers = 0;
+    MESI_State incoming_state = INVALID;
+
+    static uint16_t hash(uint64_t x, int feature)
+    {
+        x ^= x >> 29;
+        x *= 0xBF58476D1CE4E5B9ULL;
+        x ^= x >> 32;
+        return (uint16_t)(feature * RL_TABLE_SIZE + x % RL_TABLE_SIZE);
+    }
+
+    // Lines only keep a PC signature, so features hash that, on hits and misses alike
+    void snapshot(LineState &s, uint64_t pc, int sharers, MESI_State state, int hits)
+    {
+        pc &= PC_SIGNATURE_MASK;
+        s.features[0] = hash(pc, 0);
+        s.features[1] = hash(pc * 4 + state, 1);
+        s.features[2] = hash(pc * 8 + std::min(sharers, 7), 2);
+        s.features[3] = hash(pc * 4 + std::min(hits, 3), 3);
+        s.hits = (uint8_t)std::min(hits, 255);
+        s.last_access = now;
+        bool expensive = state == MODIFIED || sharers > 1;
+        s.reward = (int16_t)(RL_ONE * (LATENCY_DRAM + (expensive ? LATENCY_COHERENCE_PENALTY : 0)) / LATENCY_DRAM);
+    }
+
+    // gamma^(elapsed / RL_TIME_SCALE), elapsed in accesses to one set
+    uint16_t discount(uint64_t since) const
+    {
+        uint64_t per_set = (now - since) / std::max(1, num_sets);
+        return discount_by_log2[63 - __builtin_clzll(per_set + 1)];
+    }
+
+    void emit(const LineState &from, const LineState *to, int reward, uint64_t since)
+    {
+        RLExperience e;
+        std::copy(from.features, from.features + RL_FEATURES, e.features);
+        if (to)
+            std::copy(to->features, to->features + RL_FEATURES, e.next);
+        e.reward = (int16_t)reward;
+        e.discount = discount(since);
+        e.terminal = to == nullptr;
+        sink->push(e);
+        experiences++;
+    }
+
+public:
+    uint64_t experiences = 0;
+    uint64_t decisions = 0;
+
+    RL_Policy(int sets = NUM_SETS, int assoc = WAYS)
+        : ReplacementPolicy(sets, assoc), owned_model(std::make_shared<RLValueFunction>()),
+          owned_learner(std::make_unique<ReplayLearner>(owned_model)), model(owned_model),
+          sink(owned_learner.get()), lines((size_t)sets * assoc), ghosts((size_t)sets * assoc)
+    {
+        for (int b = 0; b < 64; b++)
+        {
+            double elapsed = b < 62 ? (double)(1ULL << b) : 1e18;
+            discount_by_log2[b] = (uint16_t)(RL_ONE * std::pow(RL_GAMMA, elapsed / RL_TIME_SCALE) + 0.5);
+        }
+    }
+
+    // Online mode starts learning over from the initial weights; actor mode
+    // keeps whatever weights were last attached
+    void reset() override
+    {
+        if (owned_model)
+        {
+            owned_model->reset();
+            owned_learner->reset();
+        }
+        std::fill(lines.begin(), lines.end(), LineState());
+        std::fill(ghosts.begin(), ghosts.end(), Ghost());
+        ghost_index.clear();
+        ghost_head = 0;
+        now = 0;
+        rng = 0x2545F4914F6CDD1DULL;
+        incoming_sharers = 0;
+        incoming_state = INVALID;
+        experiences = decisions = 0;
+    }
+
+    // Actor mode: experiences go to `out`, decisions use `weights`, nothing
+    // is learned locally. Call set_weights() again whenever newer weights are
+    // published.
+    void attach(ExperienceSink *out, std::shared_ptr<const RLValueFunction> weights)
+    {
+        sink = out;
+        model = std::move(weights);
+        owned_learner.reset();
+        owned_model.reset();
+    }
+
+    void set_weights(std::shared_ptr<const RLValueFunction> weights) { model = std::move(weights); }
+
+    // Start from pre-trained weights but keep learning online
+    void load_weights(const RLValueFunction &weights)
+    {
+        if (owned_model)
+            *owned_model = weights;
+        else
+            model = std::make_shared<const RLValueFunction>(weights);
+    }
+
+    const RLValueFunction &value_function() const { return *model; }
+
+    // Online mode only: an actor's weights and experiences live in the trainer
+    void checkpoint(StateArchive &a) override
+    {
+        if (!owned_model)
+        {
+            a.fail("an RL actor cannot be checkpointed");
+            return;
+        }
+        a.io(*owned_model, *owned_learner, lines, ghosts, ghost_index, ghost_head, now, rng, incoming_sharers,
+             incoming_state, experiences, decisions);
+    }
+
+    void update_on_hit(int set_idx, int way, const CacheLine &line) override
+    {
+        now++;
+        LineState &s = lines[(size_t)set_idx * ways + way];
+        LineState next;
+        snapshot(next, line.pc, line.sharers, line.state, s.hits + 1);
+        emit(s, &next, s.reward, s.last_access);
+        s = next;
+    }
+
+    int find_victim(int set_idx, const CacheLine *set, uint64_t pc, int sharers, MESI_State state) override
+    {
+        incoming_sharers = sharers;
+        incoming_state = state;
+        decisions++;
+        return choose_victim(set_idx, set, rng);
+    }
+
+    // Same pick from a copy of the exploration RNG, which find_victim then
+    // draws again
+    int peek_victim(int set_idx, const CacheLine *set, uint64_t tag, uint64_t pc, int sharers,
+                    MESI_State state) override
+    {
+        uint64_t r = rng;
+        return choose_victim(set_idx, set, r);
+    }
+
+    int choose_victim(int set_idx, const CacheLine *set, uint64_t &r) const
+    {
+        for (int w = 0; w < ways; w++)
+            if (!set[w].valid)
+                return w;
+
+        r ^= r << 13;
+        r ^= r >> 7;
+        r ^= r << 17;
+        if ((r & RL_EXPLORE_MASK) == 0)
+            return (int)((r >> 8) % ways);
+
+        int victim = 0;
+        int best = 0;
+        const LineState *base = &lines[(size_t)set_idx * ways];
+        for (int w = 0; w < ways; w++)
+        {
+            int score = model->value(base[w].features);
+            if (w == 0 || score < best || (score == best && base[w].last_access > base[victim].last_access))
+            {
+                best = score;
+                victim = w;
+            }
+        }
+        return victim;
+    }
+
+    void on_evict(int set_idx, int way, const CacheLine &victim) override
+    {
+        Ghost &g = ghosts[ghost_head];
+        if (g.live)
+        {
+            // Never came back while remembered: terminal, no reward
+            emit(g.line, nullptr, 0, g.line.last_access);
+            ghost_index.erase(g.tag);
+        }
+        g.tag = victim.tag;
+        g.line = lines[(size_t)set_idx * ways + way];
+        g.live = true;
+        ghost_index[victim.tag] = (int)ghost_head;
+        ghost_head = (ghost_head + 1) % ghosts.size();
+    }
+
+    void update_on_miss(int set_idx, int way, uint64_t pc, uint64_t tag) override
+    {
+        now++;
+        LineState &s = lines[(size_t)set_idx * ways + way];
+        snapshot(s, pc, incoming_sharers, incoming_state, 0);
+
+        auto it = ghost_index.find(tag);
+        if (it != ghost_index.end())
+        {
+            // Evicted, then needed again: the reuse it was denied is its reward
+            Ghost &g = ghosts[it->second];
+            emit(g.line, &s, g.line.reward, g.line.last_access);
+            g.live = false;
+            ghost_index.erase(it);
+        }
+    }
+
+    std::string name() override { return "RL (TD)"; }
+};
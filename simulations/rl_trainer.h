@@ -0,0 +1,188 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "rl_policy.h"
+
+// ==========================================
+// PARALLEL ACTOR-LEARNER TRAINING
+// ==========================================
+// One RL_Policy learning online is bound to one core. For big trace corpora
+// acting and learning are split:
+//
+//   actors  - one thread each, replaying their own trace shards through a
+//             Simulator + RL_Policy in actor mode. Experiences collect in a
+//             thread-local block and are handed off with a single CAS.
+//   queue   - bounded lock-free MPSC ring of blocks. If the learner falls
+//             behind, actors drop the block (counted) instead of waiting,
+//             so acting never stalls on learning.
+//   learner - one thread draining the queue into a ReplayLearner. Every
+//             RL_PUBLISH_INTERVAL mini-batches it publishes a copy of the
+//             weights with std::atomic_store; actors pick up the newest
+//             copy between trace batches with std::atomic_load. A copy is
+//             freed once the last actor holding it moves on (RCU by
+//             shared_ptr).
+const int RL_BLOCK = 256;             // Experiences per queue hand-off
+const int RL_QUEUE_BLOCKS = 1024;     // Ring capacity, power of 2
+const int RL_PUBLISH_INTERVAL = 256;  // Mini-batches between weight snapshots
+
+struct ExperienceBlock
+{
+    RLExperience items[RL_BLOCK];
+    int count = 0;
+};
+
+// Vyukov-style bounded queue: a producer claims a slot by CAS on the tail,
+// fills it, then releases it through the slot's sequence number. The single
+// consumer needs no atomics of its own.
+class ExperienceQueue
+{
+    struct Slot
+    {
+        std::atomic<uint64_t> seq;
+        ExperienceBlock block;
+    };
+
+    std::unique_ptr<Slot[]> slots;
+    alignas(64) std::atomic<uint64_t> tail{0};
+    alignas(64) uint64_t head = 0;
+
+public:
+    ExperienceQueue() : slots(new Slot[RL_QUEUE_BLOCKS])
+    {
+        for (int i = 0; i < RL_QUEUE_BLOCKS; i++)
+            slots[i].seq.store(i, std::memory_order_relaxed);
+    }
+
+    bool try_push(const ExperienceBlock &block)
+    {
+        uint64_t pos = tail.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            Slot &s = slots[pos & (RL_QUEUE_BLOCKS - 1)];
+            int64_t lag = (int64_t)s.seq.load(std::memory_order_acquire) - (int64_t)pos;
+            if (lag == 0)
+            {
+                if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    s.block = block;
+                    s.seq.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (lag < 0)
+                return false; // Full
+            else
+                pos = tail.load(std::memory_order_relaxed);
+        }
+    }
+
+    // Consumer only
+    const ExperienceBlock *front()
+    {
+        Slot &s = slots[head & (RL_QUEUE_BLOCKS - 1)];
+        return s.seq.load(std::memory_order_acquire) == head + 1 ? &s.block : nullptr;
+    }
+
+    void pop()
+    {
+        slots[head & (RL_QUEUE_BLOCKS - 1)].seq.store(head + RL_QUEUE_BLOCKS, std::memory_order_release);
+        head++;
+    }
+};
+
+class ParallelRLTrainer
+{
+    ExperienceQueue queue;
+    std::shared_ptr<RLValueFunction> working; // Learner thread only
+    ReplayLearner replay;
+    std::shared_ptr<const RLValueFunction> published;
+    std::atomic<bool> actors_done{false};
+
+public:
+    std::atomic<uint64_t> dropped{0}; // Experiences lost to a full queue
+    uint64_t versions = 0;
+
+    explicit ParallelRLTrainer(const RLValueFunction &initial)
+        : working(std::make_shared<RLValueFunction>(initial)), replay(working),
+          published(std::make_shared<const RLValueFunction>(initial))
+    {
+    }
+
+    // Actor side
+    std::shared_ptr<const RLValueFunction> latest() const { return std::atomic_load(&published); }
+
+    void submit(const ExperienceBlock &block)
+    {
+        if (!queue.try_push(block))
+            dropped.fetch_add(block.count, std::memory_order_relaxed);
+    }
+
+    // Learner thread body; returns once finish() was called and the queue is drained
+    void learn()
+    {
+        uint64_t last_publish = 0;
+        for (;;)
+        {
+            const ExperienceBlock *block = queue.front();
+            if (!block)
+            {
+                if (actors_done.load(std::memory_order_acquire) && !queue.front())
+                    break;
+                std::this_thread::yield();
+                continue;
+            }
+            for (int i = 0; i < block->count; i++)
+                replay.push(block->items[i]);
+            queue.pop();
+
+            if (working->updates - last_publish >= RL_PUBLISH_INTERVAL)
+            {
+                publish();
+                last_publish = working->updates;
+            }
+        }
+        publish();
+    }
+
+    void finish() { actors_done.store(true, std::memory_order_release); }
+
+    const RLValueFunction &model() const { return *working; }
+    uint64_t experiences() const { return replay.experiences(); }
+
+private:
+    void publish()
+    {
+        std::atomic_store(&published, std::shared_ptr<const RLValueFunction>(std::make_shared<RLValueFunction>(*working)));
+        versions++;
+    }
+};
+
+// Per-actor sink: batches experiences so the queue sees one CAS per block
+class ActorSink : public ExperienceSink
+{
+    ParallelRLTrainer &trainer;
+    ExperienceBlock block;
+
+public:
+    explicit ActorSink(ParallelRLTrainer &t) : trainer(t) {}
+    ~ActorSink() { flush(); }
+
+    void push(const RLExperience &e) override
+    {
+        block.items[block.count++] = e;
+        if (block.count == RL_BLOCK)
+            flush();
+    }
+
+    void flush()
+    {
+        if (block.count > 0)
+            trainer.submit(block);
+        block.count = 0;
+    }
+};
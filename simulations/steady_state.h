@@ -0,0 +1,183 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <unordered_map>
+#include <vector>
+
+// ==========================================
+// STEADY-STATE DETECTION (--extrapolate)
+// ==========================================
+// The long scenarios repeat one epoch shape hundreds of thousands of times.
+// Once the cache and predictor settle, every further epoch (or every group
+// of P epochs, when the address stride walks the sets) yields the same stat
+// deltas, so simulating it adds nothing but time.
+//
+// Each epoch boundary hands in the epoch's counter deltas and a fingerprint
+// of the replacement state. Two tests, the first to pass wins:
+//   exact       - for some period P, deltas and fingerprint have matched the
+//                 epoch P earlier for STEADY_CONFIRM_EXACT periods in a row:
+//                 the state is back where it was, so the rest of the phase
+//                 replays the last period. P comes from where the current
+//                 (deltas, fingerprint) key was last seen, so the check is
+//                 O(1) per epoch however long the period
+//   approximate - the last STEADY_APPROX_WINDOWS windows of
+//                 STEADY_WINDOW_EPOCHS epochs agree on every counter within
+//                 STEADY_TOLERANCE of that counter, so a rare counter (such
+//                 as TinyLFU admissions) can't drift unseen under a
+//                 tolerance sized for the hits. Catches
+//                 policies with randomness or no fingerprint; the rest of
+//                 the phase gets the windows' mean rate.
+// Approximate needs thousands of epochs, so warm-up that only looks periodic
+// for a while, before a predictor flips, doesn't fool it.
+const int STEADY_MAX_PERIOD = 4096;
+const int STEADY_CONFIRM_EXACT = 2;
+const int STEADY_WINDOW_EPOCHS = 1024;
+const int STEADY_APPROX_WINDOWS = 4;
+const double STEADY_TOLERANCE = 0.001;
+
+enum SteadyKind
+{
+    STEADY_NONE,
+    STEADY_APPROXIMATE,
+    STEADY_EXACT
+};
+
+class SteadyState
+{
+    // Ring of the last STEADY_MAX_PERIOD epochs
+    std::vector<std::vector<uint64_t>> deltas;
+    std::vector<uint64_t> keys; // Deltas and fingerprint hashed together; 0 = no fingerprint
+    std::unordered_map<uint64_t, uint64_t> last_seen; // Key -> latest epoch, within the ring
+    uint64_t candidate = 0; // Period being confirmed
+    uint64_t run = 0;       // Epochs in a row that matched `candidate` epochs back
+    uint64_t epochs = 0;
+
+    // Approximate test: the window being filled, then the last few
+    std::vector<uint64_t> window;
+    std::deque<std::vector<uint64_t>> windows;
+
+    static uint64_t mix(uint64_t h, uint64_t v)
+    {
+        h ^= v + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2);
+        return h * 0xbf58476d1ce4e5b9ULL;
+    }
+
+    bool windows_agree() const
+    {
+        if (windows.size() < STEADY_APPROX_WINDOWS)
+            return false;
+        for (size_t i = 0; i < windows.front().size(); i++)
+        {
+            uint64_t lo = UINT64_MAX, hi = 0;
+            for (const auto &w : windows)
+            {
+                lo = std::min(lo, w[i]);
+                hi = std::max(hi, w[i]);
+            }
+            if (hi - lo > STEADY_TOLERANCE * lo)
+                return false;
+        }
+        return true;
+    }
+
+public:
+    int period = 0; // Of the last exact steady state found
+
+    SteadyState() : deltas(STEADY_MAX_PERIOD), keys(STEADY_MAX_PERIOD) {}
+
+    // Forget the history, e.g. after extrapolating to the end of a phase
+    void clear()
+    {
+        epochs = 0;
+        period = 0;
+        last_seen.clear();
+        candidate = run = 0;
+        window.clear();
+        windows.clear();
+    }
+
+    // One epoch's counter deltas. `fingerprint` 0 means the state cannot be
+    // compared, so only the approximate test applies.
+    SteadyKind observe(const std::vector<uint64_t> &delta, uint64_t fingerprint)
+    {
+        uint64_t key = 0;
+        if (fingerprint)
+        {
+            key = mix(0, fingerprint);
+            for (uint64_t d : delta)
+                key = mix(key, d);
+            key |= 1; // Never 0
+            if (candidate && keys[(epochs - candidate) % STEADY_MAX_PERIOD] == key)
+                run++;
+            else
+            {
+                auto it = last_seen.find(key);
+                candidate = it == last_seen.end() ? 0 : epochs - it->second;
+                run = candidate ? 1 : 0;
+            }
+        }
+        else
+            candidate = run = 0;
+
+        size_t slot = epochs % STEADY_MAX_PERIOD;
+        if (epochs >= STEADY_MAX_PERIOD)
+        {
+            auto it = last_seen.find(keys[slot]);
+            if (it != last_seen.end() && it->second == epochs - STEADY_MAX_PERIOD)
+                last_seen.erase(it);
+        }
+        deltas[slot] = delta;
+        keys[slot] = key;
+        if (key)
+            last_seen[key] = epochs;
+        epochs++;
+        if (candidate && run >= candidate * STEADY_CONFIRM_EXACT)
+        {
+            period = (int)candidate;
+            return STEADY_EXACT;
+        }
+
+        window.resize(delta.size(), 0);
+        for (size_t i = 0; i < delta.size(); i++)
+            window[i] += delta[i];
+        if (epochs % STEADY_WINDOW_EPOCHS != 0)
+            return STEADY_NONE;
+        windows.push_back(window);
+        if (windows.size() > STEADY_APPROX_WINDOWS)
+            windows.pop_front();
+        std::fill(window.begin(), window.end(), 0);
+        return windows_agree() ? STEADY_APPROXIMATE : STEADY_NONE;
+    }
+
+    // Sum of the next `remaining` epochs' deltas after observe() found a
+    // steady state of kind `kind`
+    std::vector<uint64_t> extrapolate(SteadyKind kind, uint64_t remaining) const
+    {
+        std::vector<uint64_t> total(deltas[(epochs - 1) % STEADY_MAX_PERIOD].size(), 0);
+        if (kind == STEADY_APPROXIMATE)
+        {
+            // Mean rate of the agreeing windows
+            const uint64_t span = (uint64_t)STEADY_APPROX_WINDOWS * STEADY_WINDOW_EPOCHS;
+            for (size_t i = 0; i < total.size(); i++)
+            {
+                uint64_t sum = 0;
+                for (const auto &w : windows)
+                    sum += w[i];
+                total[i] = (uint64_t)((double)sum * remaining / span + 0.5);
+            }
+            return total;
+        }
+        for (int k = 0; k < period; k++)
+        {
+            const std::vector<uint64_t> &d = deltas[(epochs - period + k) % STEADY_MAX_PERIOD];
+            // Epoch k of the period recurs once per full period left, plus once
+            // more if it falls in the partial period at the end
+            uint64_t times = remaining / period + ((uint64_t)k < remaining % period);
+            for (size_t i = 0; i < total.size(); i++)
+                total[i] += d[i] * times;
+        }
+        return total;
+    }
+};
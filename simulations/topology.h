@@ -0,0 +1,245 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <pthread.h>
+#include <sched.h>
+
+// ==========================================
+// CPU TOPOLOGY + PINNED WORKER POOL
+// ==========================================
+// Unpinned, a sweep's workers drift between sockets and keep reaching
+// across the interconnect for simulator state that was first touched on the
+// other node. So the parallel runners place workers themselves:
+//
+//   topology  - NUMA nodes and their CPUs from sysfs, limited to the CPUs
+//               this process may run on. Within a node, the first hardware
+//               thread of every core comes before any SMT sibling.
+//   placement - worker w goes to node w % nodes, so a handful of workers
+//               already uses every memory controller, and to the next free
+//               CPU there. Past one worker per CPU, CPUs are reused.
+//   memory    - nothing is bound explicitly. A job builds its simulator on
+//               the pinned worker thread, so first touch puts the arena,
+//               policy tables and reader buffers on the local node.
+//
+// Without sysfs (containers, non-Linux) everything is one node and pinning
+// is best effort.
+const char *const SYSFS_NODE_DIR = "/sys/devices/system/node/";
+const char *const SYSFS_CPU_DIR = "/sys/devices/system/cpu/";
+
+// "0-3,8,10-11" -> {0,1,2,3,8,10,11}
+inline std::vector<int> parse_cpu_list(const std::string &text)
+{
+    std::vector<int> cpus;
+    std::istringstream in(text);
+    std::string range;
+    while (std::getline(in, range, ','))
+    {
+        int first = 0, last = 0;
+        char dash = 0;
+        std::istringstream r(range);
+        if (!(r >> first))
+            continue;
+        if (!(r >> dash >> last) || dash != '-')
+            last = first;
+        for (int c = first; c <= last; c++)
+            cpus.push_back(c);
+    }
+    return cpus;
+}
+
+inline std::string read_sysfs(const std::string &path)
+{
+    std::ifstream in(path);
+    std::string text;
+    std::getline(in, text);
+    return text;
+}
+
+struct CpuTopology
+{
+    std::vector<std::vector<int>> node_cpus; // Usable CPUs per node, in placement order
+    std::vector<int> node_ids;               // Kernel node number of each entry
+
+    int nodes() const { return (int)node_cpus.size(); }
+
+    int cpus() const
+    {
+        int n = 0;
+        for (const auto &c : node_cpus)
+            n += (int)c.size();
+        return n;
+    }
+
+    static CpuTopology detect()
+    {
+        cpu_set_t allowed;
+        CPU_ZERO(&allowed);
+        bool have_mask = sched_getaffinity(0, sizeof(allowed), &allowed) == 0;
+        auto usable = [&](int cpu) { return cpu < CPU_SETSIZE && (!have_mask || CPU_ISSET(cpu, &allowed)); };
+
+        CpuTopology t;
+        for (int node : parse_cpu_list(read_sysfs(std::string(SYSFS_NODE_DIR) + "online")))
+        {
+            std::vector<int> cpus;
+            for (int c : parse_cpu_list(read_sysfs(SYSFS_NODE_DIR + ("node" + std::to_string(node)) + "/cpulist")))
+                if (usable(c))
+                    cpus.push_back(c);
+            if (cpus.empty())
+                continue; // Memory-only node (e.g. CXL expander) or outside our mask
+            t.node_cpus.push_back(physical_cores_first(cpus));
+            t.node_ids.push_back(node);
+        }
+        if (t.node_cpus.empty())
+        {
+            std::vector<int> cpus;
+            int hw = std::max(1u, std::thread::hardware_concurrency());
+            for (int c = 0; c < hw; c++)
+                if (usable(c))
+                    cpus.push_back(c);
+            t.node_cpus.push_back(cpus);
+            t.node_ids.push_back(0);
+        }
+        return t;
+    }
+
+    // (node index, cpu) for worker `w`, see the placement rule above
+    std::pair<int, int> place(int w) const
+    {
+        int node = w % nodes();
+        const std::vector<int> &cpus = node_cpus[node];
+        return {node, cpus.empty() ? -1 : cpus[(w / nodes()) % cpus.size()]};
+    }
+
+private:
+    // Rank of a CPU among its SMT siblings: 0 for the first thread of a core
+    static int smt_rank(int cpu)
+    {
+        std::vector<int> siblings = parse_cpu_list(
+            read_sysfs(SYSFS_CPU_DIR + ("cpu" + std::to_string(cpu)) + "/topology/thread_siblings_list"));
+        auto it = std::find(siblings.begin(), siblings.end(), cpu);
+        return it == siblings.end() ? 0 : (int)(it - siblings.begin());
+    }
+
+    static std::vector<int> physical_cores_first(std::vector<int> cpus)
+    {
+        std::vector<std::pair<int, int>> ranked;
+        for (int c : cpus)
+            ranked.push_back({smt_rank(c), c});
+        std::sort(ranked.begin(), ranked.end());
+        for (size_t i = 0; i < ranked.size(); i++)
+            cpus[i] = ranked[i].second;
+        return cpus;
+    }
+};
+
+inline bool pin_current_thread(int cpu)
+{
+    if (cpu < 0)
+        return false;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+struct WorkerSlot
+{
+    int index; // 0 .. workers-1
+    int node;  // Index into CpuTopology::node_cpus
+    int cpu;
+};
+
+// Runs jobs 0..n-1 on pinned workers. A job returns how many records it
+// replayed, which is what the per-node throughput report counts.
+class NodeScheduler
+{
+    struct NodeStats
+    {
+        int workers = 0;
+        std::atomic<uint64_t> jobs{0};
+        std::atomic<uint64_t> records{0};
+    };
+
+    CpuTopology topo;
+    int workers;
+    std::vector<NodeStats> stats;
+    std::vector<int> pinned; // Per node, workers that got their CPU
+    double seconds = 0;
+
+public:
+    NodeScheduler(int num_workers, CpuTopology topology = CpuTopology::detect())
+        : topo(std::move(topology)), workers(std::max(1, num_workers)), stats(topo.nodes()),
+          pinned(topo.nodes(), 0)
+    {
+    }
+
+    const CpuTopology &topology() const { return topo; }
+
+    // Workers run() will put on `node` for this many jobs
+    int workers_on(int node, size_t jobs) const
+    {
+        int n = 0;
+        for (int w = 0; w < workers && (size_t)w < jobs; w++)
+            n += topo.place(w).first == node;
+        return n;
+    }
+
+    template <typename Job> void run(size_t jobs, Job job)
+    {
+        std::atomic<size_t> next{0};
+        std::vector<std::atomic<int>> pin_ok(topo.nodes());
+        for (int n = 0; n < topo.nodes(); n++)
+            stats[n].workers = workers_on(n, jobs);
+        auto t0 = std::chrono::steady_clock::now();
+        std::vector<std::thread> pool;
+        for (int w = 0; w < workers && (size_t)w < jobs; w++)
+        {
+            pool.emplace_back([&, w]() {
+                auto p = topo.place(w);
+                WorkerSlot slot{w, p.first, p.second};
+                if (pin_current_thread(slot.cpu))
+                    pin_ok[slot.node]++;
+                for (size_t i = next++; i < jobs; i = next++)
+                {
+                    uint64_t records = job(i, slot);
+                    stats[slot.node].jobs++;
+                    stats[slot.node].records += records;
+                }
+            });
+        }
+        for (auto &t : pool)
+            t.join();
+        seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        for (int n = 0; n < topo.nodes(); n++)
+            pinned[n] = pin_ok[n];
+    }
+
+    // One line per node that ran anything: workers, jobs, records per second
+    void print(std::ostream &out) const
+    {
+        int active = 0;
+        for (const NodeStats &n : stats)
+            active += n.workers;
+        out << "    workers: " << active << " on " << topo.nodes() << " node(s), " << std::fixed
+            << std::setprecision(2) << seconds << " s\n";
+        for (int n = 0; n < topo.nodes(); n++)
+        {
+            if (stats[n].jobs == 0)
+                continue;
+            out << "      node " << topo.node_ids[n] << ": " << stats[n].workers << " workers (" << pinned[n]
+                << " pinned), " << stats[n].jobs << " jobs, " << std::setprecision(1)
+                << stats[n].records / std::max(seconds, 1e-9) / 1e6 << " M records/s\n";
+        }
+    }
+};
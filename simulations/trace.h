@@ -0,0 +1,538 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "arena.h"
+
+// ==========================================
+// NATIVE BINARY TRACE FORMAT
+// ==========================================
+// A trace stream is: one TraceHeader, any number of TraceRecords, and an
+// explicit end-of-stream record (TRACE_FLAG_END) whose addr field carries the
+// number of records that were sent. A stream that stops without the end
+// record (producer crashed, socket dropped) is reported as truncated instead
+// of being silently treated as a complete run.
+//
+// All fields are little-endian, fixed size, no padding, so the producer can
+// be a C runtime, a Python script or another instance of this engine.
+
+const uint32_t TRACE_MAGIC = 0x43525443; // "CTRC"
+const uint16_t TRACE_VERSION = 1;
+
+// Header flags
+const uint32_t TRACE_HDR_BYTE_ADDRESSES = 1u << 0; // addr is a byte address, align to the block before use
+const uint32_t TRACE_HDR_NEEDS_COHERENCE = 1u << 1; // sharers/state not captured, derive them from core + r/w
+
+// Record flags
+const uint8_t TRACE_FLAG_STATE_MASK = 0x3; // Bits [1:0] = MESI state of the access
+const uint8_t TRACE_FLAG_WRITE = 1u << 2;  // Store (otherwise load)
+const int TRACE_FLAG_SHARING_SHIFT = 3;     // Bits [5:3] = SharingClass, 0 if unknown
+const uint8_t TRACE_FLAG_SHARING_MASK = 0x7 << TRACE_FLAG_SHARING_SHIFT;
+const uint8_t TRACE_FLAG_END = 1u << 7;    // End-of-stream marker, addr = record count
+
+struct TraceHeader
+{
+    uint32_t magic = TRACE_MAGIC;
+    uint16_t version = TRACE_VERSION;
+    uint16_t record_size = 0;
+    uint32_t flags = 0;
+    uint32_t reserved = 0;
+};
+
+struct TraceRecord
+{
+    uint64_t addr;
+    uint64_t pc;
+    uint32_t size;   // Access size in bytes
+    uint16_t core;   // Issuing core / thread
+    uint8_t sharers; // Number of L2 copies at the time of the access
+    uint8_t flags;   // See TRACE_FLAG_*
+};
+
+static_assert(sizeof(TraceHeader) == 16, "TraceHeader must stay 16 bytes");
+static_assert(sizeof(TraceRecord) == 24, "TraceRecord must stay 24 bytes");
+
+// Stream specs accepted by TraceReader / TraceWriter:
+//   "-"          stdin (reader) / stdout (writer)
+//   "unix:PATH"  Unix domain socket. The reader binds PATH and accepts one
+//                producer, the writer connects to it.
+//   anything else is opened as a path, which covers regular files and FIFOs.
+const char *const TRACE_UNIX_PREFIX = "unix:";
+const size_t TRACE_DEFAULT_BUFFER = 4 << 20; // 4 MB read buffer = ~175K records
+
+// ==========================================
+// TRACE READER (Streaming Front End)
+// ==========================================
+// Reads records in large chunks straight into one reusable buffer and hands
+// out batches that point into it. Memory use is the buffer size no matter how
+// long the stream is.
+class TraceReader
+{
+    int fd = -1;
+    int listen_fd = -1;
+    std::string unix_path;
+
+    std::vector<char> buffer;
+    const char *image = nullptr; // open_image(): records are read in place from here
+    off_t file_offset = -1;      // Regular files are read with pread() from here; -1 = read()
+    size_t buf_begin = 0; // First unconsumed byte
+    size_t buf_end = 0;   // One past the last valid byte
+    bool eof = false;
+
+public:
+    TraceHeader header;
+    uint64_t records_read = 0;
+    uint64_t records_expected = 0; // From the end-of-stream record
+    bool saw_end_marker = false;
+    bool truncated = false;
+    std::string error;
+
+    explicit TraceReader(size_t buffer_bytes = TRACE_DEFAULT_BUFFER)
+    {
+        buffer.resize(buffer_bytes - buffer_bytes % sizeof(TraceRecord));
+    }
+
+    ~TraceReader() { close(); }
+
+    TraceReader(const TraceReader &) = delete;
+    TraceReader &operator=(const TraceReader &) = delete;
+
+    bool open(const std::string &spec)
+    {
+        if (spec == "-")
+        {
+            fd = STDIN_FILENO;
+        }
+        else if (spec.compare(0, strlen(TRACE_UNIX_PREFIX), TRACE_UNIX_PREFIX) == 0)
+        {
+            if (!accept_unix(spec.substr(strlen(TRACE_UNIX_PREFIX))))
+                return false;
+        }
+        else
+        {
+            fd = ::open(spec.c_str(), O_RDONLY);
+            if (fd < 0)
+                return fail("cannot open " + spec + ": " + strerror(errno));
+        }
+        tune_fd();
+        if (!read_header())
+            return false;
+        // A private offset instead of the fd's: a fork()ed copy of this reader
+        // then continues on its own (--branch-at)
+        struct stat st;
+        if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode))
+            file_offset = sizeof(header);
+        return true;
+    }
+
+    // Replay a trace that is already in memory (see TraceImage). Nothing is
+    // copied; batches point straight into `bytes`.
+    bool open_image(const char *bytes, size_t size)
+    {
+        if (size < sizeof(header))
+            return fail("stream ended before the trace header");
+        memcpy(&header, bytes, sizeof(header));
+        image = bytes + sizeof(header);
+        buf_begin = 0;
+        buf_end = size - sizeof(header);
+        eof = true;
+        return check_header();
+    }
+
+    void close()
+    {
+        if (fd > STDIN_FILENO)
+            ::close(fd);
+        fd = -1;
+        if (listen_fd >= 0)
+        {
+            ::close(listen_fd);
+            unlink(unix_path.c_str());
+            listen_fd = -1;
+        }
+    }
+
+    bool byte_addresses() const { return header.flags & TRACE_HDR_BYTE_ADDRESSES; }
+
+    // True when a fork()ed copy can keep reading independently of this one
+    bool forkable() const { return image || file_offset >= 0; }
+
+    // Returns up to max_records records, or nullptr once the stream is over.
+    // The pointer stays valid until the next call.
+    const TraceRecord *next_batch(size_t max_records, size_t &count)
+    {
+        count = 0;
+        if (saw_end_marker)
+            return nullptr;
+
+        if (buf_end - buf_begin < sizeof(TraceRecord))
+        {
+            refill();
+            if (buf_end - buf_begin < sizeof(TraceRecord))
+            {
+                // Producer went away without sending the end-of-stream record
+                truncated = true;
+                return nullptr;
+            }
+        }
+
+        const char *base = image ? image : buffer.data();
+        const TraceRecord *batch = reinterpret_cast<const TraceRecord *>(base + buf_begin);
+        size_t available = (buf_end - buf_begin) / sizeof(TraceRecord);
+        size_t n = std::min(available, max_records);
+
+        for (size_t i = 0; i < n; i++)
+        {
+            if (batch[i].flags & TRACE_FLAG_END)
+            {
+                saw_end_marker = true;
+                records_expected = batch[i].addr;
+                n = i;
+                break;
+            }
+        }
+
+        buf_begin += n * sizeof(TraceRecord);
+        records_read += n;
+        count = n;
+        if (n == 0 && saw_end_marker)
+            return nullptr;
+        return batch;
+    }
+
+    // Continue from record `index` (--resume): seeks in a file, reads and
+    // drops the records before it in a stream. False if the stream ends first.
+    bool skip_to(uint64_t index)
+    {
+        if (file_offset >= 0 && index >= records_read)
+        {
+            struct stat st;
+            off_t offset = sizeof(header) + index * sizeof(TraceRecord);
+            if (fstat(fd, &st) != 0 || st.st_size < offset)
+                return false;
+            file_offset = offset;
+            buf_begin = buf_end = 0;
+            records_read = index;
+            return true;
+        }
+        size_t n = 0;
+        while (records_read < index && next_batch(std::min<uint64_t>(index - records_read, 1 << 16), n))
+        {
+        }
+        return records_read == index;
+    }
+
+    // Call once next_batch() returned nullptr
+    bool complete() const
+    {
+        return saw_end_marker && !truncated && records_expected == records_read;
+    }
+
+private:
+    bool fail(const std::string &msg)
+    {
+        error = msg;
+        return false;
+    }
+
+    bool accept_unix(const std::string &path)
+    {
+        sockaddr_un sa{};
+        if (path.size() >= sizeof(sa.sun_path))
+            return fail("socket path too long: " + path);
+
+        listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listen_fd < 0)
+            return fail(std::string("socket: ") + strerror(errno));
+
+        sa.sun_family = AF_UNIX;
+        memcpy(sa.sun_path, path.c_str(), path.size() + 1);
+        unlink(path.c_str());
+        if (bind(listen_fd, (sockaddr *)&sa, sizeof(sa)) < 0 || listen(listen_fd, 1) < 0)
+            return fail("cannot listen on " + path + ": " + strerror(errno));
+        unix_path = path;
+
+        fprintf(stderr, "[trace] waiting for producer on %s\n", path.c_str());
+        fd = accept(listen_fd, nullptr, nullptr);
+        if (fd < 0)
+            return fail(std::string("accept: ") + strerror(errno));
+        return true;
+    }
+
+    void tune_fd()
+    {
+        struct stat st;
+        if (fstat(fd, &st) != 0)
+            return;
+#ifdef F_SETPIPE_SZ
+        // Bigger pipe = fewer context switches between tracer and simulator
+        if (S_ISFIFO(st.st_mode))
+            fcntl(fd, F_SETPIPE_SZ, 1 << 20);
+#endif
+#ifdef POSIX_FADV_SEQUENTIAL
+        if (S_ISREG(st.st_mode))
+            posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+#ifdef SO_RCVBUF
+        if (S_ISSOCK(st.st_mode))
+        {
+            int sz = 4 << 20;
+            setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &sz, sizeof(sz));
+        }
+#endif
+    }
+
+    // Move the partial tail record to the front and fill the rest of the buffer
+    void refill()
+    {
+        if (eof)
+            return;
+        size_t leftover = buf_end - buf_begin;
+        if (leftover > 0)
+            memmove(buffer.data(), buffer.data() + buf_begin, leftover);
+        buf_begin = 0;
+        buf_end = leftover;
+
+        // Keep reading until at least one full record is buffered; pipes and
+        // sockets routinely return short reads.
+        while (buf_end < buffer.size())
+        {
+            ssize_t got = file_offset >= 0
+                              ? ::pread(fd, buffer.data() + buf_end, buffer.size() - buf_end, file_offset)
+                              : ::read(fd, buffer.data() + buf_end, buffer.size() - buf_end);
+            if (got < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                error = std::string("read: ") + strerror(errno);
+                eof = true;
+                break;
+            }
+            if (got == 0)
+            {
+                eof = true;
+                break;
+            }
+            buf_end += got;
+            if (file_offset >= 0)
+                file_offset += got;
+            if (buf_end >= sizeof(TraceRecord) * 1024 || buf_end == buffer.size())
+                break;
+        }
+    }
+
+    bool read_header()
+    {
+        size_t got = 0;
+        char *dst = reinterpret_cast<char *>(&header);
+        while (got < sizeof(header))
+        {
+            ssize_t n = ::read(fd, dst + got, sizeof(header) - got);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+                return fail("stream ended before the trace header");
+            got += n;
+        }
+        return check_header();
+    }
+
+    bool check_header()
+    {
+        if (header.magic != TRACE_MAGIC)
+            return fail("bad trace magic (not a native COALESCE trace)");
+        if (header.version != TRACE_VERSION || header.record_size != sizeof(TraceRecord))
+            return fail("unsupported trace version / record size");
+        return true;
+    }
+};
+
+// A regular file, which (unlike a pipe or socket) any number of readers can
+// open at once
+inline bool trace_is_file(const std::string &spec, size_t &bytes)
+{
+    struct stat st;
+    if (spec == "-" || spec.compare(0, strlen(TRACE_UNIX_PREFIX), TRACE_UNIX_PREFIX) == 0 ||
+        stat(spec.c_str(), &st) != 0 || !S_ISREG(st.st_mode))
+        return false;
+    bytes = (size_t)st.st_size;
+    return true;
+}
+
+// ==========================================
+// IN-MEMORY TRACE IMAGE
+// ==========================================
+// A whole trace file read into anonymous memory by the calling thread, so
+// its pages are allocated on that thread's NUMA node. The parallel runner
+// loads one image per node and the node's workers replay it in place,
+// instead of all of them pulling the file through one node's page cache.
+class TraceImage
+{
+    std::unique_ptr<Arena> arena;
+
+public:
+    const char *data = nullptr;
+    size_t size = 0;
+    std::string error;
+
+    bool load(const std::string &path)
+    {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        struct stat st;
+        if (fd < 0 || fstat(fd, &st) != 0)
+        {
+            error = "cannot open " + path + ": " + strerror(errno);
+            if (fd >= 0)
+                ::close(fd);
+            return false;
+        }
+        arena = std::make_unique<Arena>(std::max<size_t>(1, st.st_size));
+        char *dst = arena->alloc<char>(st.st_size);
+        size_t got = 0;
+        while (got < (size_t)st.st_size)
+        {
+            ssize_t n = ::read(fd, dst + got, st.st_size - got);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+                break;
+            got += n;
+        }
+        ::close(fd);
+        data = dst;
+        size = got;
+        return true;
+    }
+};
+
+// ==========================================
+// TRACE WRITER
+// ==========================================
+class TraceWriter
+{
+    int fd = -1;
+    std::vector<TraceRecord> pending;
+    size_t used = 0;
+
+public:
+    uint64_t records_written = 0;
+    std::string error;
+
+    explicit TraceWriter(size_t batch_records = 64 * 1024) : pending(batch_records) {}
+    ~TraceWriter() { finish(); }
+
+    TraceWriter(const TraceWriter &) = delete;
+    TraceWriter &operator=(const TraceWriter &) = delete;
+
+    bool open(const std::string &spec, uint32_t header_flags = 0)
+    {
+        if (spec == "-")
+        {
+            fd = STDOUT_FILENO;
+        }
+        else if (spec.compare(0, strlen(TRACE_UNIX_PREFIX), TRACE_UNIX_PREFIX) == 0)
+        {
+            std::string path = spec.substr(strlen(TRACE_UNIX_PREFIX));
+            sockaddr_un sa{};
+            if (path.size() >= sizeof(sa.sun_path))
+                return fail("socket path too long: " + path);
+            sa.sun_family = AF_UNIX;
+            memcpy(sa.sun_path, path.c_str(), path.size() + 1);
+            fd = socket(AF_UNIX, SOCK_STREAM, 0);
+            if (fd < 0 || connect(fd, (sockaddr *)&sa, sizeof(sa)) < 0)
+                return fail("cannot connect to " + path + ": " + strerror(errno));
+        }
+        else
+        {
+            fd = ::open(spec.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            if (fd < 0)
+                return fail("cannot open " + spec + ": " + strerror(errno));
+        }
+
+        TraceHeader h;
+        h.record_size = sizeof(TraceRecord);
+        h.flags = header_flags;
+        return write_all(&h, sizeof(h));
+    }
+
+    void write(const TraceRecord &r)
+    {
+        pending[used++] = r;
+        if (used == pending.size())
+            flush();
+    }
+
+    void write(uint64_t addr, uint64_t pc, int sharers, int state, bool is_write = false, int core = 0, uint32_t size = 64)
+    {
+        TraceRecord r;
+        r.addr = addr;
+        r.pc = pc;
+        r.size = size;
+        r.core = (uint16_t)core;
+        r.sharers = (uint8_t)std::min(sharers, 255);
+        r.flags = (uint8_t)((state & TRACE_FLAG_STATE_MASK) | (is_write ? TRACE_FLAG_WRITE : 0));
+        write(r);
+    }
+
+    bool flush()
+    {
+        if (used == 0 || fd < 0)
+            return true;
+        bool ok = write_all(pending.data(), used * sizeof(TraceRecord));
+        records_written += used;
+        used = 0;
+        return ok;
+    }
+
+    // Writes the end-of-stream record and closes the stream
+    bool finish()
+    {
+        if (fd < 0)
+            return true;
+        bool ok = flush();
+        TraceRecord end{};
+        end.addr = records_written;
+        end.flags = TRACE_FLAG_END;
+        ok = write_all(&end, sizeof(end)) && ok;
+        if (fd > STDOUT_FILENO)
+            ::close(fd);
+        fd = -1;
+        return ok;
+    }
+
+private:
+    bool fail(const std::string &msg)
+    {
+        error = msg;
+        return false;
+    }
+
+    bool write_all(const void *data, size_t bytes)
+    {
+        const char *p = static_cast<const char *>(data);
+        while (bytes > 0)
+        {
+            ssize_t n = ::write(fd, p, bytes);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+                return fail(std::string("write: ") + strerror(errno));
+            p += n;
+            bytes -= n;
+        }
+        return true;
+    }
+};
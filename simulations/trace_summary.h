@@ -0,0 +1,397 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "trace.h"
+
+// ==========================================
+// TRACE SUMMARIZER
+// ==========================================
+// Single pass over a trace that answers "how big is this and what does it
+// look like" before committing hours to a full simulation:
+//   - distinct lines / PCs    -> HyperLogLog (~0.8% error, 16 KB each)
+//   - hottest PCs and lines   -> count-min sketch + small candidate list
+//   - reuse-time histogram    -> exact, on a hash-sampled subset of lines
+//   - read/write mix, sharers, per-core volume -> plain counters
+// Every structure merges cheaply, so chunks are summarized on worker threads
+// and folded together at the end.
+
+inline uint64_t summary_hash(uint64_t x)
+{
+    // splitmix64 finalizer: cheap and good enough for sketches
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+// ==========================================
+// HYPERLOGLOG
+// ==========================================
+class HyperLogLog
+{
+    static constexpr int P = 14; // 16384 registers
+    static constexpr int M = 1 << P;
+    std::vector<uint8_t> regs;
+
+public:
+    HyperLogLog() : regs(M, 0) {}
+
+    void add_hash(uint64_t h)
+    {
+        int idx = h >> (64 - P);
+        uint64_t rest = (h << P) | (1ULL << (P - 1)); // Guard bit bounds the rank
+        uint8_t rank = __builtin_clzll(rest) + 1;
+        if (rank > regs[idx])
+            regs[idx] = rank;
+    }
+
+    void merge(const HyperLogLog &o)
+    {
+        for (int i = 0; i < M; i++)
+            regs[i] = std::max(regs[i], o.regs[i]);
+    }
+
+    double estimate() const
+    {
+        double sum = 0;
+        int zeros = 0;
+        for (int i = 0; i < M; i++)
+        {
+            sum += std::ldexp(1.0, -regs[i]);
+            zeros += regs[i] == 0;
+        }
+        double alpha = 0.7213 / (1.0 + 1.079 / M);
+        double e = alpha * M * M / sum;
+        if (e <= 2.5 * M && zeros > 0)
+            e = M * std::log((double)M / zeros); // Linear counting for small sets
+        return e;
+    }
+};
+
+// ==========================================
+// COUNT-MIN SKETCH (with heavy-hitter candidates)
+// ==========================================
+class CountMinSketch
+{
+    static constexpr int DEPTH = 4;
+    static constexpr int WIDTH = 1 << 16;
+    static constexpr size_t MAX_CANDIDATES = 512;
+    std::vector<uint32_t> counts;
+    uint32_t cutoff = 0; // Estimate a key must beat to enter the candidate list
+
+public:
+    // Keys whose estimate was high when last seen. Pruned to the hottest half
+    // whenever it overflows; re-ranked against the merged sketch at the end.
+    std::unordered_map<uint64_t, uint32_t> candidates;
+
+    CountMinSketch() : counts(DEPTH * WIDTH, 0) {}
+
+    uint32_t add(uint64_t key, uint64_t h)
+    {
+        uint32_t est = UINT32_MAX;
+        for (int d = 0; d < DEPTH; d++)
+        {
+            uint32_t &c = counts[d * WIDTH + ((h >> (16 * d)) & (WIDTH - 1))];
+            c++;
+            est = std::min(est, c);
+        }
+        track(key, est);
+        return est;
+    }
+
+    uint32_t estimate(uint64_t h) const
+    {
+        uint32_t est = UINT32_MAX;
+        for (int d = 0; d < DEPTH; d++)
+            est = std::min(est, counts[d * WIDTH + ((h >> (16 * d)) & (WIDTH - 1))]);
+        return est;
+    }
+
+    void merge(const CountMinSketch &o)
+    {
+        for (size_t i = 0; i < counts.size(); i++)
+            counts[i] += o.counts[i];
+        for (const auto &kv : o.candidates)
+            candidates[kv.first] = std::max(candidates[kv.first], kv.second);
+    }
+
+    std::vector<std::pair<uint64_t, uint32_t>> top(size_t k) const
+    {
+        std::vector<std::pair<uint64_t, uint32_t>> out;
+        for (const auto &kv : candidates)
+            out.push_back({kv.first, estimate(summary_hash(kv.first))});
+        std::sort(out.begin(), out.end(), [](const auto &a, const auto &b) { return a.second > b.second; });
+        if (out.size() > k)
+            out.resize(k);
+        return out;
+    }
+
+private:
+    void track(uint64_t key, uint32_t est)
+    {
+        if (est <= cutoff)
+            return; // Keeps the common (cold) case off the hash map
+        auto it = candidates.find(key);
+        if (it != candidates.end())
+        {
+            it->second = est;
+            return;
+        }
+        candidates.emplace(key, est);
+        if (candidates.size() > MAX_CANDIDATES)
+        {
+            std::vector<uint32_t> ests;
+            for (const auto &kv : candidates)
+                ests.push_back(kv.second);
+            std::nth_element(ests.begin(), ests.begin() + MAX_CANDIDATES / 2, ests.end(), std::greater<uint32_t>());
+            cutoff = ests[MAX_CANDIDATES / 2];
+            for (auto i = candidates.begin(); i != candidates.end();)
+                i = i->second <= cutoff ? candidates.erase(i) : std::next(i);
+        }
+    }
+};
+
+// ==========================================
+// PER-CHUNK PARTIAL SUMMARY
+// ==========================================
+const int SUMMARY_MAX_CORES = 64;
+const int SUMMARY_SHARER_BUCKETS = 9;  // 0..7, 8+
+const int SUMMARY_REUSE_BUCKETS = 40;  // log2(reuse time)
+
+struct PartialSummary
+{
+    uint64_t accesses = 0;
+    uint64_t writes = 0;
+    uint64_t bytes = 0;
+    uint64_t sharers_hist[SUMMARY_SHARER_BUCKETS] = {};
+    uint64_t per_core[SUMMARY_MAX_CORES] = {};
+    HyperLogLog lines;
+    HyperLogLog pcs;
+    CountMinSketch hot_pcs;
+    CountMinSketch hot_lines;
+    // (line, global index, core) for sampled lines, in trace order
+    std::vector<std::pair<uint64_t, uint64_t>> sampled;
+    std::vector<uint16_t> sampled_core;
+
+    void merge(const PartialSummary &o)
+    {
+        accesses += o.accesses;
+        writes += o.writes;
+        bytes += o.bytes;
+        for (int i = 0; i < SUMMARY_SHARER_BUCKETS; i++)
+            sharers_hist[i] += o.sharers_hist[i];
+        for (int i = 0; i < SUMMARY_MAX_CORES; i++)
+            per_core[i] += o.per_core[i];
+        lines.merge(o.lines);
+        pcs.merge(o.pcs);
+        hot_pcs.merge(o.hot_pcs);
+        hot_lines.merge(o.hot_lines);
+    }
+};
+
+// ==========================================
+// SUMMARIZER DRIVER
+// ==========================================
+class TraceSummarizer
+{
+    int threads;
+    uint64_t sample_mask; // Sample lines with (hash & mask) == 0
+
+    std::vector<PartialSummary> partials; // One per worker, live for the whole run
+    PartialSummary total;
+
+    struct LineHistory
+    {
+        uint64_t last_idx;
+        uint64_t core_mask;
+    };
+    std::unordered_map<uint64_t, LineHistory> sampled_lines;
+    uint64_t reuse_hist[SUMMARY_REUSE_BUCKETS] = {};
+    uint64_t cold_sampled = 0;
+    bool byte_addresses = false;
+
+public:
+    uint64_t records = 0;
+
+    TraceSummarizer(int num_threads, int sample_rate)
+        : threads(std::max(1, num_threads)), partials(std::max(1, num_threads))
+    {
+        // Round the sampling rate down to a power of two so the test is a mask
+        int r = 1;
+        while (r * 2 <= std::max(1, sample_rate))
+            r *= 2;
+        sample_mask = r - 1;
+    }
+
+    int sample_rate() const { return (int)sample_mask + 1; }
+
+    bool run(TraceReader &reader, size_t chunk_records = 1 << 18)
+    {
+        byte_addresses = reader.byte_addresses();
+        std::vector<std::vector<TraceRecord>> chunks(threads);
+        bool more = true;
+
+        while (more)
+        {
+            // Fill one chunk per worker, then summarize them in parallel
+            int filled = 0;
+            for (; filled < threads && more; filled++)
+            {
+                std::vector<TraceRecord> &c = chunks[filled];
+                c.clear();
+                size_t n = 0;
+                while (c.size() < chunk_records)
+                {
+                    const TraceRecord *batch = reader.next_batch(chunk_records - c.size(), n);
+                    if (!batch)
+                    {
+                        more = false;
+                        break;
+                    }
+                    c.insert(c.end(), batch, batch + n);
+                }
+                if (c.empty())
+                    break;
+            }
+
+            std::vector<std::thread> workers;
+            uint64_t base = records;
+            // Chunks are full except possibly the last, so offsets are exact
+            for (int t = 0; t < filled; t++)
+                workers.emplace_back([this, t, base, &chunks]() { summarize_chunk(chunks[t], partials[t], base + t * chunks[0].size()); });
+            for (auto &w : workers)
+                w.join();
+
+            // Reuse tracking needs trace order, so sampled accesses are folded
+            // in sequentially. They are 1/sample_rate of the trace.
+            for (int t = 0; t < filled; t++)
+            {
+                PartialSummary &p = partials[t];
+                for (size_t i = 0; i < p.sampled.size(); i++)
+                    record_reuse(p.sampled[i].first, p.sampled[i].second, p.sampled_core[i]);
+                p.sampled.clear();
+                p.sampled_core.clear();
+                records += chunks[t].size();
+            }
+        }
+
+        for (PartialSummary &p : partials)
+            total.merge(p);
+        return reader.complete();
+    }
+
+    void print_report(std::ostream &os) const
+    {
+        double n = std::max<uint64_t>(1, total.accesses);
+        double distinct_lines = total.lines.estimate();
+
+        os << std::fixed << std::setprecision(2);
+        os << "Accesses            : " << total.accesses << "\n";
+        os << "Reads / Writes      : " << 100.0 * (total.accesses - total.writes) / n << "% / "
+           << 100.0 * total.writes / n << "%\n";
+        os << "Bytes touched       : " << total.bytes << " (avg " << total.bytes / n << " B/access)\n";
+        os << "Distinct lines (~)  : " << (uint64_t)distinct_lines << "  footprint ~"
+           << distinct_lines * 64 / (1 << 20) << " MB\n";
+        os << "Distinct PCs (~)    : " << (uint64_t)total.pcs.estimate() << "\n";
+
+        os << "Sharers at access   :";
+        for (int i = 0; i < SUMMARY_SHARER_BUCKETS; i++)
+            if (total.sharers_hist[i])
+                os << " " << i << (i == SUMMARY_SHARER_BUCKETS - 1 ? "+" : "") << "=" << 100.0 * total.sharers_hist[i] / n << "%";
+        os << "\n";
+
+        os << "Accesses per core   :";
+        for (int i = 0; i < SUMMARY_MAX_CORES; i++)
+            if (total.per_core[i])
+                os << " c" << i << "=" << 100.0 * total.per_core[i] / n << "%";
+        os << "\n";
+
+        os << "Hot PCs             :";
+        for (const auto &kv : total.hot_pcs.top(8))
+            os << " 0x" << std::hex << kv.first << std::dec << "(" << 100.0 * kv.second / n << "%)";
+        os << "\n";
+        os << "Hot lines           :";
+        for (const auto &kv : total.hot_lines.top(8))
+            os << " 0x" << std::hex << kv.first << std::dec << "(" << 100.0 * kv.second / n << "%)";
+        os << "\n";
+
+        // Sharing degree = distinct cores that touched a sampled line
+        uint64_t degree[SUMMARY_MAX_CORES + 1] = {};
+        for (const auto &kv : sampled_lines)
+            degree[__builtin_popcountll(kv.second.core_mask)]++;
+        double sampled = std::max<size_t>(1, sampled_lines.size());
+        os << "Sharing degree      :";
+        for (int i = 1; i <= SUMMARY_MAX_CORES; i++)
+            if (degree[i])
+                os << " " << i << "core=" << 100.0 * degree[i] / sampled << "%";
+        os << "  (" << sampled_lines.size() << " sampled lines, 1/" << sample_rate() << ")\n";
+
+        uint64_t reuses = 0;
+        for (int i = 0; i < SUMMARY_REUSE_BUCKETS; i++)
+            reuses += reuse_hist[i];
+        double all = std::max<uint64_t>(1, reuses + cold_sampled);
+        os << "Reuse time (sampled): cold=" << 100.0 * cold_sampled / all << "%\n";
+        for (int i = 0; i < SUMMARY_REUSE_BUCKETS; i++)
+        {
+            if (!reuse_hist[i])
+                continue;
+            os << "   <" << std::setw(12) << (1ULL << (i + 1)) << " accesses : " << std::setw(6)
+               << 100.0 * reuse_hist[i] / all << "%\n";
+        }
+    }
+
+private:
+    uint64_t line_of(uint64_t addr) const { return byte_addresses ? addr >> 6 : addr; }
+
+    void summarize_chunk(const std::vector<TraceRecord> &chunk, PartialSummary &p, uint64_t base)
+    {
+        for (size_t i = 0; i < chunk.size(); i++)
+        {
+            const TraceRecord &r = chunk[i];
+            uint64_t line = line_of(r.addr);
+            uint64_t lh = summary_hash(line);
+            uint64_t ph = summary_hash(r.pc);
+
+            p.accesses++;
+            p.writes += (r.flags & TRACE_FLAG_WRITE) != 0;
+            p.bytes += r.size;
+            p.sharers_hist[std::min<int>(r.sharers, SUMMARY_SHARER_BUCKETS - 1)]++;
+            p.per_core[r.core % SUMMARY_MAX_CORES]++;
+            p.lines.add_hash(lh);
+            p.pcs.add_hash(ph);
+            p.hot_pcs.add(r.pc, ph);
+            p.hot_lines.add(line, lh);
+
+            if ((lh & sample_mask) == 0)
+            {
+                p.sampled.push_back({line, base + i});
+                p.sampled_core.push_back(r.core);
+            }
+        }
+    }
+
+    void record_reuse(uint64_t line, uint64_t idx, uint16_t core)
+    {
+        auto it = sampled_lines.find(line);
+        if (it == sampled_lines.end())
+        {
+            sampled_lines.emplace(line, LineHistory{idx, 1ULL << (core % SUMMARY_MAX_CORES)});
+            cold_sampled++;
+            return;
+        }
+        uint64_t dt = idx - it->second.last_idx;
+        int bucket = dt ? 63 - __builtin_clzll(dt) : 0;
+        reuse_hist[std::min(bucket, SUMMARY_REUSE_BUCKETS - 1)]++;
+        it->second.last_idx = idx;
+        it->second.core_mask |= 1ULL << (core % SUMMARY_MAX_CORES);
+    }
+};